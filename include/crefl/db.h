@@ -28,24 +28,162 @@ extern "C" {
 #endif
 
 struct decl_db_hdr;
+struct decl_db_index_hdr;
+struct decl_db_index_fqn;
 typedef struct decl_db_hdr decl_db_hdr;
+typedef struct decl_db_index_hdr decl_db_index_hdr;
+typedef struct decl_db_index_fqn decl_db_index_fqn;
 
-/* decl db magic constant */
-static const u8 decl_db_magic[8] = { 'c', 'r', 'e', 'f', 'l', '0', '0', '0' };
+/* decl db magic constant, crefl000 images are read but not written */
+static const u8 decl_db_magic[8] = { 'c', 'r', 'e', 'f', 'l', '0', '0', '1' };
 
-/* decl db header */
+/*
+ * decl db header
+ *
+ * the header is followed by the decl table and the name table. tables
+ * include the builtin prefix created by crefl_db_defaults so that the
+ * file image is identical to the in-memory layout and can be mapped.
+ * the header size is a multiple of 8 so the decl table is aligned.
+ * if the packed flag is set, the decl table is packed and starts with
+ * its size in bytes, see crefl_db_set_packed.
+ *
+ * if the hashes version in flags is non-zero, the name table is followed
+ * by padding to a multiple of 8 and a table of decl_entry_count link index
+ * entries holding node hashes and fqn links, see crefl_db_link_hashes.
+ * if the index version in flags is non-zero, the image ends with padding
+ * to a multiple of 8 and a lookup index section, see crefl_db_set_index.
+ * readers ignore sections with versions they do not know.
+ */
 struct decl_db_hdr
 {
     u8 magic[8];
     u32 decl_entry_count;
     u32 name_table_size;
     u32 root_element;
+    u32 flags;
+    u64 checksum;
+};
+
+/*
+ * decl db lookup index section
+ *
+ * read-only hash tables that are probed in place. each table has the
+ * layout of hashmap: a bitmap with 2 bits per slot where 1 marks an
+ * occupied slot, followed by the slots, which are probed linearly from
+ * the key hash masked by the slot count, a power of two. the header is
+ * followed by these arrays, each at a multiple of 8 from the section:
+ *
+ * - content hash bitmap and hash_limit u32 decl id slots. the key of a
+ *   slot is the persisted hash of its node and the key hash is the
+ *   first 8 bytes of the sum. empty if the db has no persisted hashes.
+ * - fqn bitmap and fqn_limit decl_db_index_fqn slots, hashed with
+ *   crefl_name_hash. nodes with the same fqn are in traversal order.
+ *   empty if the fqns do not fit in a string table with u32 offsets.
+ * - fqn string table of fqn_size bytes referenced by the fqn slots.
+ *
+ * decl_count is the node count of the db the section was built for.
+ */
+struct decl_db_index_hdr
+{
+    u32 hash_limit;
+    u32 fqn_limit;
+    u32 fqn_size;
+    u32 decl_count;
+};
+
+struct decl_db_index_fqn
+{
+    u32 decl;
+    u32 fqn;
+};
+
+/* decl db header flags */
+enum {
+    /* links were checked when the image was emitted */
+    decl_db_flag_checked = 1,
+    /* checksum covers the decl and name tables */
+    decl_db_flag_checksum = 2,
+    /* decl table is packed, see crefl_db_set_packed */
+    decl_db_flag_packed = 4,
+    /* node identity hash algorithm used to link the db */
+    decl_db_flag_hash_shift = 8,
+    decl_db_flag_hash_mask = 0xf00,
+    /* version of the persisted hash section, zero if absent */
+    decl_db_flag_hashes_shift = 12,
+    decl_db_flag_hashes_mask = 0xf000,
+    /* version of the lookup index section, zero if absent */
+    decl_db_flag_index_shift = 16,
+    decl_db_flag_index_mask = 0xf0000
+};
+
+/* persisted hash section version written by this library */
+enum { decl_db_hashes_version = 1 };
+
+/* lookup index section version written by this library */
+enum { decl_db_index_version = 1 };
+
+/*
+ * decl db check policy
+ *
+ * selects how links are checked when a db is read, attached or mapped.
+ *
+ * - full           - check each link of each node (default)
+ * - vector         - compare packed link columns against table bounds
+ * - defer          - skip checks, call crefl_db_check_links before use
+ * - trusted        - verify the header checksum instead of links
+ *
+ * the full and vector policies also check the fqn links of persisted
+ * hash entries. the checksum covers the persisted hash section.
+ *
+ * trusted images without a checksum are checked in full. attached
+ * images flagged as checked by crefltool --emit are never re-checked.
+ */
+enum crefl_db_check
+{
+    crefl_db_check_full,
+    crefl_db_check_vector,
+    crefl_db_check_defer,
+    crefl_db_check_trusted
 };
 
+void crefl_db_set_check(enum crefl_db_check check);
+int crefl_db_check_links(decl_db *db);
+u64 crefl_db_checksum(const void *addr, size_t len);
+
 /* decl db magic and size */
 int crefl_db_magic(const void *addr);
 size_t crefl_db_size(decl_db *db);
 
+/*
+ * decl db packing
+ *
+ * crefl_db_set_packed selects a packed decl table for images written
+ * from db. packed tables store VLU coded records with links relative to
+ * the node and a dictionary of (tag, props) pairs, and are typically a
+ * third of the size. they are decoded to the heap on load, so attach
+ * and mmap of packed images copy. reading a packed image sets packed.
+ */
+void crefl_db_set_packed(decl_db *db, int packed);
+
+/*
+ * decl db lookup index
+ *
+ * crefl_db_set_index adds a lookup index section to images written from
+ * db, so that crefl_lookup_by_fqn and crefl_lookup_by_hash on a loaded
+ * image probe it in place instead of building an index. the section is
+ * adopted without copying by attach and mmap, and is dropped with the
+ * derived tables when nodes or names are appended. the full and vector
+ * check policies check its slots. reading an indexed image sets index.
+ *
+ * crefl_db_index_size and crefl_db_index_write are used by the writer,
+ * and crefl_db_index_check by the check policies.
+ */
+void crefl_db_set_index(decl_db *db, int index);
+size_t crefl_db_index_size(decl_db *db);
+void crefl_db_index_write(decl_db *db, uint8_t *buf);
+size_t crefl_db_index_section_size(const void *section);
+int crefl_db_index_check(decl_db *db);
+
 /* decl db memory io */
 int crefl_db_read_mem(decl_db *db, const uint8_t *buf, size_t input_sz);
 int crefl_db_write_mem(decl_db *db, uint8_t *buf, size_t output_sz);
@@ -54,6 +192,32 @@ int crefl_db_write_mem(decl_db *db, uint8_t *buf, size_t output_sz);
 int crefl_db_read_file(decl_db *db, const char *input_filename);
 int crefl_db_write_file(decl_db *db, const char *output_filename);
 
+/*
+ * decl db attach
+ *
+ * crefl_db_attach_mem creates a read-only view over a const image such
+ * as the __crefl_*_data arrays emitted by crefltool --emit, without
+ * copying. links are checked according to the check policy unless the
+ * image is flagged as checked.
+ * images that are not 8-byte aligned are copied. the image must outlive
+ * the db or any append to it. returns NULL on error.
+ */
+decl_db * crefl_db_attach_mem(const uint8_t *buf, size_t input_sz);
+
+/*
+ * decl db memory map
+ *
+ * crefl_db_open_mmap maps a db file read-only and points the decl and
+ * name tables directly into the mapping. links are checked according
+ * to the check policy. with crefl_db_check_defer only the header and
+ * builtin prefix are checked so open time is independent of file size.
+ * nodes must not be modified in place. appending nodes or names copies
+ * the tables to the heap first. crefl_db_destroy releases the mapping.
+ * returns NULL on error.
+ */
+decl_db * crefl_db_open_mmap(const char *input_filename);
+void crefl_db_unmap(decl_db *db);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,71 @@
+/*
+ * <crefl/handle.h>
+ *
+ * crefl runtime library and compiler plug-in to support reflection in C.
+ *
+ * Copyright (c) 2020-2022 Michael Clark <michaeljclark@mac.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct decl_db_handle;
+struct decl_db_snapshot;
+
+typedef struct decl_db_handle decl_db_handle;
+typedef struct decl_db_snapshot decl_db_snapshot;
+
+/*
+ * decl db handle
+ *
+ * a handle holds the current version of a db that is replaced while
+ * other threads query it. readers pin a snapshot of the current version,
+ * query its db and unpin it. a new db is frozen and published with one
+ * atomic store, and the db of a replaced version is destroyed by the
+ * last reader to unpin it, so neither readers nor reloads wait for each
+ * other. decl_refs into a snapshot db are only valid while it is pinned.
+ *
+ * - crefl_handle_new takes ownership of db, which may be NULL.
+ * - crefl_handle_pin returns the current snapshot pinned. it is lock free
+ *   and returns NULL if the handle holds no db.
+ * - crefl_handle_swap freezes db and makes it the current version,
+ *   taking ownership. it returns the new version number.
+ * - crefl_handle_reload maps an image with crefl_db_open_mmap and swaps
+ *   it in, returning the new version, or -1 if the image does not open,
+ *   in which case the current version is kept.
+ * - crefl_handle_destroy destroys all versions. no snapshot may be pinned.
+ *
+ * the memory of a replaced snapshot, but not its db, is kept until a
+ * later swap or destroy finds no pin in progress.
+ */
+decl_db_handle * crefl_handle_new(decl_db *db);
+void crefl_handle_destroy(decl_db_handle *h);
+decl_db_snapshot * crefl_handle_pin(decl_db_handle *h);
+void crefl_snapshot_unpin(decl_db_snapshot *s);
+decl_db * crefl_snapshot_db(decl_db_snapshot *s);
+uint64_t crefl_snapshot_version(decl_db_snapshot *s);
+int64_t crefl_handle_swap(decl_db_handle *h, decl_db *db);
+int64_t crefl_handle_reload(decl_db_handle *h, const char *input_filename);
+uint64_t crefl_handle_version(decl_db_handle *h);
+
+#ifdef __cplusplus
+}
+#endif
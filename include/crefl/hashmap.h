@@ -32,6 +32,10 @@
  * that eliminates the need for empty and deleted key sentinels.
  * The hashmap has a simple array of key and value pairs and the
  * tombstone bitmap, which are allocated in a single call to malloc.
+ *
+ * Erase uses backward shift deletion. Entries following the erased
+ * slot that are displaced past it are moved back, so that erase does
+ * not leave tombstones and probe lengths do not degrade with churn.
  */
 
 template <class Key, class Value,
@@ -96,7 +100,7 @@ struct hashmap
         used(0), tombs(0), limit(initial_size)
     {
         size_t data_size = sizeof(data_type) * limit;
-        size_t bitmap_size = limit >> 2;
+        size_t bitmap_size = bitmap_bytes(limit);
         size_t total_size = data_size + bitmap_size;
 
         assert(is_pow2(limit));
@@ -115,7 +119,7 @@ struct hashmap
         used(o.used), tombs(o.tombs), limit(o.limit)
     {
         size_t data_size = sizeof(data_type) * limit;
-        size_t bitmap_size = limit >> 2;
+        size_t bitmap_size = bitmap_bytes(limit);
         size_t total_size = data_size + bitmap_size;
 
         data = (data_type*)malloc(total_size);
@@ -140,7 +144,7 @@ struct hashmap
         limit = o.limit;
 
         size_t data_size = sizeof(data_type) * limit;
-        size_t bitmap_size = limit >> 2;
+        size_t bitmap_size = bitmap_bytes(limit);
         size_t total_size = data_size + bitmap_size;
 
         data = (data_type*)malloc(total_size);
@@ -175,7 +179,7 @@ struct hashmap
     inline size_t hash_index(uint64_t h) { return h & index_mask(); }
     inline size_t key_index(Key key) { return hash_index(_hasher(key)); }
     inline hasher hash_function() const { return _hasher; }
-    inline iterator begin() { return iterator{ this, 0 }; }
+    inline iterator begin() { iterator i{ this, 0 }; i.i = i.step(0); return i; }
     inline iterator end() { return iterator{ this, limit }; }
 
     /*
@@ -200,6 +204,8 @@ struct hashmap
         bitmap[bitmap_idx(i)] &= ~(value << bitmap_shift(i));
     }
     static inline bool is_pow2(intptr_t n) { return  ((n & -n) == n); }
+    /* the bitmap is read in words, so small tables round up to a word */
+    static inline size_t bitmap_bytes(size_t n) { return ((n + 31) >> 5) << 3; }
 
     /**
      * the implementation
@@ -209,7 +215,7 @@ struct hashmap
                          size_t old_size, size_t new_size)
     {
         size_t data_size = sizeof(data_type) * new_size;
-        size_t bitmap_size = new_size >> 2;
+        size_t bitmap_size = bitmap_bytes(new_size);
         size_t total_size = data_size + bitmap_size;
 
         assert(is_pow2(new_size));
@@ -238,7 +244,7 @@ struct hashmap
     void clear()
     {
         size_t data_size = sizeof(data_type) * limit;
-        size_t bitmap_size = limit >> 2;
+        size_t bitmap_size = bitmap_bytes(limit);
         size_t total_size = data_size + bitmap_size;
         memset(data, 0, total_size);
         used = tombs = 0;
@@ -316,20 +322,43 @@ struct hashmap
 
     void erase(Key key)
     {
-        for (size_t i = key_index(key); ; i = (i+1) & index_mask()) {
-            bitmap_state state = bitmap_get(bitmap, i);
-                 if (state == available)           /* notfound */ break;
-            else if (state == deleted);            /* skip */
-            else if (_compare(data[i].first, key)) {
-                bitmap_set(bitmap, i, deleted);
-                data[i].first = Key(0);
-                data[i].second = Value(0);
-                bitmap_clear(bitmap, i, occupied);
-                used--;
-                tombs++;
-                return;
+        iterator e = find(key);
+        if (e == end()) return;
+
+        /*
+         * move back each following entry whose home slot is not between
+         * the hole and the entry, until the run ends at an available slot.
+         */
+        size_t i = e.i;
+        for (size_t j = (i+1) & index_mask();
+             (bitmap_get(bitmap, j) & occupied) == occupied;
+             j = (j+1) & index_mask()) {
+            size_t k = key_index(data[j].first);
+            if (((j - k) & index_mask()) >= ((j - i) & index_mask())) {
+                data[i] = data[j];
+                i = j;
             }
         }
+        bitmap_clear(bitmap, i, recycled);
+        data[i].first = Key(0);
+        data[i].second = Value(0);
+        used--;
+    }
+
+    /* grow so that n entries fit without a resize */
+    void reserve(size_t n)
+    {
+        size_t new_size = limit;
+        while (n * load_multiplier / new_size > load_factor) new_size <<= 1;
+        if (new_size != limit) resize_internal(data, bitmap, limit, new_size);
+    }
+
+    /* shrink to the smallest size that holds the entries */
+    void shrink_to_fit()
+    {
+        size_t new_size = default_size;
+        while (used * load_multiplier / new_size > load_factor) new_size <<= 1;
+        if (new_size != limit) resize_internal(data, bitmap, limit, new_size);
     }
 
     bool operator==(const hashmap &o) const
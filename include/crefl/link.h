@@ -43,16 +43,34 @@ struct decl_hash
     uint8_t sum[sha224_hash_size];
 };
 
+/*
+ * node identity hash algorithms. sha224 is the default. fast is a
+ * 128-bit non-cryptographic hash stored in the first 16 bytes of sum.
+ */
+enum decl_hash_alg
+{
+    decl_hash_sha224,
+    decl_hash_fast
+};
+
 enum decl_entry_props
 {
     decl_entry_marked = 1,
-    decl_entry_valid = 2
+    decl_entry_valid = 2,
+    decl_entry_fqn = 4
 };
 
+/*
+ * the fqn of an entry is the fqn of the fqn_parent entry followed by
+ * the fqn_name component from the db name table, if it is not zero.
+ * fqn is an offset in the index name table set by crefl_entry_fqn.
+ */
 struct decl_entry
 {
     decl_id fqn;
     decl_set props;
+    decl_id fqn_parent;
+    decl_id fqn_name;
     decl_hash hash;
 };
 
@@ -71,6 +89,15 @@ struct decl_index
     decl_entry *entry;
     size_t entry_offset;
     size_t entry_size;
+
+    /* fqn interning table */
+    decl_name_intern *name_intern;
+
+    /* node identity hash algorithm, see decl_hash_alg */
+    u32 hash_alg;
+
+    /* db the entries were scanned from */
+    decl_db *db;
 };
 
 decl_index* crefl_index_new();
@@ -86,7 +113,49 @@ int crefl_entry_is_marked(decl_entry_ref d);
 int crefl_entry_is_valid(decl_entry_ref d);
 
 void crefl_index_scan(decl_index *index, decl_db *db);
+
+/*
+ * crefl_db_link_hashes scans db with its hash algorithm and keeps the
+ * entries in the db so that crefl_db_write_mem persists them. entries
+ * are dropped by crefl_db_invalidate. crefl_index_scan adopts persisted
+ * entries with a matching algorithm instead of hashing the db.
+ */
+int crefl_db_link_hashes(decl_db *db);
+
+/*
+ * crefl_lookup_by_hash returns the first node in db with a persisted
+ * hash, probing the lookup index of an image if it has one.
+ */
+decl_ref crefl_lookup_by_hash(decl_db *db, const decl_hash *hash);
+
 int crefl_link_merge(decl_db *dst, const char *name, decl_db **srcn, size_t n);
+int crefl_link_merge_jobs(decl_db *dst, const char *name, decl_db **srcn,
+    size_t n, size_t jobs);
+
+/*
+ * crefl_link_update replaces the sources of the archive db that have the
+ * same names as the input sources and appends the others. only nodes not
+ * already in the archive are appended. persisted hashes are kept up to
+ * date without rescanning the archive.
+ */
+int crefl_link_update(decl_db *db, decl_db **srcn, size_t n, size_t jobs);
+
+/*
+ * crefl_link_compact drops the nodes and names of db that are not
+ * reachable from the root element, such as the sources replaced by
+ * crefl_link_update, collapses alias chains to a single hop and renumbers
+ * the remaining nodes. persisted hashes are kept. a frozen db is not
+ * compacted.
+ */
+int crefl_link_compact(decl_db *db);
+
+/*
+ * crefl_link_optimize_layout renumbers the nodes of db so that children
+ * follow their parent contiguously, e.g. a struct is followed by its
+ * fields and their types, so that traversals touch adjacent nodes.
+ * persisted hashes are kept.
+ */
+int crefl_link_optimize_layout(decl_db *db);
 
 #ifdef __cplusplus
 }
@@ -63,10 +63,22 @@ typedef double f64;
 struct decl_node;
 struct decl_db;
 struct decl_ref;
+struct decl_name_index;
+struct decl_layout;
+struct decl_intrinsic_map;
+struct decl_child_index;
+struct decl_name_intern;
+struct decl_columns;
 
 typedef struct decl_node decl_node;
 typedef struct decl_db decl_db;
 typedef struct decl_ref decl_ref;
+typedef struct decl_name_index decl_name_index;
+typedef struct decl_layout decl_layout;
+typedef struct decl_intrinsic_map decl_intrinsic_map;
+typedef struct decl_child_index decl_child_index;
+typedef struct decl_name_intern decl_name_intern;
+typedef struct decl_columns decl_columns;
 typedef union decl_raw decl_raw;
 
 typedef u32 decl_tag;
@@ -147,6 +159,13 @@ struct decl_node
  * decl db
  *
  * reflection database containing decl nodes and symbol table.
+ *
+ * derived tables are built on demand and each is dropped when it is
+ * stale. appending nodes drops all of them and appending names drops
+ * the tables derived from names. modifying nodes in place through
+ * crefl_decl_ptr after a query requires a call to crefl_db_invalidate.
+ * a db is not safe for concurrent queries until it is frozen with
+ * crefl_db_freeze.
  */
 struct decl_db
 {
@@ -161,6 +180,50 @@ struct decl_db
     size_t decl_size;
 
     decl_id root_element;
+
+    /* node identity hash algorithm used to link the db, see link.h */
+    u32 hash_alg;
+
+    /* images are written with a packed decl table, see crefl_db_set_packed */
+    u32 packed;
+
+    /* images are written with a lookup index, see crefl_db_set_index */
+    u32 indexed;
+
+    /* image backing decl and name, see crefl_db_open_mmap and
+     * crefl_db_attach_mem. map_size is zero for attached images */
+    void *map_addr;
+    size_t map_size;
+
+    /* builtin intrinsic lookup table, shared with crefl_db_builtin */
+    decl_intrinsic_map *intrinsic_map;
+
+    /* name interning table, see crefl_db_set_intern */
+    decl_name_intern *name_intern;
+
+    /* scans use the column table, see crefl_db_set_columns */
+    u32 column_mode;
+
+    /* derived tables are built and nodes are immutable, see
+     * crefl_db_freeze */
+    u32 frozen;
+
+    /* persisted link index entries, see crefl_db_link_hashes. entries
+     * point into the image when hash_image is set, else the heap */
+    struct decl_entry *hash_entry;
+    size_t hash_count;
+    u32 hash_image;
+
+    /* lookup index section, see crefl_db_set_index. points into the
+     * image when lookup_image is set, else the heap */
+    const void *lookup;
+    u32 lookup_image;
+
+    /* derived tables */
+    decl_name_index *name_index;
+    decl_layout *layout;
+    decl_child_index *child_index;
+    decl_columns *columns;
 };
 
 /*
@@ -315,8 +378,30 @@ int crefl_is_alias(decl_ref d);
  */
 decl_db * crefl_db_new();
 void crefl_db_defaults(decl_db *db);
+
+void crefl_db_invalidate(decl_db *db);
 void crefl_db_destroy(decl_db *db);
 
+/*
+ * crefl_db_builtin returns the process-wide builtin segment, a db holding
+ * only the builtin types that is built once and never modified. empty dbs
+ * passed to crefl_db_defaults copy its nodes and names and share its
+ * intrinsic lookup table. it must not be modified or destroyed.
+ */
+const decl_db * crefl_db_builtin();
+
+/*
+ * crefl_db_freeze builds the derived tables of db, the name index, child
+ * index, layout table and, in column mode, the column table, and marks
+ * it immutable so that queries from many threads are pure reads and need
+ * no locks. appending nodes or names, crefl_db_invalidate and changing
+ * the column mode abort, and crefl_db_link_hashes fails. nodes must not
+ * be modified through crefl_decl_ptr. the tables are written before
+ * crefl_db_freeze returns, so a frozen db can be shared with threads
+ * created afterwards or published with a release store or a lock.
+ */
+int crefl_db_freeze(decl_db *db);
+
 /*
  * decl properties
  */
@@ -336,12 +421,42 @@ decl_sz crefl_decl_qty(decl_ref d);
 decl_id crefl_name_new(decl_db *db, const char *name);
 decl_ref crefl_decl_new(decl_db *db, decl_tag tag);
 
+/*
+ * name interning
+ *
+ * when interning is enabled, crefl_name_new returns the offset of an
+ * existing identical name instead of appending a copy, so equal names
+ * have equal name ids. enabling interning indexes the existing names.
+ * the crefl_intern functions map names to offsets in a caller's table.
+ */
+void crefl_db_set_intern(decl_db *db, int intern);
+u64 crefl_name_hash(const char *s, size_t len);
+decl_name_intern * crefl_intern_new();
+void crefl_intern_destroy(decl_name_intern *in);
+decl_id crefl_intern_find(decl_name_intern *in, const char *table,
+    const char *name, size_t len);
+void crefl_intern_add(decl_name_intern *in, const char *name, size_t len,
+    decl_id offset);
+
+/*
+ * column mode
+ *
+ * when column mode is enabled, scans by tag, props and quantity read
+ * dense per-column copies of the tag, props and quantity fields instead
+ * of whole nodes, and tag compares are vectorized. the columns are built
+ * from the nodes on first use and dropped by crefl_db_invalidate, so the
+ * nodes remain the primary storage and node accessors are unchanged.
+ */
+void crefl_db_set_columns(decl_db *db, int columns);
+
 /*
  * decl queries
  */
 decl_ref crefl_root(decl_db *db);
 decl_ref crefl_intrinsic(decl_db *db, decl_set props, size_t width);
 decl_ref crefl_lookup(decl_db *db, size_t decl_idx);
+decl_ref crefl_lookup_by_name(decl_db *db, const char *name);
+decl_ref crefl_lookup_by_fqn(decl_db *db, const char *fqn);
 const char* crefl_tag_name(decl_tag tag);
 const char* crefl_decl_name(decl_ref d);
 int crefl_decl_has_name(decl_ref d);
@@ -368,6 +483,24 @@ int crefl_source_types(decl_ref f, decl_ref *r, size_t *s);
 int crefl_source_fields(decl_ref f, decl_ref *r, size_t *s);
 int crefl_source_functions(decl_ref f, decl_ref *r, size_t *s);
 int crefl_archive_sources(decl_ref d, decl_ref *r, size_t *s);
+int crefl_db_tag_decls(decl_db *db, decl_tag tag, decl_ref *r, size_t *s);
+
+/*
+ * decl spans
+ *
+ * zero-copy variants of the list queries that return a pointer to a
+ * contiguous array of decl ids from the child index. spans remain valid
+ * until the database is modified. the tag filter is the container's
+ * canonical member type, so source spans include all declarations.
+ */
+const decl_id * crefl_enum_constants_span(decl_ref d, size_t *s);
+const decl_id * crefl_set_constants_span(decl_ref d, size_t *s);
+const decl_id * crefl_struct_fields_span(decl_ref d, size_t *s);
+const decl_id * crefl_union_fields_span(decl_ref d, size_t *s);
+const decl_id * crefl_function_params_span(decl_ref d, size_t *s);
+const decl_id * crefl_source_decls_span(decl_ref d, size_t *s);
+const decl_id * crefl_archive_sources_span(decl_ref d, size_t *s);
+
 decl_raw crefl_constant_value(decl_ref d);
 void * crefl_function_addr(decl_ref d);
 
@@ -0,0 +1,155 @@
+/*
+ * Concurrent hash table with lock striped hashmap shards.
+ *
+ * Copyright (c) 2020 Michael Clark <michaeljclark@mac.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include <mutex>
+#include <functional>
+
+#include "hashmap.h"
+
+/*
+ * This concurrent hashmap splits keys over a fixed number of shards,
+ * each a hashmap protected by its own mutex, so that threads inserting
+ * different keys rarely contend. The shard is selected by the top bits
+ * of the mixed key hash, as the low bits select the slot in the shard.
+ * Shards are aligned to cache lines so that their locks do not share
+ * a line.
+ *
+ * insert_if_absent is the operation used to deduplicate: it returns the
+ * value in the map after the call, which is the value of the thread
+ * that inserted the key first. Values are returned by copy as entries
+ * may move when a shard resizes or erases.
+ */
+
+template <class Key, class Value,
+          class Hash = std::hash<Key>,
+          class Pred = std::equal_to<Key>,
+          size_t Shards = 64>
+struct shardmap
+{
+    static_assert((Shards & (Shards - 1)) == 0, "shards must be a power of 2");
+
+    typedef hashmap<Key,Value,Hash,Pred> map_type;
+
+    static inline Hash _hasher;
+
+    struct alignas(64) shard {
+        std::mutex lock;
+        map_type map;
+    };
+
+    shard shards[Shards];
+
+    /*
+     * shard selection
+     */
+
+    static inline size_t shard_bits()
+    {
+        size_t b = 0;
+        while (((size_t)1 << b) < Shards) b++;
+        return b;
+    }
+    static inline size_t shard_index(const Key &key)
+    {
+        if (Shards == 1) return 0;
+        uint64_t h = (uint64_t)_hasher(key) * 0x9e3779b97f4a7c15ull;
+        return (size_t)(h >> (64 - shard_bits()));
+    }
+    inline shard& shard_of(const Key &key) { return shards[shard_index(key)]; }
+
+    /*
+     * member functions
+     */
+
+    Value insert_if_absent(const Key &key, const Value &val)
+    {
+        shard &s = shard_of(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        auto i = s.map.find(key);
+        if (i != s.map.end()) return i->second;
+        s.map.insert(key, val);
+        return val;
+    }
+
+    void insert(const Key &key, const Value &val)
+    {
+        shard &s = shard_of(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        s.map.insert(key, val);
+    }
+
+    bool find(const Key &key, Value *val)
+    {
+        shard &s = shard_of(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        auto i = s.map.find(key);
+        if (i == s.map.end()) return false;
+        if (val) *val = i->second;
+        return true;
+    }
+
+    void erase(const Key &key)
+    {
+        shard &s = shard_of(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        s.map.erase(key);
+    }
+
+    /* grow each shard for an even split of n entries */
+    void reserve(size_t n)
+    {
+        for (size_t i = 0; i < Shards; i++) {
+            std::lock_guard<std::mutex> guard(shards[i].lock);
+            shards[i].map.reserve((n + Shards - 1) / Shards);
+        }
+    }
+
+    /* the sum of the shard sizes, which is exact if there are no writers */
+    size_t size()
+    {
+        size_t n = 0;
+        for (size_t i = 0; i < Shards; i++) {
+            std::lock_guard<std::mutex> guard(shards[i].lock);
+            n += shards[i].map.size();
+        }
+        return n;
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < Shards; i++) {
+            std::lock_guard<std::mutex> guard(shards[i].lock);
+            shards[i].map.clear();
+        }
+    }
+
+    /* visit entries one shard at a time with the shard locked */
+    template <typename F>
+    void for_each(F fn)
+    {
+        for (size_t i = 0; i < Shards; i++) {
+            std::lock_guard<std::mutex> guard(shards[i].lock);
+            for (auto &e : shards[i].map) fn(e.first, e.second);
+        }
+    }
+};
@@ -0,0 +1,375 @@
+/*
+ * Open addressing hash table with SIMD probed control bytes.
+ *
+ * Copyright (c) 2020 Michael Clark <michaeljclark@mac.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cstddef>
+#include <cassert>
+
+#include <utility>
+#include <functional>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "bits.h"
+
+/*
+ * This open addressing hashmap is a sibling of hashmap with the same
+ * interface. It keeps a control byte per slot holding a 7-bit fragment
+ * of the key hash, or the empty and deleted states which have the top
+ * bit set. Slots are probed in aligned groups of 16 control bytes that
+ * are compared with one SSE2 compare, and keys are only compared for
+ * slots whose fragment matches. Groups are visited in triangular order
+ * and lookups stop at the first group with an empty slot.
+ *
+ * Erase leaves a deleted byte only if the group of the slot is full,
+ * as only full groups can be passed by a probe, and the table is
+ * rehashed at the same size when deleted slots dominate. The key and
+ * value array and the control bytes are allocated in a single call to
+ * malloc. The load factor is 7/8.
+ */
+
+template <class Key, class Value,
+          class Hash = std::hash<Key>,
+          class Pred = std::equal_to<Key>>
+struct swissmap
+{
+    static const size_t default_size =    (2<<3);  /* 16 */
+    static const size_t group_size =      (2<<3);  /* 16 */
+
+    static inline Hash _hasher;
+    static inline Pred _compare;
+
+    struct data_type {
+        Key first;
+        Value second;
+    };
+
+    typedef Key key_type;
+    typedef Value mapped_type;
+    typedef std::pair<Key, Value> value_type;
+    typedef Hash hasher;
+    typedef Pred key_equal;
+    typedef data_type& reference;
+    typedef const data_type& const_reference;
+
+    enum ctrl_state : uint8_t {
+        empty = 0x80, deleted = 0xfe
+    };
+
+    size_t used;
+    size_t tombs;
+    size_t limit;
+    data_type *data;
+    uint8_t *ctrl;
+
+    /*
+     * scanning iterator
+     */
+
+    struct iterator
+    {
+        swissmap *h;
+        size_t i;
+
+        size_t step(size_t i) {
+            while (i < h->limit && !is_full(h->ctrl[i])) i++;
+            return i;
+        }
+        iterator& operator++() { i = step(i+1); return *this; }
+        iterator operator++(int) { iterator r = *this; ++(*this); return r; }
+        data_type& operator*() { i = step(i); return h->data[i]; }
+        data_type* operator->() { i = step(i); return &h->data[i]; }
+        bool operator==(const iterator &o) const { return h == o.h && i == o.i; }
+        bool operator!=(const iterator &o) const { return h != o.h || i != o.i; }
+    };
+
+    /*
+     * constructors and destructor
+     */
+
+    inline swissmap() : swissmap(default_size) {}
+    inline swissmap(size_t initial_size) :
+        used(0), tombs(0), limit(initial_size)
+    {
+        assert(is_pow2(limit) && limit >= group_size);
+        alloc_internal(limit);
+    }
+    inline ~swissmap() { free(data); }
+
+    /*
+     * copy constructor and assignment operator
+     */
+
+    inline swissmap(const swissmap &o) :
+        used(o.used), tombs(o.tombs), limit(o.limit)
+    {
+        alloc_internal(limit);
+        memcpy(data, o.data, total_size(limit));
+    }
+
+    inline swissmap(swissmap &&o) :
+        used(o.used), tombs(o.tombs), limit(o.limit),
+        data(o.data), ctrl(o.ctrl)
+    {
+        o.data = nullptr;
+        o.ctrl = nullptr;
+    }
+
+    inline swissmap& operator=(const swissmap &o)
+    {
+        free(data);
+
+        used = o.used;
+        tombs = o.tombs;
+        limit = o.limit;
+
+        alloc_internal(limit);
+        memcpy(data, o.data, total_size(limit));
+
+        return *this;
+    }
+
+    inline swissmap& operator=(swissmap &&o)
+    {
+        free(data);
+
+        data = o.data;
+        ctrl = o.ctrl;
+        used = o.used;
+        tombs = o.tombs;
+        limit = o.limit;
+
+        o.data = nullptr;
+        o.ctrl = nullptr;
+
+        return *this;
+    }
+
+    /*
+     * member functions
+     */
+
+    inline size_t size() { return used; }
+    inline size_t capacity() { return limit; }
+    inline size_t group_mask() { return (limit / group_size) - 1; }
+    inline hasher hash_function() const { return _hasher; }
+    inline iterator begin() { iterator i{ this, 0 }; i.i = i.step(0); return i; }
+    inline iterator end() { return iterator{ this, limit }; }
+
+    /*
+     * control byte helpers
+     *
+     * the key hash is mixed so that maps keyed by hashes that are the
+     * identity, such as std::hash<uint64_t>, spread over the groups.
+     * the low 7 bits are the fragment and the rest select the group.
+     */
+
+    static inline bool is_pow2(intptr_t n) { return  ((n & -n) == n); }
+    static inline bool is_full(uint8_t c) { return (c & 0x80) == 0; }
+    static inline uint64_t mix(uint64_t h)
+    {
+        h *= 0x9e3779b97f4a7c15ull;
+        return h ^ (h >> 32);
+    }
+    static inline uint8_t hash_frag(uint64_t h) { return h & 0x7f; }
+    inline size_t hash_group(uint64_t h) { return (h >> 7) & group_mask(); }
+
+    static inline size_t data_size(size_t n) { return sizeof(data_type) * n; }
+    static inline size_t total_size(size_t n) { return data_size(n) + n; }
+
+    /* mask with bit i set if control byte i of the group equals c */
+    static inline uint32_t group_match(const uint8_t *g, uint8_t c)
+    {
+#if defined(__SSE2__)
+        __m128i v = _mm_loadu_si128((const __m128i*)g);
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8((char)c)));
+#else
+        uint32_t m = 0;
+        for (size_t i = 0; i < group_size; i++) m |= (uint32_t)(g[i] == c) << i;
+        return m;
+#endif
+    }
+
+    /* mask with bit i set if slot i of the group is empty or deleted */
+    static inline uint32_t group_free(const uint8_t *g)
+    {
+#if defined(__SSE2__)
+        return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)g));
+#else
+        uint32_t m = 0;
+        for (size_t i = 0; i < group_size; i++) m |= (uint32_t)(g[i] >> 7) << i;
+        return m;
+#endif
+    }
+
+    /**
+     * the implementation
+     */
+
+    void alloc_internal(size_t new_size)
+    {
+        data = (data_type*)malloc(total_size(new_size));
+        ctrl = (uint8_t*)data + data_size(new_size);
+        memset(ctrl, empty, new_size);
+        limit = new_size;
+    }
+
+    void resize_internal(size_t new_size)
+    {
+        data_type *old_data = data;
+        uint8_t *old_ctrl = ctrl;
+        size_t old_size = limit;
+
+        assert(is_pow2(new_size) && new_size >= group_size);
+        alloc_internal(new_size);
+
+        for (size_t i = 0; i < old_size; i++) {
+            if (!is_full(old_ctrl[i])) continue;
+            uint64_t h = mix(_hasher(old_data[i].first));
+            size_t j = free_index(h);
+            ctrl[j] = hash_frag(h);
+            data[j] = old_data[i];
+        }
+
+        tombs = 0;
+        free(old_data);
+    }
+
+    /*
+     * index of the slot holding key, or limit. if slot is not null it is
+     * set to the first empty slot of the last group probed, which is the
+     * first free slot in the probe sequence if there are no deleted slots.
+     */
+    size_t find_index(const Key &key, uint64_t h, size_t *slot = nullptr)
+    {
+        uint8_t frag = hash_frag(h);
+        for (size_t g = hash_group(h), n = 0; ; g = (g + ++n) & group_mask()) {
+            const uint8_t *c = ctrl + g * group_size;
+            for (uint32_t m = group_match(c, frag); m; m &= m - 1) {
+                size_t i = g * group_size + ctz_u32(m);
+                if (_compare(data[i].first, key)) return i;
+            }
+            uint32_t e = group_match(c, empty);
+            if (e) {
+                if (slot) *slot = g * group_size + ctz_u32(e);
+                return limit;
+            }
+        }
+    }
+
+    /* index of the first empty or deleted slot in the probe sequence */
+    size_t free_index(uint64_t h)
+    {
+        for (size_t g = hash_group(h), n = 0; ; g = (g + ++n) & group_mask()) {
+            uint32_t m = group_free(ctrl + g * group_size);
+            if (m) return g * group_size + ctz_u32(m);
+        }
+    }
+
+    /* grow, or rehash in place if deleted slots dominate, before insert */
+    void reserve_one()
+    {
+        if ((used + tombs + 1) * 8 <= limit * 7) return;
+        resize_internal(used * 2 >= limit ? limit << 1 : limit);
+    }
+
+    size_t insert_index(const Key &key, uint64_t h, size_t slot)
+    {
+        size_t i = slot;
+        if (tombs || (used + 1) * 8 > limit * 7) {
+            reserve_one();
+            i = free_index(h);
+        }
+        if (ctrl[i] == deleted) tombs--;
+        ctrl[i] = hash_frag(h);
+        data[i].first = key;
+        used++;
+        return i;
+    }
+
+    void clear()
+    {
+        memset(ctrl, empty, limit);
+        used = tombs = 0;
+    }
+
+    iterator insert(iterator i, const value_type& val) { return insert(val); }
+    iterator insert(Key key, Value val) { return insert(value_type(key, val)); }
+
+    iterator insert(const value_type& v)
+    {
+        uint64_t h = mix(_hasher(v.first));
+        size_t slot, i = find_index(v.first, h, &slot);
+        if (i == limit) i = insert_index(v.first, h, slot);
+        data[i].second = v.second;
+        return iterator{this, i};
+    }
+
+    Value& operator[](const Key &key)
+    {
+        uint64_t h = mix(_hasher(key));
+        size_t slot, i = find_index(key, h, &slot);
+        if (i == limit) i = insert_index(key, h, slot);
+        return data[i].second;
+    }
+
+    iterator find(const Key &key)
+    {
+        size_t i = find_index(key, mix(_hasher(key)));
+        return iterator{this, i};
+    }
+
+    void erase(Key key)
+    {
+        size_t i = find_index(key, mix(_hasher(key)));
+        if (i == limit) return;
+        const uint8_t *g = ctrl + (i & ~(group_size - 1));
+        if (group_match(g, empty)) {
+            ctrl[i] = empty;
+        } else {
+            ctrl[i] = deleted;
+            tombs++;
+        }
+        data[i].first = Key(0);
+        data[i].second = Value(0);
+        used--;
+    }
+
+    bool operator==(const swissmap &o) const
+    {
+        for (auto i : const_cast<swissmap&>(*this)) {
+            auto j = const_cast<swissmap&>(o).find(i.first);
+            if (j == const_cast<swissmap&>(o).end()) return false;
+            if (i.second != j->second) return false;
+        }
+        for (auto i : const_cast<swissmap&>(o)) {
+            auto j = const_cast<swissmap&>(*this).find(i.first);
+            if (j == const_cast<swissmap&>(*this).end()) return false;
+            if (i.second != j->second) return false;
+        }
+        return true;
+    }
+
+    bool operator!=(const swissmap &o) const { return !(*this == o); }
+};
@@ -163,8 +163,7 @@ static void _print(decl_ref r, size_t depth)
 
 int main(int argc, const char **argv)
 {
-    decl_db *db = crefl_db_new();
-    crefl_db_read_mem(db, __crefl_main_data, __crefl_main_size);
+    decl_db *db = crefl_db_attach_mem(__crefl_main_data, __crefl_main_size);
 
     size_t nsources = 0;
     crefl_archive_sources(crefl_root(db), NULL, &nsources);
@@ -165,37 +165,7 @@ static void _print_type(decl_ref r, void *ptr, size_t offset, size_t depth)
 
 decl_ref crefl_type_by_name(decl_db *db, const char *name)
 {
-    decl_ref t = { db, 0 };
-
-    size_t nsources = 0;
-    crefl_archive_sources(crefl_root(db), NULL, &nsources);
-    assert(nsources == 1);
-    decl_ref *_sources = calloc(nsources, sizeof(decl_ref));
-    assert(_sources);
-    crefl_archive_sources(crefl_root(db), _sources, &nsources);
-
-    size_t ntypes = 0;
-    crefl_source_decls(_sources[0], NULL, &ntypes);
-    decl_ref *_types = calloc(ntypes, sizeof(decl_ref));
-    assert(_types);
-    crefl_source_decls(_sources[0], _types, &ntypes);
-
-    /* fix me - currently we can only find struct */
-    if (strncmp(name, "struct ", 7) == 0) {
-        name +=7;
-        for (size_t i = 0; i < ntypes; i++) {
-            decl_ref r = _types[i];
-            if (crefl_is_struct(r) && strcmp(crefl_decl_name(r), name) == 0) {
-                t = r;
-                break;
-            }
-        }
-    }
-
-    free(_types);
-    free(_sources);
-
-    return t;
+    return crefl_lookup_by_name(db, name);
 }
 
 extern const unsigned char __crefl_main_data[];
@@ -203,8 +173,7 @@ extern const size_t __crefl_main_size;
 
 decl_db* crefl_db_internal()
 {
-    decl_db *db = crefl_db_new();
-    crefl_db_read_mem(db, __crefl_main_data, __crefl_main_size);
+    decl_db *db = crefl_db_attach_mem(__crefl_main_data, __crefl_main_size);
     return db;
 }
 
@@ -18,6 +18,7 @@
 
 #include <cstdio>
 #include <cstdint>
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
 #include <cerrno>
@@ -25,9 +26,25 @@
 
 #include <vector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include <crefl/util.h>
+#include <crefl/bits.h>
+#include <crefl/buf.h>
+#include <crefl/asn1.h>
 #include <crefl/model.h>
+#include <crefl/link.h>
 #include <crefl/db.h>
+#include <crefl/hashmap.h>
 
 /*
  * decl db magic and size
@@ -38,21 +55,371 @@ int crefl_db_magic(const void *addr)
     return memcmp(addr, decl_db_magic, sizeof(decl_db_magic));
 }
 
-size_t crefl_db_size(decl_db *db)
+/*
+ * crefl000 images have a header without flags or checksum and elide the
+ * builtin prefix of the decl and name tables, so they are read by copying
+ * onto the defaults and are never mapped. writers emit crefl001.
+ */
+static const u8 decl_db_magic_v0[8] = { 'c', 'r', 'e', 'f', 'l', '0', '0', '0' };
+
+struct _db_hdr_v0
+{
+    u8 magic[8];
+    u32 decl_entry_count;
+    u32 name_table_size;
+    u32 root_element;
+};
+
+static int _db_is_v0(const uint8_t *buf, size_t input_sz)
+{
+    return input_sz >= sizeof(_db_hdr_v0) &&
+        memcmp(buf, decl_db_magic_v0, sizeof(decl_db_magic_v0)) == 0;
+}
+
+/*
+ * the persisted hash section starts at the first multiple of 8 after the
+ * name table so that entries are aligned in mapped and attached images.
+ * decl_sz is the size of the decl table in the image.
+ */
+static size_t _db_hashes_offset(size_t decl_sz, size_t name_sz)
+{
+    size_t sz = sizeof(decl_db_hdr) + decl_sz + name_sz;
+    return (sz + 7) & ~(size_t)7;
+}
+
+static u32 _db_u32(const u8 *p)
+{
+    u32 v;
+    memcpy(&v, p, sizeof(v));
+    return le32(v);
+}
+
+/* size of the decl table of an image, packed tables start with theirs */
+static size_t _db_decl_size(const decl_db_hdr *hdr)
+{
+    if (hdr->flags & decl_db_flag_packed) {
+        return _db_u32((const u8*)(hdr + 1));
+    }
+    return sizeof(decl_node) * hdr->decl_entry_count;
+}
+
+static u32 _db_hashes_version(const decl_db_hdr *hdr)
+{
+    return (hdr->flags & decl_db_flag_hashes_mask) >> decl_db_flag_hashes_shift;
+}
+
+static u32 _db_index_version(const decl_db_hdr *hdr)
+{
+    return (hdr->flags & decl_db_flag_index_mask) >> decl_db_flag_index_shift;
+}
+
+static int _db_has_hashes(decl_db *db)
+{
+    return db->hash_entry && db->hash_count == db->decl_offset;
+}
+
+/* size of the tables and hash section of an image, or zero if unknown */
+static size_t _db_tables_size(const decl_db_hdr *hdr)
+{
+    size_t decl_cnt = hdr->decl_entry_count;
+    size_t decl_sz = _db_decl_size(hdr);
+    size_t name_sz = hdr->name_table_size;
+
+    switch (_db_hashes_version(hdr)) {
+    case 0:
+        return sizeof(decl_db_hdr) + decl_sz + name_sz;
+    case decl_db_hashes_version:
+        return _db_hashes_offset(decl_sz, name_sz) + sizeof(decl_entry) * decl_cnt;
+    default:
+        return 0;
+    }
+}
+
+/* the lookup index section starts at the next multiple of 8 */
+static size_t _db_index_offset(size_t tables_sz)
+{
+    return (tables_sz + 7) & ~(size_t)7;
+}
+
+/*
+ * size of the image described by a header, or zero if unknown. the
+ * header of the lookup index section is read to find its size, so the
+ * caller must check that it is within the image.
+ */
+static size_t _db_image_size(const decl_db_hdr *hdr)
+{
+    size_t tables_sz = _db_tables_size(hdr);
+
+    switch (_db_index_version(hdr)) {
+    case 0:
+        return tables_sz;
+    case decl_db_index_version: {
+        if (tables_sz == 0) return 0;
+        size_t index_off = _db_index_offset(tables_sz);
+        size_t index_sz = crefl_db_index_section_size((const u8*)hdr + index_off);
+        return index_sz ? index_off + index_sz : 0;
+    }
+    default:
+        return 0;
+    }
+}
+
+/*
+ * packed decl table
+ *
+ * the packed table starts with its size in bytes and the size of a
+ * dictionary of (tag, props) pairs, both u32, followed by the pairs and
+ * a VLU coded record for each node. records contain:
+ *
+ * - the dictionary index of the tag and props of the node
+ * - the name, zero or one plus the zigzag delta from the last name
+ * - next, link and attr, zero, or one plus twice a builtin id, or two
+ *   plus twice the zigzag delta from the node id
+ * - the quantity shifted left by one, or one followed by 8 raw bytes
+ *   if it does not fit in the 55 bits of a shifted VLU value
+ *
+ * builtins are packed with the other nodes so the builtin check is the
+ * same as for unpacked images.
+ */
+
+static const size_t _db_packed_hdr = 8;
+static const size_t _db_packed_max = 8 * 6 + 8;
+
+static u64 _zigzag(s64 v) { return ((u64)v << 1) ^ (u64)(v >> 63); }
+static s64 _unzigzag(u64 v) { return (s64)(v >> 1) ^ -(s64)(v & 1); }
+
+static u64 _db_pack_link(decl_id l, size_t i, size_t builtin)
+{
+    if (l == 0) return 0;
+    if (l < builtin) return ((u64)l << 1) | 1;
+    return (_zigzag((s64)l - (s64)i) + 1) << 1;
+}
+
+static decl_id _db_unpack_link(u64 v, size_t i)
+{
+    if (v == 0) return 0;
+    if (v & 1) return (decl_id)(v >> 1);
+    return (decl_id)((s64)i + _unzigzag((v >> 1) - 1));
+}
+
+static void _db_pack(decl_db *db, std::vector<u8> &out)
+{
+    std::vector<u64> dict;
+    hashmap<u64,u32> dict_map;
+    std::vector<u32> dict_idx(db->decl_offset);
+
+    for (size_t i = 0; i < db->decl_offset; i++) {
+        const decl_node *d = db->decl + i;
+        u64 k = ((u64)d->_props << 32) | d->_tag;
+        auto j = dict_map.find(k);
+        if (j == dict_map.end()) {
+            dict_idx[i] = (u32)dict.size();
+            dict_map.insert(k, (u32)dict.size());
+            dict.push_back(k);
+        } else {
+            dict_idx[i] = j->second;
+        }
+    }
+
+    size_t dict_sz = sizeof(u32) * 2 * dict.size();
+    crefl_buf *buf = crefl_buf_new(_db_packed_hdr + dict_sz +
+        _db_packed_max * db->decl_offset);
+    crefl_buf_write_i32(buf, 0);
+    crefl_buf_write_i32(buf, (s32)dict.size());
+    for (size_t i = 0; i < dict.size(); i++) {
+        crefl_buf_write_i32(buf, (s32)(u32)dict[i]);
+        crefl_buf_write_i32(buf, (s32)(u32)(dict[i] >> 32));
+    }
+
+    decl_id last_name = 0;
+    for (size_t i = 0; i < db->decl_offset; i++) {
+        const decl_node *d = db->decl + i;
+        u64 name = d->_name ? _zigzag((s64)d->_name - (s64)last_name) + 1 : 0;
+        if (d->_name) last_name = d->_name;
+        crefl_vlu_u64_write_byval(buf, dict_idx[i]);
+        crefl_vlu_u64_write_byval(buf, name);
+        crefl_vlu_u64_write_byval(buf, _db_pack_link(d->_next, i, db->decl_builtin));
+        crefl_vlu_u64_write_byval(buf, _db_pack_link(d->_link, i, db->decl_builtin));
+        crefl_vlu_u64_write_byval(buf, _db_pack_link(d->_attr, i, db->decl_builtin));
+        if (d->_quantity < (1ull << 55)) {
+            crefl_vlu_u64_write_byval(buf, d->_quantity << 1);
+        } else {
+            crefl_vlu_u64_write_byval(buf, 1);
+            crefl_buf_write_i64(buf, (s64)d->_quantity);
+        }
+    }
+
+    size_t sz = crefl_buf_offset(buf);
+    crefl_buf_seek(buf, 0);
+    crefl_buf_write_i32(buf, (s32)sz);
+    out.assign((u8*)crefl_buf_data(buf), (u8*)crefl_buf_data(buf) + sz);
+    crefl_buf_destroy(buf);
+}
+
+/*
+ * packed table decoder
+ *
+ * values are decoded from a single unaligned 64-bit load. records are
+ * at most _db_packed_max bytes, so records that start further than that
+ * from the end of the table are decoded without bounds checks. nodes
+ * are decoded in batches so the builtin prefix can be checked before
+ * the rest is decoded into the db.
+ */
+
+struct _db_unpacker
+{
+    const u8 *p;
+    const u8 *end;
+    const u8 *dict;
+    u32 dict_cnt;
+    decl_id last_name;
+    size_t idx;
+};
+
+static inline u64 _db_vlu_fast(const u8 *&p, size_t &len)
+{
+    u64 w;
+    memcpy(&w, p, 8);
+    w = le64(w);
+    len = ctz(~w) + 1;
+    p += len;
+    return len >= 8 ? w >> 8 : (w & ((1ull << (len << 3)) - 1)) >> len;
+}
+
+static inline int _db_vlu_read(const u8 *&p, const u8 *end, u64 *value)
+{
+    u8 tmp[8] = { 0 };
+    const u8 *q = tmp;
+    size_t len;
+    memcpy(tmp, p, end - p < 8 ? end - p : 8);
+    *value = _db_vlu_fast(q, len);
+    if (len > 8 || (size_t)(end - p) < len) return -1;
+    p += len;
+    return 0;
+}
+
+static int _db_unpack_begin(_db_unpacker *u, const uint8_t *buf, size_t input_sz)
+{
+    size_t hdr_sz = sizeof(decl_db_hdr);
+    if (input_sz < hdr_sz + _db_packed_hdr) return -1;
+
+    const u8 *p = &buf[hdr_sz];
+    u32 packed_sz = _db_u32(p);
+    u32 dict_cnt = _db_u32(p + 4);
+    if (packed_sz < _db_packed_hdr || packed_sz > input_sz - hdr_sz ||
+        dict_cnt > (packed_sz - _db_packed_hdr) / (sizeof(u32) * 2)) return -1;
+
+    u->dict = p + _db_packed_hdr;
+    u->dict_cnt = dict_cnt;
+    u->p = u->dict + sizeof(u32) * 2 * dict_cnt;
+    u->end = p + packed_sz;
+    u->last_name = 0;
+    u->idx = 0;
+    return 0;
+}
+
+static int _db_unpack(_db_unpacker *u, decl_node *decl, size_t n)
+{
+    const u8 *p = u->p, *end = u->end, *dict = u->dict;
+    decl_id last_name = u->last_name;
+    size_t i = u->idx, len;
+    u64 v[6];
+
+    for (decl_node *d = decl; d != decl + n; d++, i++) {
+        if (end - p >= (ptrdiff_t)_db_packed_max) {
+            for (size_t j = 0; j < 6; j++) {
+                v[j] = _db_vlu_fast(p, len);
+                if (len > 8) goto err;
+            }
+        } else {
+            for (size_t j = 0; j < 6; j++) {
+                if (_db_vlu_read(p, end, v + j) < 0) goto err;
+            }
+        }
+        if (v[0] >= u->dict_cnt) goto err;
+        d->_tag = _db_u32(dict + (v[0] << 3));
+        d->_props = _db_u32(dict + (v[0] << 3) + 4);
+        if (v[1]) last_name = (decl_id)((s64)last_name + _unzigzag(v[1] - 1));
+        d->_name = v[1] ? last_name : 0;
+        d->_next = _db_unpack_link(v[2], i);
+        d->_link = _db_unpack_link(v[3], i);
+        d->_attr = _db_unpack_link(v[4], i);
+        if (v[5] == 1) {
+            if (end - p < 8) goto err;
+            memcpy(&d->_quantity, p, 8);
+            d->_quantity = le64(d->_quantity);
+            p += 8;
+        } else {
+            d->_quantity = v[5] >> 1;
+        }
+    }
+    u->p = p;
+    u->last_name = last_name;
+    u->idx = i;
+    return 0;
+
+err:
+    fprintf(stderr, "crefl: *** error: invalid packed decl table\n");
+    return -1;
+}
+
+static int _db_unpack_end(_db_unpacker *u)
+{
+    if (u->p == u->end) return 0;
+    fprintf(stderr, "crefl: *** error: invalid packed decl table\n");
+    return -1;
+}
+
+static size_t _db_total_size(decl_db *db, size_t decl_sz)
 {
     size_t hdr_sz = sizeof(decl_db_hdr);
-    size_t decl_sz = sizeof(decl_node) * (db->decl_offset - db->decl_builtin);
-    size_t name_sz = db->name_offset - db->name_builtin;
+    size_t name_sz = db->name_offset;
     size_t total_sz = hdr_sz + decl_sz + name_sz;
 
+    if (_db_has_hashes(db)) {
+        total_sz = _db_hashes_offset(decl_sz, name_sz) +
+            sizeof(decl_entry) * db->decl_offset;
+    }
+    if (db->indexed) {
+        total_sz = _db_index_offset(total_sz) + crefl_db_index_size(db);
+    }
+
     return total_sz;
 }
 
+size_t crefl_db_size(decl_db *db)
+{
+    size_t decl_sz = sizeof(decl_node) * db->decl_offset;
+
+    if (db->packed) {
+        std::vector<u8> packed;
+        _db_pack(db, packed);
+        decl_sz = packed.size();
+    }
+
+    return _db_total_size(db, decl_sz);
+}
+
+void crefl_db_set_packed(decl_db *db, int packed)
+{
+    db->packed = packed != 0;
+}
+
+void crefl_db_set_index(decl_db *db, int index)
+{
+    db->indexed = index != 0;
+}
+
 /*
- * decl db memory io
+ * check the header and that the builtin prefix in the image matches
+ * the builtin types created by crefl_db_defaults. this ensures we don't
+ * load a db if the defaults have changed. the db must contain only the
+ * defaults.
+ *
+ * note: this implies a restriction that the first element is the root
  */
-
-int crefl_db_read_mem(decl_db *db, const uint8_t *buf, size_t input_sz)
+static int _db_check_image(const decl_db *db, const uint8_t *buf,
+    size_t input_sz, _db_unpacker *u)
 {
     if (input_sz < sizeof(decl_db_hdr)) {
         fprintf(stderr, "crefl: *** error: header too short\n");
@@ -63,51 +430,86 @@ int crefl_db_read_mem(decl_db *db, const uint8_t *buf, size_t input_sz)
         return -1;
     }
 
-    decl_db_hdr *hdr = (decl_db_hdr*)&buf[0];
+    const decl_db_hdr *hdr = (const decl_db_hdr*)&buf[0];
     size_t hdr_sz = sizeof(decl_db_hdr);
     size_t decl_cnt = hdr->decl_entry_count;
-    size_t decl_sz = sizeof(decl_node) * decl_cnt;
     size_t name_sz = hdr->name_table_size;
-    size_t root_idx = hdr->root_element;
+    int packed = (hdr->flags & decl_db_flag_packed) != 0;
 
-    /* return early if header indicates db is entry */
+    /* empty db */
     if (decl_cnt == 0) {
         return 0;
     }
 
-    /*
-     * for space compactness we elide builtin types from the output.
-     * initialize builtin types then check the first element is root.
-     * check ensures we don't load a db if the defaults have changed.
-     *
-     * note: this implies a restriction that the first element is the root
-     */
-    crefl_db_defaults(db);
-    if (db->decl_offset != root_idx || db->decl_builtin != root_idx) {
-        fprintf(stderr, "crefl: *** error: incompatible builtin types\n");
+    if (packed && input_sz < hdr_sz + _db_packed_hdr) {
+        fprintf(stderr, "crefl: *** error: image too short\n");
+        return -1;
+    }
+    size_t decl_sz = _db_decl_size(hdr);
+    size_t tables_sz = _db_tables_size(hdr);
+    if (_db_index_version(hdr) == decl_db_index_version && tables_sz != 0 &&
+        input_sz < _db_index_offset(tables_sz) + sizeof(decl_db_index_hdr)) {
+        fprintf(stderr, "crefl: *** error: image too short\n");
+        return -1;
+    }
+    if (_db_index_version(hdr) == decl_db_index_version && tables_sz != 0 &&
+        _db_image_size(hdr) == 0) {
+        fprintf(stderr, "crefl: *** error: invalid lookup index\n");
+        return -1;
+    }
+    if (input_sz < hdr_sz + decl_sz + name_sz ||
+        input_sz < _db_image_size(hdr)) {
+        fprintf(stderr, "crefl: *** error: image too short\n");
         return -1;
     }
 
-    /* resize buffers */
-    if (db->decl_size - db->decl_offset < decl_cnt) {
-        db->decl_size += decl_cnt;
-        db->decl = (decl_node*)realloc(db->decl, sizeof(decl_node) * db->decl_size);
+    /* the builtin prefix of packed tables is decoded to be checked */
+    std::vector<decl_node> builtin;
+    const decl_node *decl = (const decl_node*)&buf[hdr_sz];
+    if (packed && decl_cnt >= db->decl_builtin) {
+        builtin.resize(db->decl_builtin);
+        if (_db_unpack_begin(u, buf, input_sz) < 0) {
+            fprintf(stderr, "crefl: *** error: invalid packed decl table\n");
+            return -1;
+        }
+        if (_db_unpack(u, builtin.data(), builtin.size()) < 0) {
+            return -1;
+        }
+        decl = builtin.data();
     }
-    if (db->name_size - db->name_offset < name_sz) {
-        db->name_size += name_sz;
-        db->name = (char*)realloc(db->name, db->name_size);
+    if (db->decl_offset != db->decl_builtin ||
+        hdr->root_element != db->decl_builtin ||
+        decl_cnt < db->decl_builtin || name_sz < db->name_builtin ||
+        memcmp(decl, db->decl, sizeof(decl_node) * db->decl_builtin) != 0 ||
+        memcmp(&buf[hdr_sz + decl_sz], db->name, db->name_builtin) != 0) {
+        fprintf(stderr, "crefl: *** error: incompatible builtin types\n");
+        return -1;
     }
 
-    /* append decls from temporary buffer */
-    memcpy(db->decl + db->decl_offset, &buf[hdr_sz], decl_sz);
-    db->decl_offset += hdr->decl_entry_count;
+    return 0;
+}
 
-    /* append names from temporary buffer */
-    memcpy(db->name + db->name_offset, &buf[hdr_sz + decl_sz], name_sz);
-    db->name_offset += hdr->name_table_size;
-    db->root_element = hdr->root_element;
+/*
+ * verify that fqn links of persisted hash entries are within bounds.
+ */
+static int _db_check_hashes(decl_db *db)
+{
+    for (size_t i = 0; i < db->hash_count; i++) {
+        const decl_entry *e = db->hash_entry + i;
+        if (e->fqn_parent >= db->decl_offset || e->fqn_name >= db->name_offset) {
+            fprintf(stderr, "crefl: *** error: hash entry %zu"
+                " fqn out of bounds\n", i);
+            return -1;
+        }
+    }
+    return 0;
+}
 
-    /* verify that node and name links are within bounds. */
+/*
+ * verify that node and name links are within bounds.
+ */
+int crefl_db_check_links(decl_db *db)
+{
     for (decl_id i = 0; i < db->decl_offset; i++) {
         decl_node *d = db->decl + i;
         if (d->_link >= db->decl_offset) {
@@ -131,26 +533,352 @@ int crefl_db_read_mem(decl_db *db, const uint8_t *buf, size_t input_sz)
             return -1;
         }
     }
+    return _db_check_hashes(db);
+}
 
-    return 0;
+/*
+ * branch-free bounds check of the packed name, next, link and attr
+ * columns. the four links are adjacent in decl_node so each node is
+ * one 128-bit compare against the table bounds. unsigned compares use
+ * signed compares after flipping the sign bit. the scalar check runs
+ * only to report the first error.
+ */
+static int _db_check_vector(decl_db *db)
+{
+    static_assert(offsetof(decl_node, _next) == offsetof(decl_node, _name) + 4 &&
+                  offsetof(decl_node, _link) == offsetof(decl_node, _name) + 8 &&
+                  offsetof(decl_node, _attr) == offsetof(decl_node, _name) + 12,
+                  "decl_node links must be packed");
+
+    const u8 *p = (const u8*)db->decl + offsetof(decl_node, _name);
+    size_t n = db->decl_offset;
+    int fail;
+
+#if defined(__SSE2__)
+    const __m128i sign = _mm_set1_epi32((int)0x80000000);
+    const __m128i bound = _mm_xor_si128(sign, _mm_setr_epi32(
+        (int)db->name_offset, (int)db->decl_offset,
+        (int)db->decl_offset, (int)db->decl_offset));
+    __m128i acc0 = _mm_set1_epi32(-1), acc1 = _mm_set1_epi32(-1);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i l0 = _mm_loadu_si128((const __m128i*)(p + sizeof(decl_node) * i));
+        __m128i l1 = _mm_loadu_si128((const __m128i*)(p + sizeof(decl_node) * (i + 1)));
+        acc0 = _mm_and_si128(acc0, _mm_cmpgt_epi32(bound, _mm_xor_si128(l0, sign)));
+        acc1 = _mm_and_si128(acc1, _mm_cmpgt_epi32(bound, _mm_xor_si128(l1, sign)));
+    }
+    for (; i < n; i++) {
+        __m128i l0 = _mm_loadu_si128((const __m128i*)(p + sizeof(decl_node) * i));
+        acc0 = _mm_and_si128(acc0, _mm_cmpgt_epi32(bound, _mm_xor_si128(l0, sign)));
+    }
+    fail = _mm_movemask_epi8(_mm_and_si128(acc0, acc1)) != 0xffff;
+#else
+    u32 bad = 0;
+    for (size_t i = 0; i < n; i++) {
+        const decl_node *d = db->decl + i;
+        bad |= (u32)(d->_name >= db->name_offset) | (u32)(d->_next >= db->decl_offset) |
+               (u32)(d->_link >= db->decl_offset) | (u32)(d->_attr >= db->decl_offset);
+    }
+    fail = bad != 0;
+#endif
+
+    return fail ? crefl_db_check_links(db) : _db_check_hashes(db);
+}
+
+/*
+ * 64-bit checksum of an image using eight independent multiply-xor
+ * lanes over 64-bit words so that it runs near memory bandwidth. each
+ * step is a bijection of the lane state, so any single changed word
+ * changes the result. lanes are folded with a final avalanche.
+ */
+u64 crefl_db_checksum(const void *addr, size_t len)
+{
+    const u64 k = 0x9e3779b97f4a7c15ull;
+    const u8 *p = (const u8*)addr;
+    u64 h[8], w[8];
+    size_t i = 0;
+    for (size_t j = 0; j < 8; j++) h[j] = k ^ j;
+    for (; i + 64 <= len; i += 64) {
+        memcpy(w, p + i, 64);
+        for (size_t j = 0; j < 8; j++) h[j] = (h[j] ^ w[j]) * k;
+    }
+    for (; i < len; i++) {
+        h[0] = (h[0] ^ p[i]) * k;
+    }
+    u64 r = (u64)len;
+    for (size_t j = 0; j < 8; j++) {
+        r = (r ^ h[j]) * k;
+        r ^= r >> 29;
+    }
+    return r;
+}
+
+static enum crefl_db_check db_check = crefl_db_check_full;
+
+void crefl_db_set_check(enum crefl_db_check check)
+{
+    db_check = check;
+}
+
+/*
+ * check links of a loaded db according to the check policy. buf is the
+ * image the tables were loaded from and is used to verify the checksum.
+ */
+static int _db_check(decl_db *db, const uint8_t *buf)
+{
+    const decl_db_hdr *hdr = (const decl_db_hdr*)buf;
+    size_t tables_sz = _db_image_size(hdr) - sizeof(decl_db_hdr);
+
+    switch (db_check) {
+    case crefl_db_check_full:
+        if (crefl_db_check_links(db) < 0) return -1;
+        return crefl_db_index_check(db);
+    case crefl_db_check_vector:
+        if (_db_check_vector(db) < 0) return -1;
+        return crefl_db_index_check(db);
+    case crefl_db_check_defer:
+        return 0;
+    case crefl_db_check_trusted:
+        if ((hdr->flags & decl_db_flag_checksum) == 0 ||
+            _db_image_size(hdr) == 0) {
+            return crefl_db_check_links(db);
+        }
+        if (crefl_db_checksum(&buf[sizeof(decl_db_hdr)], tables_sz) !=
+            hdr->checksum) {
+            fprintf(stderr, "crefl: *** error: checksum mismatch\n");
+            return -1;
+        }
+        return 0;
+    }
+    return -1;
+}
+
+/*
+ * adopt the persisted hash section of an image. entries are copied
+ * unless the db tables point into the image.
+ */
+static void _db_load_hashes(decl_db *db, const uint8_t *buf, int copy)
+{
+    const decl_db_hdr *hdr = (const decl_db_hdr*)buf;
+    size_t decl_cnt = hdr->decl_entry_count;
+
+    if (_db_hashes_version(hdr) != decl_db_hashes_version || decl_cnt == 0) {
+        return;
+    }
+
+    const uint8_t *p = &buf[_db_hashes_offset(_db_decl_size(hdr), hdr->name_table_size)];
+    if (copy) {
+        db->hash_entry = (decl_entry*)malloc(sizeof(decl_entry) * decl_cnt);
+        memcpy(db->hash_entry, p, sizeof(decl_entry) * decl_cnt);
+        db->hash_image = 0;
+    } else {
+        db->hash_entry = (decl_entry*)p;
+        db->hash_image = 1;
+    }
+    db->hash_count = decl_cnt;
+}
+
+/*
+ * adopt the lookup index section of an image. the section is copied
+ * unless the db tables point into the image, as for hashes, or if the
+ * image is not aligned for its bitmaps.
+ */
+static void _db_load_index(decl_db *db, const uint8_t *buf, int copy)
+{
+    const decl_db_hdr *hdr = (const decl_db_hdr*)buf;
+    size_t tables_sz = _db_tables_size(hdr);
+
+    if (_db_index_version(hdr) != decl_db_index_version ||
+        hdr->decl_entry_count == 0 || tables_sz == 0) {
+        return;
+    }
+
+    const uint8_t *p = &buf[_db_index_offset(tables_sz)];
+    if (copy || (uintptr_t)p % alignof(u64) != 0) {
+        size_t index_sz = crefl_db_index_section_size(p);
+        void *lookup = malloc(index_sz);
+        memcpy(lookup, p, index_sz);
+        db->lookup = lookup;
+        db->lookup_image = 0;
+    } else {
+        db->lookup = p;
+        db->lookup_image = 1;
+    }
+}
+
+/*
+ * decl db memory io
+ */
+
+/* intern the loaded names so appending them again reuses them */
+static void _db_intern_loaded(decl_db *db, size_t name_start)
+{
+    if (!db->name_intern) return;
+    for (size_t o = name_start; o < db->name_offset; ) {
+        size_t len = strnlen(db->name + o, db->name_offset - o);
+        crefl_intern_add(db->name_intern, db->name + o, len, (decl_id)o);
+        o += len + 1;
+    }
+}
+
+static int _db_read_v0(decl_db *db, const uint8_t *buf, size_t input_sz)
+{
+    _db_hdr_v0 hdr;
+    memcpy(&hdr, buf, sizeof(hdr));
+    size_t hdr_sz = sizeof(_db_hdr_v0);
+    size_t decl_cnt = hdr.decl_entry_count;
+    size_t decl_sz = sizeof(decl_node) * decl_cnt;
+    size_t name_sz = hdr.name_table_size;
+
+    if (decl_cnt == 0) {
+        return 0;
+    }
+    if (input_sz < hdr_sz + decl_sz + name_sz) {
+        fprintf(stderr, "crefl: *** error: image too short\n");
+        return -1;
+    }
+    /* the first element is the root, after the builtin types */
+    if (db->decl_offset != db->decl_builtin ||
+        hdr.root_element != db->decl_builtin) {
+        fprintf(stderr, "crefl: *** error: incompatible builtin types\n");
+        return -1;
+    }
+
+    /* resize buffers */
+    if (db->decl_size - db->decl_offset < decl_cnt) {
+        db->decl_size += decl_cnt;
+        db->decl = (decl_node*)realloc(db->decl, sizeof(decl_node) * db->decl_size);
+    }
+    if (db->name_size - db->name_offset < name_sz) {
+        db->name_size += name_sz;
+        db->name = (char*)realloc(db->name, db->name_size);
+    }
+
+    /* append decls and names, which may be unaligned in the image */
+    memcpy(db->decl + db->decl_offset, &buf[hdr_sz], decl_sz);
+    db->decl_offset += decl_cnt;
+    memcpy(db->name + db->name_offset, &buf[hdr_sz + decl_sz], name_sz);
+    size_t name_start = db->name_offset;
+    db->name_offset += name_sz;
+    _db_intern_loaded(db, name_start);
+    db->root_element = hdr.root_element;
+    crefl_db_invalidate(db);
+
+    /* there is no checksum so links are always checked */
+    return crefl_db_check_links(db);
+}
+
+int crefl_db_read_mem(decl_db *db, const uint8_t *buf, size_t input_sz)
+{
+    _db_unpacker u;
+    crefl_db_defaults(db);
+    if (_db_is_v0(buf, input_sz)) {
+        return _db_read_v0(db, buf, input_sz);
+    }
+    if (_db_check_image(db, buf, input_sz, &u) < 0) {
+        return -1;
+    }
+
+    const decl_db_hdr *hdr = (const decl_db_hdr*)&buf[0];
+    size_t hdr_sz = sizeof(decl_db_hdr);
+    size_t decl_cnt = hdr->decl_entry_count;
+    size_t decl_sz = _db_decl_size(hdr);
+    size_t name_sz = hdr->name_table_size;
+    int packed = (hdr->flags & decl_db_flag_packed) != 0;
+
+    /* return early if header indicates db is empty */
+    if (decl_cnt == 0) {
+        return 0;
+    }
+
+    /* builtins are already present so only the user part is copied */
+    size_t decl_user = decl_cnt - db->decl_builtin;
+    size_t name_user = name_sz - db->name_builtin;
+
+    /* resize buffers */
+    if (db->decl_size - db->decl_offset < decl_user) {
+        db->decl_size += decl_user;
+        db->decl = (decl_node*)realloc(db->decl, sizeof(decl_node) * db->decl_size);
+    }
+    if (db->name_size - db->name_offset < name_user) {
+        db->name_size += name_user;
+        db->name = (char*)realloc(db->name, db->name_size);
+    }
+
+    /* append decls from temporary buffer, or decode them in place */
+    if (packed) {
+        if (_db_unpack(&u, db->decl + db->decl_offset, decl_user) < 0 ||
+            _db_unpack_end(&u) < 0) {
+            return -1;
+        }
+    } else {
+        memcpy(db->decl + db->decl_offset,
+            &buf[hdr_sz] + sizeof(decl_node) * db->decl_builtin,
+            sizeof(decl_node) * decl_user);
+    }
+    db->decl_offset += decl_user;
+
+    /* append names from temporary buffer */
+    memcpy(db->name + db->name_offset,
+        &buf[hdr_sz + decl_sz] + db->name_builtin, name_user);
+    size_t name_start = db->name_offset;
+    db->name_offset += name_user;
+    _db_intern_loaded(db, name_start);
+    db->root_element = hdr->root_element;
+    db->hash_alg = (hdr->flags & decl_db_flag_hash_mask) >> decl_db_flag_hash_shift;
+    db->packed = packed;
+    db->indexed = _db_index_version(hdr) == decl_db_index_version;
+    crefl_db_invalidate(db);
+    _db_load_hashes(db, buf, 1);
+    _db_load_index(db, buf, 1);
+
+    return _db_check(db, buf);
 }
 
 int crefl_db_write_mem(decl_db *db, uint8_t *buf, size_t output_sz)
 {
+    std::vector<u8> packed;
+    if (db->packed) _db_pack(db, packed);
+
     size_t hdr_sz = sizeof(decl_db_hdr);
-    size_t decl_sz = sizeof(decl_node) * (db->decl_offset - db->decl_builtin);
-    size_t name_sz = db->name_offset - db->name_builtin;
-    size_t total_sz = hdr_sz + decl_sz + name_sz;
+    size_t decl_sz = db->packed ? packed.size() : sizeof(decl_node) * db->decl_offset;
+    size_t name_sz = db->name_offset;
+    size_t total_sz = _db_total_size(db, decl_sz);
 
     if (total_sz > output_sz) return -1;
 
     decl_db_hdr *hdr = (decl_db_hdr*)buf;
     memcpy(hdr->magic, decl_db_magic, sizeof(decl_db_magic));
-    hdr->decl_entry_count = (u32)db->decl_offset - (u32)db->decl_builtin;
+    hdr->decl_entry_count = (u32)db->decl_offset;
     hdr->name_table_size = (u32)name_sz;
     hdr->root_element = db->root_element;
-    memcpy(&buf[hdr_sz], db->decl + db->decl_builtin, decl_sz);
-    memcpy(&buf[hdr_sz + decl_sz], db->name + db->name_builtin, name_sz);
+    hdr->flags = decl_db_flag_checksum |
+        ((db->hash_alg << decl_db_flag_hash_shift) & decl_db_flag_hash_mask);
+    if (db->packed) {
+        hdr->flags |= decl_db_flag_packed;
+        memcpy(&buf[hdr_sz], packed.data(), decl_sz);
+    } else {
+        memcpy(&buf[hdr_sz], db->decl, decl_sz);
+    }
+    memcpy(&buf[hdr_sz + decl_sz], db->name, name_sz);
+    if (_db_has_hashes(db)) {
+        size_t hashes_off = _db_hashes_offset(decl_sz, name_sz);
+        memset(&buf[hdr_sz + decl_sz + name_sz], 0,
+            hashes_off - (hdr_sz + decl_sz + name_sz));
+        memcpy(&buf[hashes_off], db->hash_entry,
+            sizeof(decl_entry) * db->decl_offset);
+        hdr->flags |= decl_db_hashes_version << decl_db_flag_hashes_shift;
+    }
+    if (db->indexed) {
+        size_t tables_sz = _db_has_hashes(db) ?
+            _db_hashes_offset(decl_sz, name_sz) + sizeof(decl_entry) * db->decl_offset :
+            hdr_sz + decl_sz + name_sz;
+        size_t index_off = _db_index_offset(tables_sz);
+        memset(&buf[tables_sz], 0, index_off - tables_sz);
+        crefl_db_index_write(db, &buf[index_off]);
+        hdr->flags |= decl_db_index_version << decl_db_flag_index_shift;
+    }
+    hdr->checksum = crefl_db_checksum(&buf[hdr_sz], total_sz - hdr_sz);
 
     return 0;
 }
@@ -174,3 +902,161 @@ int crefl_db_write_file(decl_db *db, const char *output_filename)
     if (ret != 0) return ret;
     return crefl_write_file(buf, output_filename);
 }
+
+/*
+ * decl db attach
+ *
+ * creates a db whose decl and name tables point into an image. links
+ * are checked according to the check policy, unless trust_flag is set
+ * and the image is flagged as checked by its writer.
+ */
+
+static decl_db * _db_read_copy(const uint8_t *buf, size_t input_sz)
+{
+    decl_db *db = crefl_db_new();
+    if (crefl_db_read_mem(db, buf, input_sz) != 0) {
+        crefl_db_destroy(db);
+        return nullptr;
+    }
+    return db;
+}
+
+static decl_db * _db_attach(const uint8_t *buf, size_t input_sz, int trust_flag)
+{
+    /* packed tables and crefl000 images are decoded to the heap */
+    if (_db_is_v0(buf, input_sz) || (input_sz >= sizeof(decl_db_hdr) &&
+        (((const decl_db_hdr*)buf)->flags & decl_db_flag_packed))) {
+        return _db_read_copy(buf, input_sz);
+    }
+
+    /* the image is checked against the builtin segment without a copy */
+    if (_db_check_image(crefl_db_builtin(), buf, input_sz, nullptr) < 0) {
+        return nullptr;
+    }
+
+    decl_db *db = crefl_db_new();
+    const decl_db_hdr *hdr = (const decl_db_hdr*)buf;
+    size_t hdr_sz = sizeof(decl_db_hdr);
+    size_t decl_cnt = hdr->decl_entry_count;
+    size_t name_sz = hdr->name_table_size;
+    if (decl_cnt == 0) {
+        crefl_db_defaults(db);
+        return db;
+    }
+
+    /* replace the heap tables with the image */
+    const decl_db *b = crefl_db_builtin();
+    db->decl_builtin = b->decl_builtin;
+    db->name_builtin = b->name_builtin;
+    db->intrinsic_map = b->intrinsic_map;
+    free(db->decl);
+    free(db->name);
+    db->decl = (decl_node*)&buf[hdr_sz];
+    db->decl_offset = db->decl_size = decl_cnt;
+    db->name = (char*)&buf[hdr_sz + sizeof(decl_node) * decl_cnt];
+    db->name_offset = db->name_size = name_sz;
+    db->root_element = hdr->root_element;
+    db->hash_alg = (hdr->flags & decl_db_flag_hash_mask) >> decl_db_flag_hash_shift;
+    db->map_addr = (void*)buf;
+    db->map_size = 0;
+    _db_load_hashes(db, buf, 0);
+    _db_load_index(db, buf, 0);
+
+    if (!(trust_flag && (hdr->flags & decl_db_flag_checked)) &&
+        _db_check(db, buf) < 0) {
+        crefl_db_destroy(db);
+        return nullptr;
+    }
+
+    return db;
+}
+
+decl_db * crefl_db_attach_mem(const uint8_t *buf, size_t input_sz)
+{
+    /* images emitted before alignment was added need a copy */
+    if ((uintptr_t)buf % alignof(decl_node) != 0) {
+        return _db_read_copy(buf, input_sz);
+    }
+    return _db_attach(buf, input_sz, 1);
+}
+
+/*
+ * decl db memory map
+ */
+
+#ifdef _WIN32
+
+decl_db * crefl_db_open_mmap(const char *input_filename)
+{
+    /* no mapping support, fall back to reading a copy */
+    decl_db *db = crefl_db_new();
+    if (crefl_db_read_file(db, input_filename) != 0) {
+        crefl_db_destroy(db);
+        return nullptr;
+    }
+    return db;
+}
+
+#else
+
+decl_db * crefl_db_open_mmap(const char *input_filename)
+{
+    int fd;
+    struct stat statbuf;
+    void *addr;
+
+    if ((fd = open(input_filename, O_RDONLY)) < 0) {
+        fprintf(stderr, "open: %s\n", strerror(errno));
+        return nullptr;
+    }
+    if (fstat(fd, &statbuf) < 0) {
+        fprintf(stderr, "fstat: %s\n", strerror(errno));
+        close(fd);
+        return nullptr;
+    }
+    if (statbuf.st_size == 0) {
+        fprintf(stderr, "crefl: *** error: header too short\n");
+        close(fd);
+        return nullptr;
+    }
+    addr = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        fprintf(stderr, "mmap: %s\n", strerror(errno));
+        return nullptr;
+    }
+
+    decl_db *db = _db_attach((const uint8_t*)addr, statbuf.st_size, 0);
+    if (!db || !db->map_addr) {
+        munmap(addr, statbuf.st_size);
+        return db;
+    }
+    db->map_size = statbuf.st_size;
+
+    return db;
+}
+
+#endif
+
+void crefl_db_unmap(decl_db *db)
+{
+    if (!db->map_addr) return;
+#ifndef _WIN32
+    if (db->map_size) munmap(db->map_addr, db->map_size);
+#endif
+    if (db->hash_image) {
+        db->hash_entry = nullptr;
+        db->hash_count = 0;
+        db->hash_image = 0;
+    }
+    if (db->lookup_image) {
+        db->lookup = nullptr;
+        db->lookup_image = 0;
+    }
+    db->map_addr = nullptr;
+    db->map_size = 0;
+    db->decl = nullptr;
+    db->decl_offset = db->decl_size = 0;
+    db->name = nullptr;
+    db->name_offset = db->name_size = 0;
+}
@@ -295,6 +295,7 @@ void crefl_db_dump_row(decl_db *db, decl_ref r) { _row(fields, db, r); }
 void crefl_db_dump(decl_db *db)
 {
     ld = crefl_index_new();
+    ld->hash_alg = db->hash_alg;
     crefl_index_scan(ld, db);
 
     crefl_db_header_names();
@@ -341,6 +342,6 @@ void crefl_db_dump_stats(decl_db *db)
         sizeof(decl_node) * decl_user,    decl_user,
         name_builtin,
         name_user,
-        sizeof(decl_db_hdr) + sizeof(decl_node) * decl_user + name_user
+        sizeof(decl_db_hdr) + sizeof(decl_node) * decl_total + name_total
     );
 }
@@ -0,0 +1,203 @@
+/*
+ * crefl runtime library and compiler plug-in to support reflection in C.
+ *
+ * Copyright (c) 2020-2022 Michael Clark <michaeljclark@mac.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <atomic>
+#include <mutex>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+#include <crefl/handle.h>
+
+/*
+ * decl db handle
+ *
+ * each version is a snapshot with a reference count. the handle holds a
+ * reference to the current snapshot and each pin holds one. a reader
+ * pins by taking a reference to the snapshot it loaded and checking that
+ * it is still current, otherwise it drops the reference and retries.
+ * the release that drops the count of a replaced snapshot to zero claims
+ * it with the reclaimed flag and destroys its db. a late pinner may take
+ * and drop a reference after that, so the flag ensures one destroy.
+ *
+ * pins and releases count themselves in active while they access a
+ * snapshot, as a pinner may hold a pointer to a snapshot it has not
+ * pinned and a release may race with a late pinner to claim it. the
+ * snapshots are kept in the retired list after their db is destroyed
+ * and are freed by a swap that sees no pins or releases in progress, so
+ * no thread touches freed memory and an address is not reused while a
+ * pinner may compare against it.
+ */
+
+struct decl_db_snapshot
+{
+    decl_db_handle *handle;
+    decl_db *db;
+    u64 version;
+    std::atomic<size_t> refs;
+    std::atomic<int> reclaimed;
+    decl_db_snapshot *next_retired;
+};
+
+struct decl_db_handle
+{
+    std::atomic<decl_db_snapshot*> current;
+    std::atomic<size_t> active;
+    std::atomic<u64> version;
+    std::mutex swap_lock;
+    decl_db_snapshot *retired;
+};
+
+static decl_db_snapshot * _snapshot_new(decl_db_handle *h, decl_db *db,
+    u64 version)
+{
+    decl_db_snapshot *s = new decl_db_snapshot();
+    s->handle = h;
+    s->db = db;
+    s->version = version;
+    s->refs.store(1);
+    s->reclaimed.store(0);
+    s->next_retired = nullptr;
+    return s;
+}
+
+/* callers other than swaps count themselves in active */
+static void _snapshot_release(decl_db_snapshot *s)
+{
+    if (s->refs.fetch_sub(1) != 1) return;
+    /* the snapshot may be freed once reclaimed is set */
+    decl_db *db = s->db;
+    if (s->reclaimed.exchange(1)) return;
+    if (db) crefl_db_destroy(db);
+}
+
+/* free retired snapshots whose db is destroyed if no thread is active */
+static void _handle_collect(decl_db_handle *h)
+{
+    if (h->active.load() != 0) return;
+    decl_db_snapshot **p = &h->retired;
+    while (*p) {
+        decl_db_snapshot *s = *p;
+        if (s->reclaimed.load()) {
+            *p = s->next_retired;
+            delete s;
+        } else {
+            p = &s->next_retired;
+        }
+    }
+}
+
+decl_db_handle * crefl_handle_new(decl_db *db)
+{
+    decl_db_handle *h = new decl_db_handle();
+    h->current.store(nullptr);
+    h->active.store(0);
+    h->version.store(0);
+    h->retired = nullptr;
+    if (db) crefl_handle_swap(h, db);
+    return h;
+}
+
+void crefl_handle_destroy(decl_db_handle *h)
+{
+    decl_db_snapshot *s = h->current.exchange(nullptr);
+    if (s) {
+        s->next_retired = h->retired;
+        h->retired = s;
+        _snapshot_release(s);
+    }
+    while (h->retired) {
+        s = h->retired;
+        h->retired = s->next_retired;
+        if (!s->reclaimed.load()) {
+            fprintf(stderr, "crefl: *** error: destroying a pinned snapshot\n");
+            if (s->db) crefl_db_destroy(s->db);
+        }
+        delete s;
+    }
+    delete h;
+}
+
+decl_db_snapshot * crefl_handle_pin(decl_db_handle *h)
+{
+    decl_db_snapshot *s;
+
+    h->active.fetch_add(1);
+    for (;;) {
+        s = h->current.load();
+        if (!s) break;
+        s->refs.fetch_add(1);
+        if (h->current.load() == s) break;
+        _snapshot_release(s);
+    }
+    h->active.fetch_sub(1);
+
+    return s;
+}
+
+void crefl_snapshot_unpin(decl_db_snapshot *s)
+{
+    decl_db_handle *h = s->handle;
+    h->active.fetch_add(1);
+    _snapshot_release(s);
+    h->active.fetch_sub(1);
+}
+
+decl_db * crefl_snapshot_db(decl_db_snapshot *s)
+{
+    return s->db;
+}
+
+uint64_t crefl_snapshot_version(decl_db_snapshot *s)
+{
+    return s->version;
+}
+
+int64_t crefl_handle_swap(decl_db_handle *h, decl_db *db)
+{
+    /* derived tables are built before the db is published */
+    crefl_db_freeze(db);
+
+    std::lock_guard<std::mutex> guard(h->swap_lock);
+    u64 version = h->version.load() + 1;
+    decl_db_snapshot *old = h->current.exchange(_snapshot_new(h, db, version));
+    h->version.store(version);
+    if (old) {
+        old->next_retired = h->retired;
+        h->retired = old;
+        _snapshot_release(old);
+    }
+    _handle_collect(h);
+
+    return (int64_t)version;
+}
+
+int64_t crefl_handle_reload(decl_db_handle *h, const char *input_filename)
+{
+    decl_db *db = crefl_db_open_mmap(input_filename);
+    if (!db) return -1;
+    return crefl_handle_swap(h, db);
+}
+
+uint64_t crefl_handle_version(decl_db_handle *h)
+{
+    return h->version.load();
+}
@@ -0,0 +1,36 @@
+/*
+ * crefl runtime library and compiler plug-in to support reflection in C.
+ *
+ * Copyright (c) 2020-2022 Michael Clark <michaeljclark@mac.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <crefl/model.h>
+
+/*
+ * derived table hooks shared by the library sources
+ *
+ * each derived table is built on first use and dropped on its own when
+ * it is stale, so a miss in one table keeps the others. the persisted
+ * hash and lookup tables may point into a loaded image.
+ */
+void crefl_name_index_build(decl_db *db);
+void crefl_name_index_destroy(decl_name_index *index);
+void crefl_layout_destroy(decl_layout *layout);
+void crefl_child_index_destroy(decl_child_index *index);
+void crefl_columns_destroy(decl_columns *columns);
+void crefl_db_drop_hashes(decl_db *db);
+void crefl_db_drop_lookup(decl_db *db);
@@ -23,10 +23,17 @@
 #include <cstdlib>
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <algorithm>
+#include <condition_variable>
 
 #include <crefl/bits.h>
 #include <crefl/model.h>
 #include <crefl/link.h>
+#include <crefl/db.h>
 #include <crefl/util.h>
 #include <crefl/hashmap.h>
 
@@ -61,7 +68,11 @@
  * - types and interfaces link to dependencies without knowing their names.
  * - type hashes for incomplete types have different sums to complete types.
  * - semicolon is used as a delimeter as it does not occur in type names.
- * - SHA-224 is used because it is not subject to length extension attacks.
+ * - SHA-224 is used by default because it is not subject to length extension
+ *   attacks. a fast 128-bit backend can be selected with decl_db.hash_alg.
+ *   it absorbs tags and delimiters as binary words instead of strings.
+ * - aliases are a linkage artifact, they take the hash of the aliased node
+ *   so that the hashes of an archive match the hashes of its sources.
  * - type hashes for functions include parameter names and types. the index
  *   is decoupled so that alternative hashing algorithms can be used. e.g. a
  *   model used for linkage may omit parameter names.
@@ -76,103 +87,344 @@ static const char *next_delimeter     = ";X=";
 static const char *hash_delimeter     = ";H=";
 static const char *end_delimeter      = ")";
 
+/*
+ * the fast backend is a 128-bit multiply-xor hash fed with binary fields.
+ * delimiters, tags and child hashes are absorbed as 64-bit words and
+ * names are length prefixed. it is not collision resistant against an
+ * adversary but is sufficient for deduplication of trusted inputs. the
+ * sum occupies the first 16 bytes of decl_hash and the rest is zero.
+ */
+static const u64 fast_k0 = 0xa0761d6478bd642full;
+static const u64 fast_k1 = 0xe7037ed1a0b428dbull;
+static const u64 fast_k2 = 0x8ebc6af09c88c6e3ull;
+static const u64 fast_k3 = 0x589965cc75374cc3ull;
+
+static inline u64 _fast_mum(u64 a, u64 b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)a * b;
+    return (u64)r ^ (u64)(r >> 64);
+#else
+    u64 al = (u32)a, ah = a >> 32, bl = (u32)b, bh = b >> 32;
+    u64 ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+    u64 m = (ll >> 32) + (u32)lh + (u32)hl;
+    u64 lo = (m << 32) | (u32)ll;
+    u64 hi = hh + (lh >> 32) + (hl >> 32) + (m >> 32);
+    return lo ^ hi;
+#endif
+}
+
 struct decl_sum
 {
-    sha224_ctx ctx;
+    u32 alg;
+    union {
+        sha224_ctx ctx;
+        struct { u64 h0, h1; } fast;
+    };
 };
 
-static void crefl_hash_init(decl_sum *sum)
+static inline void _fast_word(decl_sum *sum, u64 w)
+{
+    sum->fast.h0 = _fast_mum(sum->fast.h0 ^ w, fast_k0);
+    sum->fast.h1 = _fast_mum(sum->fast.h1 ^ w ^ sum->fast.h0, fast_k1);
+}
+
+static void _fast_bytes(decl_sum *sum, const void *data, size_t len)
 {
-    sha224_init(&sum->ctx);
+    const u8 *p = (const u8*)data;
+    u64 w = 0;
+    _fast_word(sum, len);
+    for (; len >= 8; p += 8, len -= 8) {
+        memcpy(&w, p, 8);
+        _fast_word(sum, w);
+    }
+    if (len) {
+        w = 0;
+        memcpy(&w, p, len);
+        _fast_word(sum, w);
+    }
+}
+
+static void crefl_hash_init(decl_sum *sum, u32 alg)
+{
+    sum->alg = alg;
+    switch (alg) {
+    case decl_hash_fast:
+        sum->fast.h0 = fast_k2;
+        sum->fast.h1 = fast_k3;
+        break;
+    default:
+        sha224_init(&sum->ctx);
+        break;
+    }
 }
 
 static void crefl_hash_absorb(decl_sum *sum, const char *str)
 {
-    sha224_update(&sum->ctx, str, strlen(str));
+    switch (sum->alg) {
+    case decl_hash_fast: _fast_bytes(sum, str, strlen(str)); break;
+    default: sha224_update(&sum->ctx, str, strlen(str)); break;
+    }
 }
 
 static void crefl_hash_final(decl_sum *sum, decl_hash *hash)
 {
-    sha224_final(&sum->ctx, (unsigned char*)hash->sum);
+    switch (sum->alg) {
+    case decl_hash_fast: {
+        u64 h0 = _fast_mum(sum->fast.h0 ^ fast_k2, sum->fast.h1 ^ fast_k3);
+        u64 h1 = _fast_mum(sum->fast.h1 ^ fast_k0, h0 ^ fast_k1);
+        memset(hash->sum, 0, sizeof(hash->sum));
+        memcpy(hash->sum, &h0, 8);
+        memcpy(hash->sum + 8, &h1, 8);
+        break;
+    }
+    default:
+        sha224_final(&sum->ctx, (unsigned char*)hash->sum);
+        break;
+    }
 }
 
 static void crefl_hash_update(decl_sum *sum, const void *data, size_t len)
 {
-    sha224_update(&sum->ctx, data, len);
+    switch (sum->alg) {
+    case decl_hash_fast: _fast_bytes(sum, data, len); break;
+    default: sha224_update(&sum->ctx, data, len); break;
+    }
 }
 
-decl_hash * crefl_node_hash(decl_index *index,
-    decl_ref d, decl_ref p, std::string prefix);
+/* delimiters are at most 3 characters so fit in one word */
+static void crefl_hash_delim(decl_sum *sum, const char *delim)
+{
+    switch (sum->alg) {
+    case decl_hash_fast: {
+        u64 w = 0;
+        for (size_t i = 0; delim[i]; i++) w |= (u64)(u8)delim[i] << (i << 3);
+        _fast_word(sum, w);
+        break;
+    }
+    default: sha224_update(&sum->ctx, delim, strlen(delim)); break;
+    }
+}
 
-static void crefl_hash_node_sum(decl_sum *sum, decl_index *index,
-    decl_ref d, decl_ref p, std::string prefix)
+static void crefl_hash_tag(decl_sum *sum, decl_tag tag)
 {
-    decl_node *node = crefl_decl_ptr(d);
-    decl_hash *hash;
+    switch (sum->alg) {
+    case decl_hash_fast: _fast_word(sum, tag); break;
+    default: crefl_hash_absorb(sum, crefl_tag_name(tag)); break;
+    }
+}
+
+static void crefl_hash_child(decl_sum *sum, const decl_hash *hash)
+{
+    switch (sum->alg) {
+    case decl_hash_fast: {
+        u64 h0, h1;
+        memcpy(&h0, hash->sum, 8);
+        memcpy(&h1, hash->sum + 8, 8);
+        _fast_word(sum, h0);
+        _fast_word(sum, h1);
+        break;
+    }
+    default:
+        sha224_update(&sum->ctx, (const char*)hash->sum, sizeof(decl_hash));
+        break;
+    }
+}
+
+/*
+ * nodes are hashed with an iterative post-order traversal using an explicit
+ * stack of frames, so native stack use is bounded regardless of the depth
+ * of the declaration graph. each frame holds the running sum for its node
+ * and the stage to resume at. when a frame completes its hash is absorbed
+ * into the frame below, so the absorbtion order is identical to a recursive
+ * descent of the graph.
+ */
+enum crefl_hash_stage
+{
+    crefl_hash_stage_attr,
+    crefl_hash_stage_link,
+    crefl_hash_stage_list,
+    crefl_hash_stage_alias,
+    crefl_hash_stage_end,
+};
+
+struct crefl_hash_frame
+{
+    decl_node *node;
+    decl_ref d;
     decl_ref next;
+    u32 stage;
+    decl_sum sum;
+};
+
+static void crefl_entry_fqn_link(decl_entry *ent, decl_ref d, decl_ref p);
+
+/* nodes begun without a parent have their fqn linked by their container */
+static inline void crefl_hash_node_begin(std::vector<crefl_hash_frame> &stack,
+    size_t &depth, decl_index *index, decl_ref d, decl_ref p, bool fqn = true)
+{
+    decl_entry *ent = crefl_entry_ptr(crefl_entry_ref(index, d));
+    decl_node *node = crefl_decl_ptr(d);
+
+    ent->props |= decl_entry_marked;
+    if (fqn) crefl_entry_fqn_link(ent, d, p);
 
-    crefl_hash_absorb(sum, tag_delimeter);
-    crefl_hash_absorb(sum, crefl_tag_name(crefl_decl_tag(d)));
-    crefl_hash_absorb(sum, name_delimeter);
+    /* frames are reused so pushes do not reinitialize the sum */
+    if (depth == stack.size()) stack.emplace_back();
+    crefl_hash_frame &f = stack[depth++];
+    f.node = node;
+    f.d = d;
+    f.stage = crefl_decl_tag(d) == _decl_alias ?
+        crefl_hash_stage_alias : crefl_hash_stage_attr;
+
+    decl_sum *sum = &f.sum;
+    crefl_hash_init(sum, index->hash_alg);
+    crefl_hash_delim(sum, tag_delimeter);
+    crefl_hash_tag(sum, crefl_decl_tag(d));
+    crefl_hash_delim(sum, name_delimeter);
     crefl_hash_absorb(sum, crefl_decl_name(d));
-    crefl_hash_absorb(sum, props_delimeter);
+    crefl_hash_delim(sum, props_delimeter);
     crefl_hash_update(sum, &node->_props, sizeof(node->_props));
-    crefl_hash_absorb(sum, quantity_delimeter);
+    crefl_hash_delim(sum, quantity_delimeter);
     crefl_hash_update(sum, &node->_quantity, sizeof(node->_quantity));
+}
 
-    if (node->_attr) {
-        next = crefl_lookup(d.db, node->_attr);
-        crefl_hash_absorb(sum, attr_delimeter);
-        hash = crefl_node_hash(index, next, d, prefix);
-        crefl_hash_absorb(sum, hash_delimeter);
-        crefl_hash_update(sum, (const char*)hash->sum, sizeof(decl_hash));
-    }
-    if (node->_link) {
-        switch (crefl_decl_tag(d)) {
-        /*
-         * follow `link` to child list for container types: 'object',
-         * 'set', 'enum', 'struct', 'union', and 'function' are lists
-         * containing: 'typedef', 'field', 'pointer', 'array', etc.
-         */
-        case _decl_archive:
-        case _decl_source:
-        case _decl_set:
-        case _decl_enum:
-        case _decl_struct:
-        case _decl_union:
-        case _decl_function:
-            crefl_hash_absorb(sum, link_delimeter);
-            next = crefl_lookup(d.db, node->_link);
-            while (crefl_decl_idx(next))  {
-                crefl_hash_absorb(sum, next_delimeter);
-                decl_hash *hash = crefl_node_hash(index, next, d, prefix);
-                crefl_hash_absorb(sum, hash_delimeter);
-                crefl_hash_update(sum, (const char*)hash->sum, sizeof(decl_hash));
-                next = crefl_decl_next(next);
+static inline void crefl_hash_node_child(decl_sum *sum, const decl_hash *hash)
+{
+    crefl_hash_delim(sum, hash_delimeter);
+    crefl_hash_child(sum, hash);
+}
+
+static void crefl_hash_node_sum(decl_index *index, decl_ref d, decl_ref p)
+{
+    std::vector<crefl_hash_frame> stack;
+    size_t depth = 0;
+
+    stack.reserve(64);
+    crefl_hash_node_begin(stack, depth, index, d, p);
+
+    /*
+     * children with valid hashes are absorbed in place. otherwise the frame
+     * records the stage to resume at and the child is pushed. the reference
+     * to the top frame must not be used after crefl_hash_node_begin because
+     * the stack may reallocate.
+     */
+    while (depth > 0) {
+        crefl_hash_frame &f = stack[depth - 1];
+        decl_node *node = f.node;
+        decl_ref d = f.d, next;
+        decl_entry *ent;
+
+        switch (f.stage) {
+        case crefl_hash_stage_attr:
+            f.stage = crefl_hash_stage_link;
+            if (node->_attr) {
+                next = crefl_lookup(d.db, node->_attr);
+                crefl_hash_delim(&f.sum, attr_delimeter);
+                ent = crefl_entry_ptr(crefl_entry_ref(index, next));
+                if (ent->props & decl_entry_valid) {
+                    crefl_hash_node_child(&f.sum, &ent->hash);
+                } else {
+                    crefl_hash_node_begin(stack, depth, index, next, d);
+                }
             }
             break;
-        /*
-         * follow `link` to child element without processing `next`
-         * for non container types such as 'typedef', 'field', 'pointer',
-         * 'array' and 'param'. following `next` in these node types would
-         * cause cycles from type references to adjacent anonymous types.
-         */
-        default:
-            next = crefl_lookup(d.db, node->_link);
-            if (crefl_entry_is_marked(crefl_entry_ref(index, next)) &&
-                !crefl_entry_is_valid(crefl_entry_ref(index, next))) {
+        case crefl_hash_stage_link:
+            f.stage = crefl_hash_stage_end;
+            if (!node->_link) break;
+            switch (crefl_decl_tag(d)) {
+            /*
+             * follow `link` to child list for container types: 'object',
+             * 'set', 'enum', 'struct', 'union', and 'function' are lists
+             * containing: 'typedef', 'field', 'pointer', 'array', etc.
+             */
+            case _decl_archive:
+            case _decl_source:
+            case _decl_set:
+            case _decl_enum:
+            case _decl_struct:
+            case _decl_union:
+            case _decl_function:
+                crefl_hash_delim(&f.sum, link_delimeter);
+                f.next = crefl_lookup(d.db, node->_link);
+                f.stage = crefl_hash_stage_list;
+                break;
+            /*
+             * follow `link` to child element without processing `next`
+             * for non container types such as 'typedef', 'field', 'pointer',
+             * 'array' and 'param'. following `next` in these node types would
+             * cause cycles from type references to adjacent anonymous types.
+             */
+            default:
+                next = crefl_lookup(d.db, node->_link);
+                ent = crefl_entry_ptr(crefl_entry_ref(index, next));
+                if ((ent->props & (decl_entry_marked | decl_entry_valid))
+                    == decl_entry_marked) {
+                    /* we have a reference to a node that is being hashed */
+                    crefl_hash_tag(&f.sum, crefl_decl_tag(next));
+                    crefl_hash_absorb(&f.sum, crefl_decl_name(next));
+                } else if (ent->props & decl_entry_valid) {
+                    crefl_hash_node_child(&f.sum, &ent->hash);
+                } else {
+                    crefl_hash_node_begin(stack, depth, index, next, d);
+                }
+                break;
+            }
+            break;
+        case crefl_hash_stage_list:
+            for (next = f.next; crefl_decl_idx(next); next = crefl_decl_next(next)) {
+                crefl_hash_delim(&f.sum, next_delimeter);
+                ent = crefl_entry_ptr(crefl_entry_ref(index, next));
+                if (!(ent->props & decl_entry_valid)) break;
+                if (!ent->fqn_parent && !ent->fqn_name &&
+                    !(ent->props & decl_entry_fqn)) {
+                    crefl_entry_fqn_link(ent, next, d);
+                }
+                crefl_hash_node_child(&f.sum, &ent->hash);
+            }
+            if (!crefl_decl_idx(next)) {
+                f.stage = crefl_hash_stage_end;
+                break;
+            }
+            f.next = crefl_decl_next(next);
+            crefl_hash_node_begin(stack, depth, index, next, d);
+            break;
+        case crefl_hash_stage_alias:
+            /* hash of the aliased node. pushed targets absorb into our sum */
+            for (next = d; crefl_decl_tag(next) == _decl_alias; ) {
+                next = crefl_decl_link(next);
+            }
+            ent = crefl_entry_ptr(crefl_entry_ref(index, next));
+            if ((ent->props & (decl_entry_marked | decl_entry_valid))
+                == decl_entry_marked) {
                 /* we have a reference to a node that is being hashed */
-                crefl_hash_absorb(sum, crefl_tag_name(crefl_decl_tag(next)));
-                crefl_hash_absorb(sum, crefl_decl_name(next));
+                crefl_hash_tag(&f.sum, crefl_decl_tag(next));
+                crefl_hash_absorb(&f.sum, crefl_decl_name(next));
+                f.stage = crefl_hash_stage_end;
+            } else if (!(ent->props & decl_entry_valid)) {
+                /* the target is named by its own container, not the alias */
+                crefl_hash_node_begin(stack, depth, index, next, d, false);
             } else {
-                hash = crefl_node_hash(index, next, d, prefix);
-                crefl_hash_absorb(sum, hash_delimeter);
-                crefl_hash_update(sum, (const char*)hash->sum, sizeof(decl_hash));
+                decl_hash hash = ent->hash;
+                ent = crefl_entry_ptr(crefl_entry_ref(index, d));
+                ent->hash = hash;
+                ent->props |= decl_entry_valid;
+                if (--depth > 0) {
+                    crefl_hash_node_child(&stack[depth - 1].sum, &ent->hash);
+                }
+            }
+            break;
+        case crefl_hash_stage_end:
+            ent = crefl_entry_ptr(crefl_entry_ref(index, d));
+            crefl_hash_delim(&f.sum, end_delimeter);
+            crefl_hash_final(&f.sum, &ent->hash);
+            ent->props |= decl_entry_valid;
+            if (--depth > 0) {
+                crefl_hash_node_child(&stack[depth - 1].sum, &ent->hash);
             }
             break;
         }
     }
-    crefl_hash_absorb(sum, end_delimeter);
 }
 
 int crefl_entry_is_marked(decl_entry_ref er)
@@ -185,57 +437,43 @@ int crefl_entry_is_valid(decl_entry_ref er)
     return (crefl_entry_ptr(er)->props & decl_entry_valid) == decl_entry_valid;
 }
 
-static const std::string sep = "::";
-
-std::string crefl_node_name(decl_ref d, decl_ref p, std::string prefix)
+/*
+ * fully qualified names are stored as a link to the entry holding the
+ * prefix and the name id of the last component, so scans do not build
+ * strings. names are materialized on demand by crefl_entry_fqn.
+ *
+ * - children of sources and archives start a new name.
+ * - arrays, pointers and anonymous nodes inherit the prefix.
+ * - named nodes append their name to the prefix.
+ */
+static void crefl_entry_fqn_link(decl_entry *ent, decl_ref d, decl_ref p)
 {
-    static bool anon_parenthesis = false;
-    std::string osep = prefix.size() > 0 ? sep : "";
-
-    if (crefl_is_source(p)) return crefl_decl_name(d);
-    if (crefl_is_archive(p)) return crefl_decl_name(d);
-
+    if (crefl_is_source(p) || crefl_is_archive(p)) {
+        ent->fqn_parent = 0;
+        ent->fqn_name = crefl_decl_ptr(d)->_name;
+        return;
+    }
+    ent->fqn_parent = (decl_id)crefl_decl_idx(p);
     switch (crefl_decl_tag(d)) {
     case _decl_array:
     case _decl_pointer:
-        if (anon_parenthesis) {
-            return prefix + osep + std::string("(") + std::string(
-                crefl_tag_name(crefl_decl_tag(d))) + std::string(")");
-        } else {
-            return prefix;
-        }
+        ent->fqn_name = 0;
+        break;
+    default:
+        ent->fqn_name = crefl_decl_ptr(d)->_name;
         break;
-    }
-
-    if (strlen(crefl_decl_name(d))) {
-        return prefix + osep + crefl_decl_name(d);
-    } else if (anon_parenthesis) {
-        return prefix + osep + std::string("(") + std::string(
-            crefl_tag_name(crefl_decl_tag(d))) + std::string(")");
-    } else {
-        return prefix;
     }
 }
 
-decl_hash * crefl_node_hash(decl_index *index, decl_ref d, decl_ref p, std::string prefix)
+decl_hash * crefl_node_hash(decl_index *index, decl_ref d, decl_ref p)
 {
     decl_entry_ref er = crefl_entry_ref(index, d);
-    decl_entry *ent = crefl_entry_ptr(er);
 
-    prefix = crefl_node_name(d, p, prefix);
-
-    if ((ent->props & decl_entry_valid) != decl_entry_valid) {
-        decl_sum sum;
-        ent->props |= decl_entry_marked;
-        crefl_hash_init(&sum);
-        crefl_hash_node_sum(&sum, index, d, p, prefix);
-        ent = crefl_entry_ptr(er); /* revalidate due to realloc */
-        crefl_hash_final(&sum, &ent->hash);
-        ent->fqn = crefl_entry_name_new(index, prefix.c_str());
-        ent->props |= decl_entry_valid;
+    if ((crefl_entry_ptr(er)->props & decl_entry_valid) != decl_entry_valid) {
+        crefl_hash_node_sum(index, d, p);
     }
 
-    return &ent->hash;
+    return &crefl_entry_ptr(er)->hash;
 }
 
 decl_index * crefl_index_new()
@@ -252,11 +490,16 @@ decl_index * crefl_index_new()
     index->entry = (decl_entry*)malloc(sizeof(decl_entry) * index->entry_size);
     memset(index->entry, 0, sizeof(decl_entry) * index->entry_size);
 
+    index->name_intern = crefl_intern_new();
+    index->hash_alg = decl_hash_sha224;
+    index->db = nullptr;
+
     return index;
 }
 
 void crefl_index_destroy(decl_index *index)
 {
+    crefl_intern_destroy(index->name_intern);
     free(index->name);
     free(index->entry);
     free(index);
@@ -279,6 +522,8 @@ decl_id crefl_entry_name_new(decl_index *index, const char *name)
 {
     size_t len = strlen(name) + 1;
     if (len == 1) return 0;
+    decl_id o = crefl_intern_find(index->name_intern, index->name, name, len - 1);
+    if (o) return o;
     if (index->name_offset + len > index->name_size) {
         while (index->name_offset + len > index->name_size) {
             index->name_size <<= 1;
@@ -288,6 +533,7 @@ decl_id crefl_entry_name_new(decl_index *index, const char *name)
     size_t name_offset = index->name_offset;
     index->name_offset += len;
     memcpy(index->name + name_offset, name, len);
+    crefl_intern_add(index->name_intern, name, len - 1, name_offset);
     return name_offset;
 }
 
@@ -298,24 +544,75 @@ decl_entry * crefl_entry_ptr(decl_entry_ref d)
 
 const char* crefl_entry_fqn(decl_entry_ref d)
 {
-    return d.index->name + crefl_entry_ptr(d)->fqn;
+    decl_index *index = d.index;
+    decl_entry *ent = crefl_entry_ptr(d);
+
+    if ((ent->props & decl_entry_fqn) != decl_entry_fqn) {
+        /* collect name components from the leaf towards the root */
+        std::vector<decl_id> names;
+        for (decl_id i = (decl_id)d.offset; ; i = index->entry[i].fqn_parent) {
+            if (index->entry[i].fqn_name) names.push_back(index->entry[i].fqn_name);
+            if (!index->entry[i].fqn_parent) break;
+        }
+        std::string fqn;
+        for (size_t i = names.size(); i > 0; i--) {
+            if (fqn.size()) fqn.append("::");
+            fqn.append(index->db->name + names[i - 1]);
+        }
+        decl_id o = crefl_entry_name_new(index, fqn.c_str());
+        ent = crefl_entry_ptr(d);
+        ent->fqn = o;
+        ent->props |= decl_entry_fqn;
+    }
+
+    return index->name + ent->fqn;
 }
 
 void crefl_index_scan(decl_index *index, decl_db *db)
 {
     decl_ref d = crefl_lookup(db, db->root_element);
-    crefl_node_hash(index, d, crefl_decl_void(d), "");
+    index->db = db;
+    /* size the entry table up front so the scan does not reallocate */
+    if (db->decl_offset) crefl_entry_ref(index, crefl_lookup(db, db->decl_offset - 1));
+    /* adopt persisted entries hashed with the same algorithm */
+    if (db->hash_entry && db->hash_count == db->decl_offset &&
+        db->hash_alg == index->hash_alg) {
+        memcpy(index->entry, db->hash_entry, sizeof(decl_entry) * db->hash_count);
+        for (size_t i = 0; i < db->hash_count; i++) {
+            index->entry[i].fqn = 0;
+            index->entry[i].props &= ~decl_entry_fqn;
+        }
+        return;
+    }
+    crefl_node_hash(index, d, crefl_decl_void(d));
 }
 
-static std::string _hex_str(const uint8_t *data, size_t sz)
+/* store the entries of an index of db as the persisted entries of db */
+static void crefl_db_keep_hashes(decl_db *db, decl_index *index)
 {
-    std::string s;
-    char hex[3];
-    for (size_t i = 0; i < sz; i++) {
-        snprintf(hex, sizeof(hex), "%02hhx", data[i]);
-        s.append(hex);
+    if (db->hash_entry && !db->hash_image) free(db->hash_entry);
+    db->hash_entry = (decl_entry*)malloc(sizeof(decl_entry) * db->decl_offset);
+    db->hash_count = db->decl_offset;
+    db->hash_image = 0;
+    for (size_t i = 0; i < db->decl_offset; i++) {
+        db->hash_entry[i] = index->entry[i];
+        db->hash_entry[i].fqn = 0;
+        db->hash_entry[i].props &= ~decl_entry_fqn;
     }
-    return s;
+}
+
+int crefl_db_link_hashes(decl_db *db)
+{
+    if (db->frozen) {
+        fprintf(stderr, "crefl: *** error: modifying a frozen db\n");
+        return -1;
+    }
+    decl_index *index = crefl_index_new();
+    index->hash_alg = db->hash_alg;
+    crefl_index_scan(index, db);
+    crefl_db_keep_hashes(db, index);
+    crefl_index_destroy(index);
+    return 0;
 }
 
 struct _hash_fn
@@ -334,6 +631,7 @@ struct crefl_link_state
     decl_db *db;
     decl_index *ld;
     decl_index *src_ld;
+    bool record;
 };
 
 bool _should_copy(decl_ref d)
@@ -345,7 +643,22 @@ bool _should_copy(decl_ref d)
              crefl_is_function(d));
 }
 
-decl_ref crefl_copy_node(crefl_link_state *state, decl_ref d, decl_ref p,
+/*
+ * record the identity of an output node in the output index so that the
+ * hashes of the output are known without scanning it, see crefl_link_update.
+ * merges do not record entries as the output index is discarded.
+ */
+static void crefl_copy_entry(crefl_link_state *state, decl_ref r, decl_ref op,
+    const decl_hash *hash)
+{
+    if (!state->record) return;
+    decl_entry *ent = crefl_entry_ptr(crefl_entry_ref(state->ld, r));
+    crefl_entry_fqn_link(ent, r, op);
+    ent->hash = *hash;
+    ent->props |= decl_entry_marked | decl_entry_valid;
+}
+
+decl_ref crefl_copy_node(crefl_link_state *state, decl_ref d, decl_ref op,
     bool _is_child = false)
 {
     decl_db *db = state->db;
@@ -360,6 +673,19 @@ decl_ref crefl_copy_node(crefl_link_state *state, decl_ref d, decl_ref p,
         return decl_ref {db, crefl_decl_idx(d) };
     }
 
+    /* aliases share the hash of their target so copy the target and alias it */
+    if (crefl_decl_tag(d) == _decl_alias) {
+        r = crefl_decl_new(db, _decl_alias);
+        crefl_decl_ptr(r)->_name = crefl_name_new(db, crefl_decl_name(d));
+        crefl_copy_entry(state, r, op, hash);
+        a = crefl_copy_node(state, crefl_decl_link(d), r, true);
+        while (crefl_decl_tag(a) == _decl_alias) {
+            a = crefl_decl_link(a);
+        }
+        crefl_decl_ptr(r)->_link = crefl_decl_idx(a);
+        return r;
+    }
+
     /* lookup node in our hash table to decide whether to copy or alias */
     auto i = state->map->find(*hash);
     if (i == state->map->end() || _should_copy(d)) {
@@ -368,6 +694,7 @@ decl_ref crefl_copy_node(crefl_link_state *state, decl_ref d, decl_ref p,
         crefl_decl_ptr(r)->_name = crefl_name_new(db, crefl_decl_name(d));
         crefl_decl_ptr(r)->_props = crefl_decl_props(d);
         crefl_decl_ptr(r)->_quantity = crefl_decl_qty(d);
+        crefl_copy_entry(state, r, op, hash);
         (*state->map)[*hash] = r;
     } else {
         /* return node directly if it is a child link */
@@ -380,13 +707,14 @@ decl_ref crefl_copy_node(crefl_link_state *state, decl_ref d, decl_ref p,
         r = crefl_decl_new(db, _decl_alias);
         crefl_decl_ptr(r)->_name = crefl_name_new(db, crefl_decl_name(d));
         crefl_decl_ptr(r)->_link = crefl_decl_idx(a);
+        crefl_copy_entry(state, r, op, hash);
         (*state->map)[*hash] = r;
         return r;
     }
 
     if (node->_attr) {
         next = crefl_lookup(d.db, node->_attr);
-        c = crefl_copy_node(state, next, d);
+        c = crefl_copy_node(state, next, r);
         crefl_decl_ptr(r)->_attr = crefl_decl_idx(c);
     }
     if (node->_link) {
@@ -405,7 +733,7 @@ decl_ref crefl_copy_node(crefl_link_state *state, decl_ref d, decl_ref p,
         case _decl_function:
             next = crefl_lookup(d.db, node->_link);
             while (crefl_decl_idx(next))  {
-                c = crefl_copy_node(state, next, d);
+                c = crefl_copy_node(state, next, r);
                 if (crefl_decl_idx(last)) crefl_decl_ptr(last)->_next = crefl_decl_idx(c);
                 else crefl_decl_ptr(r)->_link = crefl_decl_idx(c);
                 last = c;
@@ -414,7 +742,7 @@ decl_ref crefl_copy_node(crefl_link_state *state, decl_ref d, decl_ref p,
             break;
         default:
             next = crefl_lookup(d.db, node->_link);
-            c = crefl_copy_node(state, next, d, true);
+            c = crefl_copy_node(state, next, r, true);
             crefl_decl_ptr(r)->_link = crefl_decl_idx(c);
             break;
         }
@@ -423,12 +751,101 @@ decl_ref crefl_copy_node(crefl_link_state *state, decl_ref d, decl_ref p,
     return r;
 }
 
+/*
+ * parallel source scan
+ *
+ * source indexes are independent so they are built by a pool of workers
+ * while the merge consumes them in input order. workers stay at most
+ * window indexes ahead of the merge to bound memory use. the merge is
+ * unchanged so output is identical to a serial merge.
+ */
+struct crefl_scan_pool
+{
+    decl_db **srcn;
+    size_t n;
+    u32 hash_alg;
+    size_t window;
+    size_t claimed;
+    size_t consumed;
+    std::vector<decl_index*> index;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable scanned;
+    std::condition_variable released;
+
+    crefl_scan_pool(decl_db **srcn, size_t n, u32 hash_alg, size_t jobs) :
+        srcn(srcn), n(n), hash_alg(hash_alg), window(jobs * 4),
+        claimed(0), consumed(0),
+        index(n, nullptr)
+    {
+        for (size_t j = 0; j < jobs; j++) {
+            workers.emplace_back([this] { work(); });
+        }
+    }
+
+    ~crefl_scan_pool()
+    {
+        for (auto &w : workers) w.join();
+    }
+
+    void work()
+    {
+        for (;;) {
+            size_t i;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                released.wait(lock, [this] {
+                    return claimed == n || claimed < consumed + window;
+                });
+                if (claimed == n) return;
+                i = claimed++;
+            }
+            decl_index *ld = crefl_index_new();
+            ld->hash_alg = hash_alg;
+            crefl_index_scan(ld, srcn[i]);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                index[i] = ld;
+            }
+            scanned.notify_all();
+        }
+    }
+
+    decl_index * take(size_t i)
+    {
+        decl_index *ld;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            scanned.wait(lock, [&] { return index[i] != nullptr; });
+            ld = index[i];
+            consumed = i + 1;
+        }
+        released.notify_all();
+        return ld;
+    }
+};
+
 int crefl_link_merge(decl_db *db, const char *name, decl_db **srcn, size_t n)
+{
+    return crefl_link_merge_jobs(db, name, srcn, n, 1);
+}
+
+int crefl_link_merge_jobs(decl_db *db, const char *name, decl_db **srcn,
+    size_t n, size_t jobs)
 {
     hashmap<decl_hash,decl_ref,_hash_fn> map;
     decl_index *ld = crefl_index_new();
+    std::unique_ptr<crefl_scan_pool> pool;
+
+    if (jobs == 0) jobs = std::max(1u, std::thread::hardware_concurrency());
+    if (jobs > 1 && n > 1) {
+        pool.reset(new crefl_scan_pool(srcn, n, db->hash_alg,
+            std::min(jobs, n)));
+    }
 
     crefl_db_defaults(db);
+    crefl_db_set_intern(db, 1);
+    ld->hash_alg = db->hash_alg;
     crefl_index_scan(ld, db);
 
     decl_ref r = crefl_decl_new(db, _decl_archive);
@@ -438,12 +855,17 @@ int crefl_link_merge(decl_db *db, const char *name, decl_db **srcn, size_t n)
 
     decl_ref l { db, 0 };
     for (size_t i = 0; i < n; i++) {
-        decl_index *src_ld = crefl_index_new();
-        crefl_index_scan(src_ld, srcn[i]);
-        crefl_link_state state{ &map, db, ld, src_ld };
+        decl_index *src_ld;
+        if (pool) {
+            src_ld = pool->take(i);
+        } else {
+            src_ld = crefl_index_new();
+            src_ld->hash_alg = db->hash_alg;
+            crefl_index_scan(src_ld, srcn[i]);
+        }
+        crefl_link_state state{ &map, db, ld, src_ld, false };
         decl_ref d = crefl_lookup(srcn[i], srcn[i]->root_element);
-        decl_ref p = crefl_decl_void(d);
-        decl_ref o = crefl_copy_node(&state, d, p);
+        decl_ref o = crefl_copy_node(&state, d, r);
         if (crefl_decl_idx(l)) crefl_decl_ptr(l)->_next = crefl_decl_idx(o);
         else crefl_decl_ptr(r)->_link = crefl_decl_idx(o);
         l = o;
@@ -454,3 +876,341 @@ int crefl_link_merge(decl_db *db, const char *name, decl_db **srcn, size_t n)
 
     return 0;
 }
+
+/*
+ * incremental update
+ *
+ * the hash map of the archive is seeded from its index, which adopts
+ * persisted hashes if the archive has them. each input source replaces
+ * the archive source with the same name or is appended. unchanged nodes
+ * alias existing nodes so only new nodes are appended. replaced nodes
+ * stay in the archive until it is compacted.
+ */
+static void crefl_link_splice(decl_db *db, decl_ref r, decl_ref o)
+{
+    decl_id *link = &crefl_decl_ptr(r)->_link;
+    while (*link) {
+        decl_ref s = crefl_lookup(db, *link);
+        if (crefl_is_source(s) &&
+            strcmp(crefl_decl_name(s), crefl_decl_name(o)) == 0) {
+            crefl_decl_ptr(o)->_next = crefl_decl_ptr(s)->_next;
+            *link = crefl_decl_idx(o);
+            return;
+        }
+        link = &crefl_decl_ptr(s)->_next;
+    }
+    *link = crefl_decl_idx(o);
+}
+
+int crefl_link_update(decl_db *db, decl_db **srcn, size_t n, size_t jobs)
+{
+    hashmap<decl_hash,decl_ref,_hash_fn> map;
+    std::unique_ptr<crefl_scan_pool> pool;
+    decl_ref r = crefl_lookup(db, db->root_element);
+    bool keep = db->hash_entry && db->hash_count == db->decl_offset;
+
+    if (!crefl_is_archive(r)) {
+        fprintf(stderr, "crefl: *** error: update target is not an archive\n");
+        return -1;
+    }
+
+    if (jobs == 0) jobs = std::max(1u, std::thread::hardware_concurrency());
+    if (jobs > 1 && n > 1) {
+        pool.reset(new crefl_scan_pool(srcn, n, db->hash_alg,
+            std::min(jobs, n)));
+    }
+
+    decl_index *ld = crefl_index_new();
+    ld->hash_alg = db->hash_alg;
+    crefl_index_scan(ld, db);
+    crefl_db_set_intern(db, 1);
+
+    for (size_t i = db->decl_builtin; i < db->decl_offset; i++) {
+        decl_ref d = crefl_lookup(db, i);
+        decl_entry *ent = crefl_entry_ptr(crefl_entry_ref(ld, d));
+        if (!(ent->props & decl_entry_valid)) continue;
+        switch (crefl_decl_tag(d)) {
+        case _decl_archive:
+        case _decl_source:
+        case _decl_alias:
+            continue;
+        }
+        if (map.find(ent->hash) == map.end()) map[ent->hash] = d;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        decl_index *src_ld;
+        if (pool) {
+            src_ld = pool->take(i);
+        } else {
+            src_ld = crefl_index_new();
+            src_ld->hash_alg = db->hash_alg;
+            crefl_index_scan(src_ld, srcn[i]);
+        }
+        crefl_link_state state{ &map, db, ld, src_ld, true };
+        decl_ref d = crefl_lookup(srcn[i], srcn[i]->root_element);
+        if (crefl_is_archive(d)) {
+            /* apply the sources of archive inputs one at a time */
+            for (decl_ref s = crefl_decl_link(d); crefl_decl_idx(s); s = crefl_decl_next(s)) {
+                crefl_link_splice(db, r, crefl_copy_node(&state, s, r));
+            }
+        } else {
+            crefl_link_splice(db, r, crefl_copy_node(&state, d, r));
+        }
+        crefl_index_destroy(src_ld);
+    }
+
+    /* the archive child list changed so rehash only the archive node */
+    crefl_entry_ptr(crefl_entry_ref(ld, r))->props &=
+        ~(decl_entry_marked | decl_entry_valid);
+    crefl_node_hash(ld, r, crefl_decl_void(r));
+
+    crefl_db_invalidate(db);
+    if (keep) crefl_db_keep_hashes(db, ld);
+    crefl_index_destroy(ld);
+
+    return 0;
+}
+
+/*
+ * renumbering
+ *
+ * rewrites the decl and name tables of db so that the user node at
+ * position i of order gets id decl_builtin + i. builtins keep their ids.
+ * nodes missing from order are dropped along with names that only they
+ * reference, so every link of a node in order must be in order. names
+ * are copied in node order and are interned. persisted entries follow
+ * their nodes unless the fqn parent of a node was dropped. link and next,
+ * if given, replace the links of nodes by their old id, so that callers
+ * do not write to tables that may be mapped read-only.
+ */
+static void crefl_db_renumber(decl_db *db, const std::vector<decl_id> &order,
+    const std::vector<decl_id> *link = nullptr,
+    const std::vector<decl_id> *next = nullptr)
+{
+    const decl_id none = (decl_id)-1;
+    size_t decl_offset = db->decl_builtin + order.size();
+    size_t decl_size = 32, name_size = 32;
+    std::vector<decl_id> decl_map(db->decl_offset, none);
+    std::vector<decl_id> name_map(db->name_offset, none);
+    std::vector<char> name(db->name, db->name + db->name_builtin);
+    decl_name_intern *in = crefl_intern_new();
+
+    for (size_t i = 0; i < db->decl_builtin; i++) decl_map[i] = (decl_id)i;
+    for (size_t i = 0; i < order.size(); i++) {
+        decl_map[order[i]] = (decl_id)(db->decl_builtin + i);
+    }
+
+    auto _name = [&](decl_id o) -> decl_id {
+        if (o < db->name_builtin) return o;
+        if (name_map[o] != none) return name_map[o];
+        const char *s = db->name + o;
+        size_t len = strlen(s);
+        decl_id n = crefl_intern_find(in, name.data(), s, len);
+        if (!n) {
+            n = (decl_id)name.size();
+            name.insert(name.end(), s, s + len + 1);
+            crefl_intern_add(in, s, len, n);
+        }
+        return name_map[o] = n;
+    };
+
+    while (decl_size < decl_offset) decl_size <<= 1;
+    decl_node *decl = (decl_node*)malloc(sizeof(decl_node) * decl_size);
+    memcpy(decl, db->decl, sizeof(decl_node) * db->decl_builtin);
+    for (size_t i = 0; i < order.size(); i++) {
+        decl_node *n = decl + db->decl_builtin + i;
+        *n = db->decl[order[i]];
+        if (link) n->_link = (*link)[order[i]];
+        if (next) n->_next = (*next)[order[i]];
+        n->_name = _name(n->_name);
+        n->_next = decl_map[n->_next];
+        n->_link = decl_map[n->_link];
+        n->_attr = decl_map[n->_attr];
+        assert(n->_next != none && n->_link != none && n->_attr != none);
+    }
+
+    decl_entry *entry = nullptr;
+    if (db->hash_entry && db->hash_count == db->decl_offset) {
+        entry = (decl_entry*)malloc(sizeof(decl_entry) * decl_offset);
+        memcpy(entry, db->hash_entry, sizeof(decl_entry) * db->decl_builtin);
+        for (size_t i = 0; i < order.size() && entry; i++) {
+            decl_entry *e = entry + db->decl_builtin + i;
+            *e = db->hash_entry[order[i]];
+            e->fqn_parent = decl_map[e->fqn_parent];
+            e->fqn_name = _name(e->fqn_name);
+            if (e->fqn_parent == none) {
+                free(entry);
+                entry = nullptr;
+            }
+        }
+    }
+
+    while (name_size < name.size()) name_size <<= 1;
+    char *name_tab = (char*)malloc(name_size);
+    memcpy(name_tab, name.data(), name.size());
+    crefl_intern_destroy(in);
+
+    bool intern = db->name_intern != nullptr;
+    decl_id root = db->root_element ? decl_map[db->root_element] : 0;
+    crefl_db_set_intern(db, 0);
+    crefl_db_invalidate(db);
+    if (db->map_addr) {
+        crefl_db_unmap(db);
+    } else {
+        free(db->decl);
+        free(db->name);
+    }
+    db->decl = decl;
+    db->decl_offset = decl_offset;
+    db->decl_size = decl_size;
+    db->name = name_tab;
+    db->name_offset = name.size();
+    db->name_size = name_size;
+    db->root_element = root;
+    if (entry) {
+        db->hash_entry = entry;
+        db->hash_count = decl_offset;
+    }
+    if (intern) crefl_db_set_intern(db, 1);
+}
+
+/*
+ * compaction
+ *
+ * marks the nodes reachable from the root element, following `next` only
+ * within the child lists of containers, and collapses each alias chain so
+ * that aliases link directly to the aliased node. intermediate aliases
+ * that are then unreachable are dropped with nodes and sources orphaned
+ * by crefl_link_update. a node of a dropped source that is still reached
+ * through an alias is kept with its `next` cleared. marked nodes keep
+ * their relative order. aliases hash as their target, so hashes are
+ * unchanged. the new links are applied by renumbering, so the tables of
+ * a mapped db are not written.
+ */
+int crefl_link_compact(decl_db *db)
+{
+    std::vector<u8> mark(db->decl_offset);
+    std::vector<decl_id> stack, order, link, next;
+    bool keep = db->hash_entry && db->hash_count == db->decl_offset;
+
+    if (db->frozen) {
+        fprintf(stderr, "crefl: *** error: modifying a frozen db\n");
+        return -1;
+    }
+    if (!db->root_element) return 0;
+
+    link.resize(db->decl_offset);
+    next.resize(db->decl_offset);
+    for (size_t i = 0; i < db->decl_builtin; i++) mark[i] = 1;
+    auto _mark = [&](decl_id i) {
+        if (mark[i]) return;
+        mark[i] = 1;
+        stack.push_back(i);
+    };
+
+    _mark(db->root_element);
+    while (!stack.empty()) {
+        decl_id i = stack.back();
+        stack.pop_back();
+        const decl_node *node = db->decl + i;
+        link[i] = node->_link;
+        if (node->_attr) _mark(node->_attr);
+        if (!node->_link) continue;
+        switch (node->_tag) {
+        case _decl_archive:
+        case _decl_source:
+        case _decl_set:
+        case _decl_enum:
+        case _decl_struct:
+        case _decl_union:
+        case _decl_function:
+            for (decl_id j = node->_link; j; j = db->decl[j]._next) _mark(j);
+            break;
+        case _decl_alias:
+            while (db->decl[link[i]]._tag == _decl_alias) {
+                link[i] = db->decl[link[i]]._link;
+            }
+            _mark(link[i]);
+            break;
+        default:
+            _mark(node->_link);
+            break;
+        }
+    }
+
+    for (size_t i = db->decl_builtin; i < db->decl_offset; i++) {
+        if (!mark[i]) continue;
+        next[i] = mark[db->decl[i]._next] ? db->decl[i]._next : 0;
+        order.push_back((decl_id)i);
+    }
+    crefl_db_renumber(db, order, &link, &next);
+
+    /* recompute entries whose fqn parents were dropped */
+    if (keep && !db->hash_entry) crefl_db_link_hashes(db);
+
+    return 0;
+}
+
+/*
+ * layout
+ *
+ * renumbers nodes so that the children of a node follow it contiguously:
+ * the attribute, then the link, or the list of a container. each child is
+ * then expanded in turn, so a struct is followed by its fields and those
+ * by their attributes and anonymous types. nodes not reached from the
+ * root element follow in their original order. no nodes are dropped.
+ */
+int crefl_link_optimize_layout(decl_db *db)
+{
+    std::vector<u8> mark(db->decl_offset);
+    std::vector<decl_id> stack, order;
+    size_t first;
+
+    if (db->frozen) {
+        fprintf(stderr, "crefl: *** error: modifying a frozen db\n");
+        return -1;
+    }
+    if (!db->root_element) return 0;
+
+    for (size_t i = 0; i < db->decl_builtin; i++) mark[i] = 1;
+    auto _emit = [&](decl_id i) {
+        if (mark[i]) return;
+        mark[i] = 1;
+        order.push_back(i);
+    };
+
+    _emit(db->root_element);
+    stack.push_back(db->root_element);
+    while (!stack.empty()) {
+        decl_node *node = db->decl + stack.back();
+        stack.pop_back();
+        first = order.size();
+        if (node->_attr) _emit(node->_attr);
+        if (node->_link) {
+            switch (node->_tag) {
+            case _decl_archive:
+            case _decl_source:
+            case _decl_set:
+            case _decl_enum:
+            case _decl_struct:
+            case _decl_union:
+            case _decl_function:
+                for (decl_id i = node->_link; i; i = db->decl[i]._next) _emit(i);
+                break;
+            default:
+                _emit(node->_link);
+                break;
+            }
+        }
+        /* expand children in order, the first child on top of the stack */
+        for (size_t i = order.size(); i > first; i--) stack.push_back(order[i - 1]);
+    }
+
+    for (size_t i = db->decl_builtin; i < db->decl_offset; i++) {
+        if (!mark[i]) order.push_back((decl_id)i);
+    }
+    crefl_db_renumber(db, order);
+
+    return 0;
+}
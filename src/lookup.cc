@@ -0,0 +1,655 @@
+/*
+ * crefl runtime library and compiler plug-in to support reflection in C.
+ *
+ * Copyright (c) 2020-2022 Michael Clark <michaeljclark@mac.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <string>
+#include <vector>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+#include <crefl/link.h>
+#include <crefl/hashmap.h>
+
+#include "internal.h"
+
+/*
+ * decl name index
+ *
+ * maps short names and fully qualified names to decl ids. names are
+ * hashed with crefl_name_hash and entries with the same hash are chained so
+ * that a lookup is one hash probe followed by string compares on the
+ * (usually single) matching entry.
+ *
+ * short names are indexed for builtin intrinsics and for every named
+ * node except fields, params, attributes and values nested within a
+ * container. fully qualified names follow the same traversal order
+ * and naming rules as crefl_entry_fqn in link.cc, so they match the
+ * fqn column printed by crefltool --dump-fqn. aliases are skipped so
+ * lookups always return the aliased node.
+ */
+
+static const u32 decl_name_end = (u32)-1;
+
+struct decl_name_entry
+{
+    decl_id decl;
+    u32 fqn;
+    u32 next_name;
+    u32 next_fqn;
+};
+
+/*
+ * fully qualified names are stored as a link to the fqn holding the
+ * prefix and the name id of the last component, like crefl_entry_fqn,
+ * so deep link chains do not copy their prefixes. len is the length of
+ * the name and sum is its crefl_name_hash state before the final fold.
+ */
+struct decl_name_fqn
+{
+    u32 parent;
+    decl_id name;
+    u64 len;
+    u64 sum;
+};
+
+/* first and last entry of a hash chain, so appends do not walk it */
+struct decl_name_chain
+{
+    u32 head;
+    u32 tail;
+};
+
+struct decl_name_index
+{
+    size_t decl_offset;
+    decl_id root_element;
+
+    hashmap<u64,decl_name_chain> name_map;
+    hashmap<u64,decl_name_chain> fqn_map;
+    std::vector<decl_name_entry> entry;
+    std::vector<decl_name_fqn> fqn;
+    std::vector<u8> visited;
+};
+
+/* absorbs bytes into a crefl_name_hash state */
+static u64 _fqn_absorb(u64 h, const char *s, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        h ^= (u8)s[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static u64 _fqn_hash(decl_name_index *index, u32 fqn)
+{
+    u64 h = index->fqn[fqn].sum;
+    return h ^ (h >> 32);
+}
+
+static u32 _fqn_append(decl_name_index *index, u32 prefix, decl_ref d)
+{
+    decl_id name = crefl_decl_ptr(d)->_name;
+    size_t nlen = strlen(d.db->name + name);
+    if (nlen == 0) return prefix;
+
+    decl_name_fqn f = { prefix, name, nlen, 0xcbf29ce484222325ull };
+    if (prefix) {
+        f.len += index->fqn[prefix].len + 2;
+        f.sum = _fqn_absorb(index->fqn[prefix].sum, "::", 2);
+    }
+    f.sum = _fqn_absorb(f.sum, d.db->name + name, nlen);
+
+    index->fqn.push_back(f);
+    return (u32)index->fqn.size() - 1;
+}
+
+/* writes the fqn and its terminator, last component first */
+static void _fqn_str(decl_db *db, decl_name_index *index, u32 fqn, char *s)
+{
+    s[index->fqn[fqn].len] = '\0';
+    for (u32 i = fqn; i; i = index->fqn[i].parent) {
+        const decl_name_fqn &f = index->fqn[i];
+        size_t nlen = strlen(db->name + f.name);
+        memcpy(s + f.len - nlen, db->name + f.name, nlen);
+        if (f.parent) memcpy(s + f.len - nlen - 2, "::", 2);
+    }
+}
+
+static bool _fqn_equal(decl_db *db, decl_name_index *index, u32 fqn,
+    const char *s, size_t len)
+{
+    if (index->fqn[fqn].len != len) return false;
+    for (u32 i = fqn; i; i = index->fqn[i].parent) {
+        const decl_name_fqn &f = index->fqn[i];
+        size_t nlen = strlen(db->name + f.name);
+        if (memcmp(s + f.len - nlen, db->name + f.name, nlen) != 0) return false;
+        if (f.parent && memcmp(s + f.len - nlen - 2, "::", 2) != 0) return false;
+    }
+    return true;
+}
+
+static void _chain_add(hashmap<u64,decl_name_chain> &map, u64 h,
+    std::vector<decl_name_entry> &entry, u32 idx, u32 decl_name_entry::*next)
+{
+    auto i = map.find(h);
+    if (i == map.end()) {
+        map.insert(h, decl_name_chain { idx, idx });
+    } else {
+        /* append to preserve traversal order within the chain */
+        entry[i->second.tail].*next = idx;
+        i->second.tail = idx;
+    }
+}
+
+static void _index_add(decl_name_index *index, decl_ref d, u32 fqn,
+    bool short_name)
+{
+    u32 idx = (u32)index->entry.size();
+    index->entry.push_back(decl_name_entry {
+        crefl_decl_idx(d), fqn, decl_name_end, decl_name_end
+    });
+    if (short_name && crefl_decl_has_name(d)) {
+        const char *name = crefl_decl_name(d);
+        _chain_add(index->name_map, crefl_name_hash(name, strlen(name)),
+            index->entry, idx, &decl_name_entry::next_name);
+    }
+    if (fqn) {
+        _chain_add(index->fqn_map, _fqn_hash(index, fqn),
+            index->entry, idx, &decl_name_entry::next_fqn);
+    }
+}
+
+static bool _is_scoped(decl_ref d, decl_ref p)
+{
+    switch (crefl_decl_tag(d)) {
+    case _decl_field: return !crefl_is_source(p);
+    case _decl_param:
+    case _decl_attribute:
+    case _decl_value: return true;
+    default: return false;
+    }
+}
+
+struct decl_name_frame
+{
+    decl_ref d;
+    decl_ref p;
+    u32 prefix;
+};
+
+/*
+ * nodes are visited in depth first order with an explicit stack so that
+ * deep link chains do not exhaust the call stack. children are pushed
+ * in reverse so they are popped in the order they are linked.
+ */
+static void _index_node(decl_name_index *index, decl_ref r)
+{
+    std::vector<decl_name_frame> stack, list;
+    decl_ref next;
+
+    stack.push_back(decl_name_frame { r, crefl_decl_void(r), 0 });
+    while (stack.size()) {
+        decl_name_frame f = stack.back();
+        decl_ref d = f.d, p = f.p;
+        decl_node *node = crefl_decl_ptr(d);
+        u32 fqn = f.prefix;
+        stack.pop_back();
+
+        if (index->visited[crefl_decl_idx(d)]) continue;
+        index->visited[crefl_decl_idx(d)] = 1;
+
+        /* see crefl_entry_fqn_link */
+        if (crefl_is_source(p) || crefl_is_archive(p)) {
+            fqn = _fqn_append(index, 0, d);
+        } else if (!crefl_is_array(d) && !crefl_is_pointer(d)) {
+            fqn = _fqn_append(index, fqn, d);
+        }
+
+        if (!crefl_is_alias(d)) {
+            _index_add(index, d, fqn, !_is_scoped(d, p));
+        }
+
+        if (node->_link) {
+            switch (crefl_decl_tag(d)) {
+            case _decl_archive:
+            case _decl_source:
+            case _decl_set:
+            case _decl_enum:
+            case _decl_struct:
+            case _decl_union:
+            case _decl_function:
+                next = crefl_lookup(d.db, node->_link);
+                while (crefl_decl_idx(next)) {
+                    list.push_back(decl_name_frame { next, d, fqn });
+                    next = crefl_decl_next(next);
+                }
+                stack.insert(stack.end(), list.rbegin(), list.rend());
+                list.clear();
+                break;
+            default:
+                stack.push_back(decl_name_frame {
+                    crefl_lookup(d.db, node->_link), d, fqn
+                });
+                break;
+            }
+        }
+        if (node->_attr) {
+            stack.push_back(decl_name_frame {
+                crefl_lookup(d.db, node->_attr), d, fqn
+            });
+        }
+    }
+}
+
+static decl_name_index * crefl_name_index_new(decl_db *db)
+{
+    decl_name_index *index = new decl_name_index();
+
+    index->decl_offset = db->decl_offset;
+    index->root_element = db->root_element;
+    index->fqn.push_back(decl_name_fqn {}); /* fqn 0 is the empty name */
+    index->visited.resize(db->decl_offset);
+    index->visited[0] = 1;
+
+    for (size_t i = 1; i < db->decl_builtin; i++) {
+        decl_ref d = crefl_lookup(db, i);
+        index->visited[i] = 1;
+        _index_add(index, d, _fqn_append(index, 0, d), true);
+    }
+    if (db->root_element) {
+        decl_ref r = crefl_root(db);
+        _index_node(index, r);
+    }
+
+    /* visited flags are only needed while building */
+    std::vector<u8>().swap(index->visited);
+
+    return index;
+}
+
+void crefl_name_index_destroy(decl_name_index *index)
+{
+    delete index;
+}
+
+static decl_name_index * _name_index(decl_db *db)
+{
+    decl_name_index *index = db->name_index;
+    if (index && (index->decl_offset != db->decl_offset ||
+                  index->root_element != db->root_element)) {
+        crefl_name_index_destroy(index);
+        index = db->name_index = nullptr;
+    }
+    if (!index) {
+        index = db->name_index = crefl_name_index_new(db);
+    }
+    return index;
+}
+
+/*
+ * split an optional tag prefix from a name, e.g. "struct foo"
+ */
+static const char * _split_tag(const char *name, decl_tag *tag)
+{
+    const char *sp = strchr(name, ' ');
+    *tag = _decl_none;
+    if (!sp) return name;
+    for (decl_tag t = _decl_none + 1; t <= _decl_alias; t++) {
+        const char *tn = crefl_tag_name(t);
+        if (strlen(tn) == (size_t)(sp - name) &&
+            strncmp(tn, name, sp - name) == 0) {
+            *tag = t;
+            return sp + 1;
+        }
+    }
+    return name;
+}
+
+decl_ref crefl_lookup_by_name(decl_db *db, const char *name)
+{
+    decl_name_index *index = _name_index(db);
+    decl_tag tag;
+
+    name = _split_tag(name, &tag);
+    auto i = index->name_map.find(crefl_name_hash(name, strlen(name)));
+    if (i == index->name_map.end()) return decl_ref { db, 0 };
+
+    for (u32 j = i->second.head; j != decl_name_end; j = index->entry[j].next_name) {
+        decl_ref d = crefl_lookup(db, index->entry[j].decl);
+        if ((tag == _decl_none || crefl_decl_tag(d) == tag) &&
+            strcmp(crefl_decl_name(d), name) == 0) {
+            return d;
+        }
+    }
+    return decl_ref { db, 0 };
+}
+
+/*
+ * decl db lookup index
+ *
+ * the section is built from the name index and the persisted hashes
+ * when an image is written and is probed in place when it is loaded.
+ * slots are filled in traversal order with linear probing and entries
+ * are never removed, so nodes with the same key are found in the order
+ * they were inserted.
+ */
+
+typedef hashmap<u64,u32> _index_map;
+
+struct _index_layout
+{
+    size_t hash_bitmap;
+    size_t hash_slot;
+    size_t fqn_bitmap;
+    size_t fqn_slot;
+    size_t fqn_str;
+    size_t size;
+};
+
+static size_t _align8(size_t n) { return (n + 7) & ~(size_t)7; }
+
+static _index_layout _index_layout_of(const decl_db_index_hdr *ih)
+{
+    _index_layout l;
+    l.hash_bitmap = sizeof(decl_db_index_hdr);
+    l.hash_slot = l.hash_bitmap + _index_map::bitmap_bytes(ih->hash_limit);
+    l.fqn_bitmap = _align8(l.hash_slot + sizeof(u32) * ih->hash_limit);
+    l.fqn_slot = l.fqn_bitmap + _index_map::bitmap_bytes(ih->fqn_limit);
+    l.fqn_str = l.fqn_slot + sizeof(decl_db_index_fqn) * ih->fqn_limit;
+    l.size = _align8(l.fqn_str + ih->fqn_size);
+    return l;
+}
+
+/* power of two slot count with a load of at most one half */
+static u32 _index_limit(size_t count)
+{
+    size_t limit = 16;
+    if (count == 0) return 0;
+    while (limit < count * 2) limit <<= 1;
+    return (u32)limit;
+}
+
+static u64 _index_hash_key(const decl_hash *hash)
+{
+    u64 h;
+    memcpy(&h, hash->sum, sizeof(h));
+    return h;
+}
+
+static int _index_has_hashes(decl_db *db)
+{
+    return db->hash_entry && db->hash_count == db->decl_offset;
+}
+
+/* the lookup index of a loaded image, dropped if nodes were appended */
+static const decl_db_index_hdr * _lookup_index(decl_db *db)
+{
+    const decl_db_index_hdr *ih = (const decl_db_index_hdr*)db->lookup;
+    if (ih && ih->decl_count != db->decl_offset) {
+        crefl_db_drop_lookup(db);
+        ih = nullptr;
+    }
+    return ih;
+}
+
+/*
+ * string table offsets of the fqns of the entries. returns the table
+ * size, or zero if it exceeds the u32 offsets of the section, in which
+ * case fqns are left out and lookups by fqn use the name index.
+ */
+static size_t _index_fqn_offsets(decl_name_index *index, std::vector<u32> *off)
+{
+    std::vector<u32> o(index->fqn.size());
+    size_t size = 1; /* offset 0 holds empty string */
+    for (auto &e : index->entry) {
+        if (!e.fqn || o[e.fqn]) continue;
+        if (index->fqn[e.fqn].len >= (u32)-1 - size) return 0;
+        o[e.fqn] = (u32)size;
+        size += index->fqn[e.fqn].len + 1;
+    }
+    if (off) off->swap(o);
+    return size;
+}
+
+static decl_db_index_hdr _index_hdr(decl_db *db, decl_name_index *index)
+{
+    size_t hash_count = 0, fqn_count = 0;
+    size_t fqn_size = _index_fqn_offsets(index, nullptr);
+    if (_index_has_hashes(db)) {
+        for (size_t i = 0; i < db->decl_offset; i++) {
+            hash_count += (db->hash_entry[i].props & decl_entry_valid) != 0;
+        }
+    }
+    if (fqn_size) {
+        for (auto &e : index->entry) fqn_count += e.fqn != 0;
+    }
+    return decl_db_index_hdr {
+        _index_limit(hash_count), _index_limit(fqn_count),
+        fqn_size ? (u32)fqn_size : 1, (u32)db->decl_offset
+    };
+}
+
+static size_t _index_probe_free(uint64_t *bitmap, size_t limit, u64 h)
+{
+    size_t i = h & (limit - 1);
+    while (_index_map::bitmap_get(bitmap, i) & _index_map::occupied) {
+        i = (i + 1) & (limit - 1);
+    }
+    _index_map::bitmap_set(bitmap, i, _index_map::occupied);
+    return i;
+}
+
+size_t crefl_db_index_size(decl_db *db)
+{
+    if (!db->indexed) return 0;
+    decl_db_index_hdr ih = _index_hdr(db, _name_index(db));
+    return _index_layout_of(&ih).size;
+}
+
+void crefl_db_index_write(decl_db *db, uint8_t *buf)
+{
+    decl_name_index *index = _name_index(db);
+    decl_db_index_hdr ih = _index_hdr(db, index);
+    _index_layout l = _index_layout_of(&ih);
+
+    /* built in an aligned buffer as the output may not be aligned */
+    std::vector<uint64_t> section(l.size / sizeof(uint64_t));
+    u8 *p = (u8*)section.data();
+    memcpy(p, &ih, sizeof(ih));
+
+    if (ih.hash_limit) {
+        uint64_t *bitmap = (uint64_t*)(p + l.hash_bitmap);
+        u32 *slot = (u32*)(p + l.hash_slot);
+        for (size_t i = 0; i < db->decl_offset; i++) {
+            const decl_entry *e = db->hash_entry + i;
+            if (!(e->props & decl_entry_valid)) continue;
+            slot[_index_probe_free(bitmap, ih.hash_limit,
+                _index_hash_key(&e->hash))] = (u32)i;
+        }
+    }
+    if (ih.fqn_limit) {
+        uint64_t *bitmap = (uint64_t*)(p + l.fqn_bitmap);
+        decl_db_index_fqn *slot = (decl_db_index_fqn*)(p + l.fqn_slot);
+        char *str = (char*)(p + l.fqn_str);
+        std::vector<u32> off;
+        _index_fqn_offsets(index, &off);
+        for (auto &e : index->entry) {
+            if (!e.fqn) continue;
+            slot[_index_probe_free(bitmap, ih.fqn_limit,
+                _fqn_hash(index, e.fqn))] = decl_db_index_fqn { e.decl, off[e.fqn] };
+            _fqn_str(db, index, e.fqn, str + off[e.fqn]);
+        }
+    }
+
+    memcpy(buf, p, l.size);
+}
+
+size_t crefl_db_index_section_size(const void *section)
+{
+    decl_db_index_hdr ih;
+    memcpy(&ih, section, sizeof(ih));
+    if (!_index_map::is_pow2(ih.hash_limit) || !_index_map::is_pow2(ih.fqn_limit) ||
+        ih.hash_limit > (1u << 31) || ih.fqn_limit > (1u << 31)) {
+        return 0;
+    }
+    return _index_layout_of(&ih).size;
+}
+
+int crefl_db_index_check(decl_db *db)
+{
+    if (!db->lookup) return 0;
+
+    const u8 *p = (const u8*)db->lookup;
+    const decl_db_index_hdr *ih = (const decl_db_index_hdr*)p;
+    _index_layout l = _index_layout_of(ih);
+
+    if (ih->decl_count != db->decl_offset) {
+        fprintf(stderr, "crefl: *** error: lookup index count mismatch\n");
+        return -1;
+    }
+    if (ih->hash_limit && !_index_has_hashes(db)) {
+        fprintf(stderr, "crefl: *** error: lookup index without hashes\n");
+        return -1;
+    }
+    if (ih->fqn_size && p[l.fqn_str + ih->fqn_size - 1] != '\0') {
+        fprintf(stderr, "crefl: *** error: lookup index fqn unterminated\n");
+        return -1;
+    }
+    /* probes end at a free slot, so a full table is rejected */
+    size_t used = 0;
+    const uint64_t *hash_bitmap = (const uint64_t*)(p + l.hash_bitmap);
+    const u32 *hash_slot = (const u32*)(p + l.hash_slot);
+    for (size_t i = 0; i < ih->hash_limit; i++) {
+        if (!(_index_map::bitmap_get((uint64_t*)hash_bitmap, i) & _index_map::occupied)) continue;
+        if (hash_slot[i] >= db->decl_offset) goto err;
+        used++;
+    }
+    if (ih->hash_limit && used >= ih->hash_limit) goto full;
+    used = 0;
+    {
+        const uint64_t *fqn_bitmap = (const uint64_t*)(p + l.fqn_bitmap);
+        const decl_db_index_fqn *fqn_slot = (const decl_db_index_fqn*)(p + l.fqn_slot);
+        for (size_t i = 0; i < ih->fqn_limit; i++) {
+            if (!(_index_map::bitmap_get((uint64_t*)fqn_bitmap, i) & _index_map::occupied)) continue;
+            if (fqn_slot[i].decl >= db->decl_offset ||
+                fqn_slot[i].fqn >= ih->fqn_size) goto err;
+            used++;
+        }
+    }
+    if (ih->fqn_limit && used >= ih->fqn_limit) goto full;
+    return 0;
+
+err:
+    fprintf(stderr, "crefl: *** error: lookup index slot out of bounds\n");
+    return -1;
+full:
+    fprintf(stderr, "crefl: *** error: lookup index has no free slot\n");
+    return -1;
+}
+
+static decl_ref _index_lookup_fqn(decl_db *db, const decl_db_index_hdr *ih,
+    const char *fqn, decl_tag tag)
+{
+    const u8 *p = (const u8*)ih;
+    _index_layout l = _index_layout_of(ih);
+    uint64_t *bitmap = (uint64_t*)(p + l.fqn_bitmap);
+    const decl_db_index_fqn *slot = (const decl_db_index_fqn*)(p + l.fqn_slot);
+    const char *str = (const char*)(p + l.fqn_str);
+    size_t mask = ih->fqn_limit - 1;
+
+    /* probes are bounded as unchecked sections may have no free slot */
+    if (!ih->fqn_limit) return decl_ref { db, 0 };
+    for (size_t n = 0, i = crefl_name_hash(fqn, strlen(fqn)) & mask;
+         n < ih->fqn_limit && (_index_map::bitmap_get(bitmap, i) & _index_map::occupied);
+         n++, i = (i + 1) & mask) {
+        decl_ref d = crefl_lookup(db, slot[i].decl);
+        if ((tag == _decl_none || crefl_decl_tag(d) == tag) &&
+            strcmp(str + slot[i].fqn, fqn) == 0) {
+            return d;
+        }
+    }
+    return decl_ref { db, 0 };
+}
+
+/*
+ * probes the lookup index if present, else scans the persisted hashes.
+ * returns the first node with the hash, or none if there are no hashes.
+ */
+decl_ref crefl_lookup_by_hash(decl_db *db, const decl_hash *hash)
+{
+    const decl_db_index_hdr *ih = _lookup_index(db);
+    if (!_index_has_hashes(db)) return decl_ref { db, 0 };
+
+    if (ih && ih->hash_limit) {
+        const u8 *p = (const u8*)ih;
+        _index_layout l = _index_layout_of(ih);
+        uint64_t *bitmap = (uint64_t*)(p + l.hash_bitmap);
+        const u32 *slot = (const u32*)(p + l.hash_slot);
+        size_t mask = ih->hash_limit - 1;
+        for (size_t n = 0, i = _index_hash_key(hash) & mask;
+             n < ih->hash_limit && (_index_map::bitmap_get(bitmap, i) & _index_map::occupied);
+             n++, i = (i + 1) & mask) {
+            if (memcmp(&db->hash_entry[slot[i]].hash, hash, sizeof(*hash)) == 0) {
+                return decl_ref { db, slot[i] };
+            }
+        }
+        return decl_ref { db, 0 };
+    }
+    for (size_t i = 0; i < db->decl_offset; i++) {
+        const decl_entry *e = db->hash_entry + i;
+        if ((e->props & decl_entry_valid) &&
+            memcmp(&e->hash, hash, sizeof(*hash)) == 0) {
+            return decl_ref { db, i };
+        }
+    }
+    return decl_ref { db, 0 };
+}
+
+decl_ref crefl_lookup_by_fqn(decl_db *db, const char *fqn)
+{
+    decl_tag tag;
+
+    fqn = _split_tag(fqn, &tag);
+    const decl_db_index_hdr *ih = _lookup_index(db);
+    if (ih && ih->fqn_limit) return _index_lookup_fqn(db, ih, fqn, tag);
+
+    decl_name_index *index = _name_index(db);
+    size_t len = strlen(fqn);
+    auto i = index->fqn_map.find(crefl_name_hash(fqn, len));
+    if (i == index->fqn_map.end()) return decl_ref { db, 0 };
+
+    for (u32 j = i->second.head; j != decl_name_end; j = index->entry[j].next_fqn) {
+        decl_ref d = crefl_lookup(db, index->entry[j].decl);
+        if ((tag == _decl_none || crefl_decl_tag(d) == tag) &&
+            _fqn_equal(db, index, index->entry[j].fqn, fqn, len)) {
+            return d;
+        }
+    }
+    return decl_ref { db, 0 };
+}
+
+/* drops a stale lookup index and builds the name index, see crefl_db_freeze */
+void crefl_name_index_build(decl_db *db)
+{
+    _lookup_index(db);
+    _name_index(db);
+}
@@ -22,9 +22,17 @@
 
 #include <string>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include <crefl/bits.h>
 #include <crefl/model.h>
+#include <crefl/db.h>
 #include <crefl/types.h>
+#include <crefl/hashmap.h>
+
+#include "internal.h"
 
 #define array_size(arr) ((sizeof(arr)/sizeof(arr[0])))
 
@@ -130,11 +138,79 @@ decl_db * crefl_db_new()
     memset(db->decl, 0, sizeof(decl_node) * db->decl_size);
 
     db->root_element = 0;
+    db->hash_alg = 0;
+    db->packed = 0;
+    db->indexed = 0;
+
+    db->map_addr = nullptr;
+    db->map_size = 0;
+
+    db->name_index = nullptr;
+    db->layout = nullptr;
+    db->child_index = nullptr;
+    db->columns = nullptr;
+    db->intrinsic_map = nullptr;
+    db->name_intern = nullptr;
+    db->column_mode = 0;
+    db->frozen = 0;
+
+    db->hash_entry = nullptr;
+    db->hash_count = 0;
+    db->hash_image = 0;
+
+    db->lookup = nullptr;
+    db->lookup_image = 0;
 
     return db;
 }
 
-void crefl_db_defaults(decl_db *db)
+/*
+ * intrinsic map
+ *
+ * maps (props, width) to the first builtin intrinsic matching the query
+ * in crefl_intrinsic. it is populated by crefl_db_defaults with the props
+ * classes used to resolve scalar types and with the exact props of each
+ * builtin. builtins are immutable so the map survives crefl_db_invalidate
+ * and is shared by the dbs created from the builtin segment.
+ */
+
+struct _intrinsic_hash
+{
+    size_t operator()(u64 k) const {
+        k *= 0x9e3779b97f4a7c15ull;
+        return k ^ (k >> 29);
+    }
+};
+
+struct decl_intrinsic_map
+{
+    hashmap<u64,decl_id,_intrinsic_hash> map;
+};
+
+static const decl_set _intrinsic_classes[] = {
+    _decl_void, _decl_sint, _decl_uint, _decl_float, _decl_cfloat
+};
+
+static u64 _intrinsic_key(decl_set props, size_t width)
+{
+    return ((u64)props << 32) | (u64)(u32)width;
+}
+
+static void _intrinsic_map_add(decl_db *db, decl_set props, size_t width)
+{
+    u64 key = _intrinsic_key(props, width);
+    if (db->intrinsic_map->map.find(key) != db->intrinsic_map->map.end()) return;
+    for (decl_id i = 0; i < db->decl_builtin; i++) {
+        decl_node *n = db->decl + i;
+        if (n->_tag == _decl_intrinsic && n->_width == width &&
+            (n->_props & props) == props) {
+            db->intrinsic_map->map.insert(key, i);
+            return;
+        }
+    }
+}
+
+static void _db_append_builtins(decl_db *db)
 {
     const _ctype **d = all_types;
     while (*d != 0) {
@@ -149,17 +225,161 @@ void crefl_db_defaults(decl_db *db)
     /* save builtin offsets */
     db->name_builtin = db->name_offset;
     db->decl_builtin = db->decl_offset;
+
+    /* map each query class to the first builtin it matches */
+    if (!db->intrinsic_map) db->intrinsic_map = new decl_intrinsic_map();
+    for (decl_id i = 0; i < db->decl_builtin; i++) {
+        decl_node *n = db->decl + i;
+        if (n->_tag != _decl_intrinsic) continue;
+        for (size_t j = 0; j < array_size(_intrinsic_classes); j++) {
+            _intrinsic_map_add(db, _intrinsic_classes[j], n->_width);
+        }
+        _intrinsic_map_add(db, n->_props, n->_width);
+    }
+}
+
+/*
+ * builtin segment
+ *
+ * the builtin nodes, names and intrinsic map are built once per process
+ * in a db that is never modified. crefl_db_defaults copies the nodes and
+ * names of the segment into empty dbs, as ids index a single table, and
+ * shares its intrinsic map, so that opening a db does not rebuild them.
+ */
+
+const decl_db * crefl_db_builtin()
+{
+    static decl_db *builtin = [] {
+        decl_db *db = crefl_db_new();
+        _db_append_builtins(db);
+        return db;
+    }();
+    return builtin;
+}
+
+void crefl_db_defaults(decl_db *db)
+{
+    const decl_db *b = crefl_db_builtin();
+
+    /* dbs that are not empty append their own builtins */
+    if (db->decl_offset != 1 || db->name_offset != 1 ||
+        db->name_intern || db->map_addr) {
+        _db_append_builtins(db);
+        return;
+    }
+
+    if (db->decl_size < b->decl_builtin) {
+        while (db->decl_size < b->decl_builtin) db->decl_size <<= 1;
+        db->decl = (decl_node*)realloc(db->decl, sizeof(decl_node) * db->decl_size);
+    }
+    if (db->name_size < b->name_builtin) {
+        while (db->name_size < b->name_builtin) db->name_size <<= 1;
+        db->name = (char*)realloc(db->name, db->name_size);
+    }
+    crefl_db_invalidate(db);
+    memcpy(db->decl, b->decl, sizeof(decl_node) * b->decl_builtin);
+    memcpy(db->name, b->name, b->name_builtin);
+    db->decl_offset = db->decl_builtin = b->decl_builtin;
+    db->name_offset = db->name_builtin = b->name_builtin;
+    if (db->intrinsic_map != b->intrinsic_map) delete db->intrinsic_map;
+    db->intrinsic_map = b->intrinsic_map;
+}
+
+/* frozen dbs may be read by other threads so changes are fatal */
+static void _db_check_mutable(decl_db *db)
+{
+    if (!db->frozen) return;
+    fprintf(stderr, "crefl: *** error: modifying a frozen db\n");
+    abort();
+}
+
+void crefl_db_invalidate(decl_db *db)
+{
+    _db_check_mutable(db);
+    if (db->name_index) {
+        crefl_name_index_destroy(db->name_index);
+        db->name_index = nullptr;
+    }
+    if (db->layout) {
+        crefl_layout_destroy(db->layout);
+        db->layout = nullptr;
+    }
+    if (db->child_index) {
+        crefl_child_index_destroy(db->child_index);
+        db->child_index = nullptr;
+    }
+    if (db->columns) {
+        crefl_columns_destroy(db->columns);
+        db->columns = nullptr;
+    }
+    crefl_db_drop_hashes(db);
+    crefl_db_drop_lookup(db);
+}
+
+void crefl_db_drop_hashes(decl_db *db)
+{
+    if (!db->hash_entry) return;
+    if (!db->hash_image) free(db->hash_entry);
+    db->hash_entry = nullptr;
+    db->hash_count = 0;
+    db->hash_image = 0;
+}
+
+void crefl_db_drop_lookup(decl_db *db)
+{
+    if (!db->lookup) return;
+    if (!db->lookup_image) free((void*)db->lookup);
+    db->lookup = nullptr;
+    db->lookup_image = 0;
 }
 
 void crefl_db_destroy(decl_db *db)
 {
-    free(db->name);
-    free(db->decl);
+    db->frozen = 0;
+    crefl_db_invalidate(db);
+    if (db->intrinsic_map != crefl_db_builtin()->intrinsic_map) {
+        delete db->intrinsic_map;
+    }
+    if (db->name_intern) crefl_intern_destroy(db->name_intern);
+    if (db->map_addr) {
+        crefl_db_unmap(db);
+    } else {
+        free(db->name);
+        free(db->decl);
+    }
     free(db);
 }
 
+/*
+ * copy tables of a mapped db to the heap before they are modified
+ */
+static void _db_detach(decl_db *db)
+{
+    if (!db->map_addr) return;
+
+    size_t decl_size = 32, name_size = 32;
+    while (decl_size < db->decl_offset) decl_size <<= 1;
+    while (name_size < db->name_offset) name_size <<= 1;
+
+    size_t decl_offset = db->decl_offset, name_offset = db->name_offset;
+    decl_node *decl = (decl_node*)malloc(sizeof(decl_node) * decl_size);
+    char *name = (char*)malloc(name_size);
+    memcpy(decl, db->decl, sizeof(decl_node) * decl_offset);
+    memcpy(name, db->name, name_offset);
+
+    crefl_db_unmap(db);
+    db->decl = decl;
+    db->decl_offset = decl_offset;
+    db->decl_size = decl_size;
+    db->name = name;
+    db->name_offset = name_offset;
+    db->name_size = name_size;
+}
+
 decl_ref crefl_decl_new(decl_db *db, decl_tag tag)
 {
+    crefl_db_invalidate(db);
+    _db_detach(db);
     if (db->decl_offset >= db->decl_size) {
         db->decl_size <<= 1;
         db->decl = (decl_node*)realloc(db->decl, sizeof(decl_node) * db->decl_size);
@@ -174,6 +394,19 @@ decl_id crefl_name_new(decl_db *db, const char *name)
 {
     size_t len = strlen(name) + 1;
     if (len == 1) return 0;
+    if (db->name_intern) {
+        decl_id o = crefl_intern_find(db->name_intern, db->name, name, len - 1);
+        if (o) return o;
+    }
+    /* node tables do not depend on names and are kept */
+    _db_check_mutable(db);
+    if (db->name_index) {
+        crefl_name_index_destroy(db->name_index);
+        db->name_index = nullptr;
+    }
+    crefl_db_drop_hashes(db);
+    crefl_db_drop_lookup(db);
+    _db_detach(db);
     if (db->name_offset + len > db->name_size) {
         while (db->name_offset + len > db->name_size) {
             db->name_size <<= 1;
@@ -183,9 +416,77 @@ decl_id crefl_name_new(decl_db *db, const char *name)
     size_t name_offset = db->name_offset;
     db->name_offset += len;
     memcpy(db->name + name_offset, name, len);
+    if (db->name_intern) {
+        crefl_intern_add(db->name_intern, name, len - 1, name_offset);
+    }
     return name_offset;
 }
 
+/*
+ * name interning
+ *
+ * maps name hashes to the offset of the first name with that hash.
+ * names with colliding hashes are not interned and are appended.
+ */
+
+struct decl_name_intern
+{
+    hashmap<u64,decl_id> map;
+};
+
+u64 crefl_name_hash(const char *s, size_t len)
+{
+    u64 h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (u8)s[i];
+        h *= 0x100000001b3ull;
+    }
+    return h ^ (h >> 32);
+}
+
+decl_name_intern * crefl_intern_new()
+{
+    return new decl_name_intern();
+}
+
+void crefl_intern_destroy(decl_name_intern *in)
+{
+    delete in;
+}
+
+decl_id crefl_intern_find(decl_name_intern *in, const char *table,
+    const char *name, size_t len)
+{
+    auto i = in->map.find(crefl_name_hash(name, len));
+    if (i == in->map.end()) return 0;
+    const char *s = table + i->second;
+    return (memcmp(s, name, len) == 0 && s[len] == '\0') ? i->second : 0;
+}
+
+void crefl_intern_add(decl_name_intern *in, const char *name, size_t len,
+    decl_id offset)
+{
+    u64 h = crefl_name_hash(name, len);
+    if (in->map.find(h) == in->map.end()) in->map.insert(h, offset);
+}
+
+void crefl_db_set_intern(decl_db *db, int intern)
+{
+    _db_check_mutable(db);
+    if (!intern) {
+        if (db->name_intern) crefl_intern_destroy(db->name_intern);
+        db->name_intern = nullptr;
+        return;
+    }
+    if (db->name_intern) return;
+    db->name_intern = crefl_intern_new();
+    for (size_t o = 1; o < db->name_offset; ) {
+        size_t len = strlen(db->name + o);
+        crefl_intern_add(db->name_intern, db->name + o, len, (decl_id)o);
+        o += len + 1;
+    }
+}
+
 const char* crefl_decl_name(decl_ref d)
 {
     return d.db->name + crefl_decl_ptr(d)->_name;
@@ -196,6 +497,112 @@ int crefl_decl_has_name(decl_ref d)
     return crefl_decl_ptr(d)->_name != 0;
 }
 
+/*
+ * column table
+ *
+ * dense copies of the tag, props and quantity fields of each node. tags
+ * are stored in one byte so that a 16-byte compare tests 16 nodes. the
+ * table is built on first use in column mode and dropped by invalidate.
+ */
+
+struct decl_columns
+{
+    size_t decl_offset;
+    u8 *tag;
+    decl_set *props;
+    decl_sz *quantity;
+};
+
+static const decl_tag _column_tag_max = 0xff;
+
+void crefl_columns_destroy(decl_columns *columns)
+{
+    free(columns->tag);
+    free(columns->props);
+    free(columns->quantity);
+    free(columns);
+}
+
+static decl_columns * crefl_columns_new(decl_db *db)
+{
+    size_t n = db->decl_offset;
+    decl_columns *columns = (decl_columns*)malloc(sizeof(decl_columns));
+
+    columns->decl_offset = n;
+    columns->tag = (u8*)malloc(n);
+    columns->props = (decl_set*)malloc(sizeof(decl_set) * n);
+    columns->quantity = (decl_sz*)malloc(sizeof(decl_sz) * n);
+    for (size_t i = 0; i < n; i++) {
+        const decl_node *d = db->decl + i;
+        columns->tag[i] = (u8)(d->_tag < _column_tag_max ? d->_tag : _column_tag_max);
+        columns->props[i] = d->_props;
+        columns->quantity[i] = d->_quantity;
+    }
+
+    return columns;
+}
+
+static decl_columns * _columns(decl_db *db)
+{
+    decl_columns *columns = db->columns;
+    if (columns && columns->decl_offset != db->decl_offset) {
+        crefl_columns_destroy(columns);
+        columns = db->columns = nullptr;
+    }
+    if (!columns) {
+        columns = db->columns = crefl_columns_new(db);
+    }
+    return columns;
+}
+
+void crefl_db_set_columns(decl_db *db, int columns)
+{
+    _db_check_mutable(db);
+    db->column_mode = columns != 0;
+    if (!columns && db->columns) {
+        crefl_columns_destroy(db->columns);
+        db->columns = nullptr;
+    }
+}
+
+/*
+ * calls fn with the id of each node in [start, end) with the given tag
+ * until fn returns false.
+ */
+template <typename F>
+static void _columns_scan(const u8 *col, size_t start, size_t end, u8 tag, F fn)
+{
+    size_t i = start;
+#if defined(__SSE2__)
+    const __m128i t = _mm_set1_epi8((char)tag);
+    for (; i + 16 <= end; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(col + i));
+        u32 m = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(v, t));
+        while (m) {
+            if (!fn(i + ctz(m))) return;
+            m &= m - 1;
+        }
+    }
+#endif
+    for (; i < end; i++) {
+        if (col[i] == tag && !fn(i)) return;
+    }
+}
+
+static decl_ref _columns_intrinsic(decl_db *db, decl_set props, size_t width)
+{
+    decl_columns *columns = _columns(db);
+    size_t r = 0;
+    _columns_scan(columns->tag, 0, columns->decl_offset, _decl_intrinsic,
+        [&](size_t i) {
+            if (columns->quantity[i] != width ||
+                (columns->props[i] & props) != props) return true;
+            r = i;
+            return false;
+        });
+    return decl_ref { db, r };
+}
+
 decl_ref crefl_root(decl_db *db)
 {
     return decl_ref { db, db->root_element };
@@ -203,6 +610,14 @@ decl_ref crefl_root(decl_db *db)
 
 decl_ref crefl_intrinsic(decl_db *db, decl_set props, size_t width)
 {
+    if (db->intrinsic_map) {
+        auto i = db->intrinsic_map->map.find(_intrinsic_key(props, width));
+        if (i != db->intrinsic_map->map.end()) {
+            return decl_ref { db, i->second };
+        }
+    }
+    /* fall back to a scan for queries outside the builtin classes */
+    if (db->column_mode) return _columns_intrinsic(db, props, width);
     for (size_t i = 0; i < db->decl_offset; i++) {
         decl_ref d = crefl_lookup(db, i);
         if (crefl_is_intrinsic(d) &&
@@ -214,10 +629,122 @@ decl_ref crefl_intrinsic(decl_db *db, decl_set props, size_t width)
     return decl_ref { db, 0 };
 }
 
-static int _decl_array_fetch(decl_db *db, decl_ref *r, size_t *s, decl_ref d,
+/*
+ * child index
+ *
+ * compressed sparse row index of the members of each container node so
+ * that list queries can return contiguous spans without following next
+ * links. members are the children matched by the canonical list query
+ * for the container: constants for set and enum, fields for struct and
+ * union, params for function, sources for archive and all decls for
+ * source. the index is built on first use and dropped by invalidate.
+ */
+
+struct decl_child_index
+{
+    size_t decl_offset;
+    decl_id *offset;
+    decl_id *child;
+};
+
+static int (*_member_lambda(decl_tag tag))(decl_ref)
+{
+    switch (tag) {
+    case _decl_set:
+    case _decl_enum: return crefl_is_constant;
+    case _decl_struct:
+    case _decl_union: return crefl_is_field;
+    case _decl_function: return crefl_is_param;
+    case _decl_source: return crefl_is_any;
+    case _decl_archive: return crefl_is_source;
+    default: return nullptr;
+    }
+}
+
+void crefl_child_index_destroy(decl_child_index *index)
+{
+    free(index->offset);
+    free(index->child);
+    free(index);
+}
+
+static decl_child_index * crefl_child_index_new(decl_db *db)
+{
+    size_t count = 0, limit = 32;
+    decl_child_index *index = (decl_child_index*)malloc(sizeof(decl_child_index));
+
+    index->decl_offset = db->decl_offset;
+    index->offset = (decl_id*)malloc(sizeof(decl_id) * (db->decl_offset + 1));
+    index->child = (decl_id*)malloc(sizeof(decl_id) * limit);
+
+    for (size_t i = 0; i < db->decl_offset; i++) {
+        decl_ref p = crefl_lookup(db, i);
+        int (*lambda)(decl_ref) = _member_lambda(crefl_decl_tag(p));
+        index->offset[i] = (decl_id)count;
+        if (!lambda) continue;
+        for (decl_ref d = crefl_decl_link(p); crefl_decl_idx(d);
+             d = crefl_decl_next(d)) {
+            if (!lambda(d)) continue;
+            if (count == limit) {
+                limit <<= 1;
+                index->child = (decl_id*)realloc(index->child,
+                    sizeof(decl_id) * limit);
+            }
+            index->child[count++] = crefl_decl_idx(d);
+        }
+    }
+    index->offset[db->decl_offset] = (decl_id)count;
+
+    return index;
+}
+
+static decl_child_index * _child_index(decl_db *db)
+{
+    decl_child_index *index = db->child_index;
+    if (index && index->decl_offset != db->decl_offset) {
+        crefl_child_index_destroy(index);
+        index = db->child_index = nullptr;
+    }
+    if (!index) {
+        index = db->child_index = crefl_child_index_new(db);
+    }
+    return index;
+}
+
+static const decl_id * _decl_span(decl_ref p, decl_tag tag, size_t *s)
+{
+    if (crefl_decl_tag(p) != tag) {
+        if (s) *s = 0;
+        return nullptr;
+    }
+    decl_child_index *index = _child_index(p.db);
+    decl_id o = index->offset[p.decl_idx];
+    if (s) *s = index->offset[p.decl_idx + 1] - o;
+    return index->child + o;
+}
+
+static int _decl_array_fetch(decl_ref p, decl_ref *r, size_t *s,
     int(*decl_lambda)(decl_ref))
 {
     size_t count = 0, limit = s ? *s : 0;
+    decl_child_index *index = p.db->child_index;
+    if (index && index->decl_offset == p.db->decl_offset) {
+        /* the member span is a superset of every list query filter */
+        decl_id *i = index->child + index->offset[p.decl_idx];
+        decl_id *e = index->child + index->offset[p.decl_idx + 1];
+        for (; i != e; i++) {
+            decl_ref d = crefl_lookup(p.db, *i);
+            if (decl_lambda(d)) {
+                if (r && count < limit) {
+                    r[count] = d;
+                }
+                count++;
+            }
+        }
+        if (s) *s = count;
+        return 0;
+    }
+    decl_ref d = crefl_decl_link(p);
     while (crefl_decl_idx(d))  {
         if (decl_lambda(d)) {
             if (r && count < limit) {
@@ -265,6 +792,45 @@ static _alignment _pad_align(size_t width, size_t count, decl_set props)
     return { n, _align(width, n) * count };
 }
 
+/*
+ * layout table
+ *
+ * memoizes the size and alignment of each node and the offset of each
+ * struct field so that layout queries are computed once per node. the
+ * table is allocated on first use and dropped by crefl_db_invalidate.
+ */
+
+struct _layout_entry { u64 size; u64 offset; u32 align; u32 valid; };
+
+struct decl_layout
+{
+    size_t decl_offset;
+    _layout_entry *entry;
+};
+
+void crefl_layout_destroy(decl_layout *layout)
+{
+    free(layout->entry);
+    free(layout);
+}
+
+static _layout_entry * _layout_entry_ptr(decl_ref d)
+{
+    decl_layout *layout = d.db->layout;
+    if (layout && layout->decl_offset != d.db->decl_offset) {
+        crefl_layout_destroy(layout);
+        layout = d.db->layout = nullptr;
+    }
+    if (!layout) {
+        layout = (decl_layout*)malloc(sizeof(decl_layout));
+        layout->decl_offset = d.db->decl_offset;
+        layout->entry = (_layout_entry*)calloc(layout->decl_offset,
+            sizeof(_layout_entry));
+        d.db->layout = layout;
+    }
+    return layout->entry + d.decl_idx;
+}
+
 static _alignment _type_pad(decl_ref d);
 
 static _alignment _field_pad(decl_ref d)
@@ -316,7 +882,9 @@ static _alignment _struct_pad(decl_ref d)
             _alignment pad = _type_pad(crefl_field_type(d));
             if (pad.align > max.align) max.align = pad.align;
             if (pad.size > max.size) max.size = pad.size;
-            offset = _align(offset, pad.align) + pad.size;
+            offset = _align(offset, pad.align);
+            _layout_entry_ptr(d)->offset = offset;
+            offset += pad.size;
         }
         d = crefl_decl_next(d);
     }
@@ -343,7 +911,7 @@ static _alignment _union_pad(decl_ref d)
     return max;
 }
 
-static _alignment _type_pad(decl_ref d)
+static _alignment _decl_pad(decl_ref d)
 {
     switch (crefl_decl_tag(d)) {
     case _decl_intrinsic: return _intrinsic_pad(d);
@@ -356,32 +924,47 @@ static _alignment _type_pad(decl_ref d)
     return _alignment { 0 };
 }
 
+static _alignment _type_pad(decl_ref d)
+{
+    _layout_entry *ent = _layout_entry_ptr(d);
+    if (!ent->valid) {
+        _alignment pad = _decl_pad(d);
+        ent->size = pad.size;
+        ent->align = (u32)pad.align;
+        ent->valid = 1;
+    }
+    return _alignment { ent->align, ent->size };
+}
+
+static _alignment _tag_pad(decl_ref d, decl_tag tag)
+{
+    return crefl_decl_tag(d) == tag ? _type_pad(d) : _alignment { 0 };
+}
+
 int crefl_struct_fields_offsets(decl_ref d, decl_ref *r, size_t *o, size_t *s)
 {
-    size_t count = 0, offset = 0, limit = s ? *s : 0;
-    _alignment max = { 0 };
+    size_t count = 0, limit = s ? *s : 0;
+    _alignment pad;
 
     if (!crefl_is_struct(d)) return -1;
 
+    /* computing the struct layout records the offset of each field */
+    pad = _type_pad(d);
+
     d = crefl_decl_link(d);
     while (crefl_decl_idx(d))  {
         if (crefl_is_field(d)) {
-            _alignment pad = _type_pad(crefl_field_type(d));
-            if (pad.align > max.align) max.align = pad.align;
-            if (pad.size > max.size) max.size = pad.size;
-            offset = _align(offset, pad.align);
             if (count < limit) {
                 if (r) r[count] = d;
-                if (o) o[count] = offset;
+                if (o) o[count] = _layout_entry_ptr(d)->offset;
             }
-            offset += pad.size;
             ++count;
         }
         d = crefl_decl_next(d);
     }
     if (count < limit) {
         if (r) r[count] = crefl_decl_void(d);
-        if (o) o[count] = _align(offset, max.align);
+        if (o) o[count] = pad.size;
     }
     if (count > 0) ++count;
     if (s) *s = count;
@@ -390,20 +973,43 @@ int crefl_struct_fields_offsets(decl_ref d, decl_ref *r, size_t *o, size_t *s)
 }
 
 size_t crefl_type_align(decl_ref d) { return _type_pad(d).align; }
-size_t crefl_field_align(decl_ref d) { return _field_pad(d).align; }
-size_t crefl_intrinsic_align(decl_ref d) { return _intrinsic_pad(d).align; }
-size_t crefl_pointer_align(decl_ref d) { return _pointer_pad(d).align; }
-size_t crefl_array_align(decl_ref d) { return _array_pad(d).align; }
-size_t crefl_struct_align(decl_ref d) { return _struct_pad(d).align; }
-size_t crefl_union_align(decl_ref d) { return _union_pad(d).align; }
+size_t crefl_field_align(decl_ref d) { return _tag_pad(d, _decl_field).align; }
+size_t crefl_intrinsic_align(decl_ref d) { return _tag_pad(d, _decl_intrinsic).align; }
+size_t crefl_pointer_align(decl_ref d) { return _tag_pad(d, _decl_pointer).align; }
+size_t crefl_array_align(decl_ref d) { return _tag_pad(d, _decl_array).align; }
+size_t crefl_struct_align(decl_ref d) { return _tag_pad(d, _decl_struct).align; }
+size_t crefl_union_align(decl_ref d) { return _tag_pad(d, _decl_union).align; }
 
 size_t crefl_type_width(decl_ref d) { return _type_pad(d).size; }
-size_t crefl_field_width(decl_ref d) { return _field_pad(d).size; }
-size_t crefl_intrinsic_width(decl_ref d) { return _intrinsic_pad(d).size; }
-size_t crefl_pointer_width(decl_ref d) { return _pointer_pad(d).size; }
-size_t crefl_array_width(decl_ref d) { return _array_pad(d).size; }
-size_t crefl_struct_width(decl_ref d) { return _struct_pad(d).size; }
-size_t crefl_union_width(decl_ref d) { return _union_pad(d).size; }
+size_t crefl_field_width(decl_ref d) { return _tag_pad(d, _decl_field).size; }
+size_t crefl_intrinsic_width(decl_ref d) { return _tag_pad(d, _decl_intrinsic).size; }
+size_t crefl_pointer_width(decl_ref d) { return _tag_pad(d, _decl_pointer).size; }
+size_t crefl_array_width(decl_ref d) { return _tag_pad(d, _decl_array).size; }
+size_t crefl_struct_width(decl_ref d) { return _tag_pad(d, _decl_struct).size; }
+size_t crefl_union_width(decl_ref d) { return _tag_pad(d, _decl_union).size; }
+
+/*
+ * freeze
+ *
+ * builds every derived table that queries would build on demand. the
+ * layout of every node is computed so that layout queries only read the
+ * memoized entries, which includes the field offsets of every struct.
+ */
+
+int crefl_db_freeze(decl_db *db)
+{
+    if (db->frozen) return 0;
+
+    crefl_name_index_build(db);
+    _child_index(db);
+    if (db->column_mode) _columns(db);
+    for (size_t i = 0; i < db->decl_offset; i++) {
+        _type_pad(crefl_lookup(db, i));
+    }
+    db->frozen = 1;
+
+    return 0;
+}
 
 size_t crefl_array_count(decl_ref d)
 {
@@ -443,61 +1049,120 @@ decl_ref crefl_param_type(decl_ref d)
 int crefl_enum_constants(decl_ref d, decl_ref *r, size_t *s)
 {
     if (!crefl_is_enum(d)) return -1;
-    return _decl_array_fetch(d.db, r, s, crefl_decl_link(d), crefl_is_constant);
+    return _decl_array_fetch(d, r, s, crefl_is_constant);
 }
 
 int crefl_set_constants(decl_ref d, decl_ref *r, size_t *s)
 {
     if (!crefl_is_set(d)) return -1;
-    return _decl_array_fetch(d.db, r, s, crefl_decl_link(d), crefl_is_constant);
+    return _decl_array_fetch(d, r, s, crefl_is_constant);
 }
 
 int crefl_struct_fields(decl_ref d, decl_ref *r, size_t *s)
 {
     if (!crefl_is_struct(d)) return -1;
-    return _decl_array_fetch(d.db, r, s, crefl_decl_link(d), crefl_is_field);
+    return _decl_array_fetch(d, r, s, crefl_is_field);
 }
 
 int crefl_union_fields(decl_ref d, decl_ref *r, size_t *s)
 {
     if (!crefl_is_union(d)) return -1;
-    return _decl_array_fetch(d.db, r, s, crefl_decl_link(d), crefl_is_field);
+    return _decl_array_fetch(d, r, s, crefl_is_field);
 }
 
 int crefl_function_params(decl_ref d, decl_ref *r, size_t *s)
 {
     if (!crefl_is_function(d)) return -1;
-    return _decl_array_fetch(d.db, r, s, crefl_decl_link(d), crefl_is_param);
+    return _decl_array_fetch(d, r, s, crefl_is_param);
 }
 
 int crefl_source_decls(decl_ref d, decl_ref *r, size_t *s)
 {
     if (!crefl_is_source(d)) return -1;
-    return _decl_array_fetch(d.db, r, s, crefl_decl_link(d), crefl_is_any);
+    return _decl_array_fetch(d, r, s, crefl_is_any);
 }
 
 int crefl_source_types(decl_ref d, decl_ref *r, size_t *s)
 {
     if (!crefl_is_source(d)) return -1;
-    return _decl_array_fetch(d.db, r, s, crefl_decl_link(d), crefl_is_type);
+    return _decl_array_fetch(d, r, s, crefl_is_type);
 }
 
 int crefl_source_fields(decl_ref d, decl_ref *r, size_t *s)
 {
     if (!crefl_is_source(d)) return -1;
-    return _decl_array_fetch(d.db, r, s, crefl_decl_link(d), crefl_is_field);
+    return _decl_array_fetch(d, r, s, crefl_is_field);
 }
 
 int crefl_source_functions(decl_ref d, decl_ref *r, size_t *s)
 {
     if (!crefl_is_source(d)) return -1;
-    return _decl_array_fetch(d.db, r, s, crefl_decl_link(d), crefl_is_function);
+    return _decl_array_fetch(d, r, s, crefl_is_function);
 }
 
 int crefl_archive_sources(decl_ref d, decl_ref *r, size_t *s)
 {
     if (!crefl_is_archive(d)) return -1;
-    return _decl_array_fetch(d.db, r, s, crefl_decl_link(d), crefl_is_source);
+    return _decl_array_fetch(d, r, s, crefl_is_source);
+}
+
+/*
+ * all nodes with the given tag, in id order
+ */
+int crefl_db_tag_decls(decl_db *db, decl_tag tag, decl_ref *r, size_t *s)
+{
+    size_t count = 0, limit = s ? *s : 0;
+    if (db->column_mode && tag < _column_tag_max) {
+        _columns_scan(_columns(db)->tag, 1, db->decl_offset, (u8)tag,
+            [&](size_t i) {
+                if (r && count < limit) r[count] = decl_ref { db, i };
+                count++;
+                return true;
+            });
+    } else {
+        for (size_t i = 1; i < db->decl_offset; i++) {
+            if (db->decl[i]._tag != tag) continue;
+            if (r && count < limit) r[count] = decl_ref { db, i };
+            count++;
+        }
+    }
+    if (s) *s = count;
+    return 0;
+}
+
+const decl_id * crefl_enum_constants_span(decl_ref d, size_t *s)
+{
+    return _decl_span(d, _decl_enum, s);
+}
+
+const decl_id * crefl_set_constants_span(decl_ref d, size_t *s)
+{
+    return _decl_span(d, _decl_set, s);
+}
+
+const decl_id * crefl_struct_fields_span(decl_ref d, size_t *s)
+{
+    return _decl_span(d, _decl_struct, s);
+}
+
+const decl_id * crefl_union_fields_span(decl_ref d, size_t *s)
+{
+    return _decl_span(d, _decl_union, s);
+}
+
+const decl_id * crefl_function_params_span(decl_ref d, size_t *s)
+{
+    return _decl_span(d, _decl_function, s);
+}
+
+const decl_id * crefl_source_decls_span(decl_ref d, size_t *s)
+{
+    return _decl_span(d, _decl_source, s);
+}
+
+const decl_id * crefl_archive_sources_span(decl_ref d, size_t *s)
+{
+    return _decl_span(d, _decl_archive, s);
 }
 
 decl_raw crefl_constant_value(decl_ref d)
@@ -1089,17 +1089,16 @@ static const struct asn1_oid_record {
 
 const char* crefl_asn1_oid_desc(const char *oid, size_t len)
 {
-	static std::map<std::string,std::string> map;
-
-	/* this initializer is not thread-safe */
-
-	if (map.size() == 0) {
+	/* built once by the first caller, static initialization is thread-safe */
+	static const std::map<std::string,std::string> map = [] {
+		std::map<std::string,std::string> m;
 		auto o = oid_map;
 		while (o->name) {
-			map[std::string((const char*)o->oid,o->len)] = o->name;
+			m[std::string((const char*)o->oid,o->len)] = o->name;
 			o++;
 		}
-	}
+		return m;
+	}();
 
 	auto it = map.find(std::string(oid,len));
 	if (it != map.end()) return it->second.c_str();
@@ -34,6 +34,7 @@
 #include <crefl/model.h>
 #include <crefl/dump.h>
 #include <crefl/db.h>
+#include <crefl/link.h>
 
 using namespace clang;
 
@@ -41,9 +42,9 @@ class ReflectAction : public PluginASTAction
 {
 public:
     std::string outputFile;
-    bool debug, dump;
+    bool debug, dump, hashes;
 
-    ReflectAction() : outputFile(), debug(false), dump(false) {}
+    ReflectAction() : outputFile(), debug(false), dump(false), hashes(false) {}
 
     std::unique_ptr<ASTConsumer> CreateASTConsumer
         (CompilerInstance &ci, llvm::StringRef) override {
@@ -699,6 +700,8 @@ bool ReflectAction::ParseArgs(const CompilerInstance &ci,
             ++i; debug = true;
         } else if (argv[i] == "-dump") {
             ++i; dump = true;
+        } else if (argv[i] == "-hashes") {
+            ++i; hashes = true;
         } else {
             fprintf(stderr, "error: unknown option: %s\n", argv[i].c_str());
             exit(0);
@@ -732,6 +735,7 @@ void ReflectAction::EndSourceFileAction()
         crefl_db_dump(db);
     }
     if (outputFile.size()) {
+        if (hashes) crefl_db_link_hashes(db);
         crefl_db_write_file(db, outputFile.c_str());
     }
     crefl_db_destroy(db);
@@ -0,0 +1,768 @@
+#undef NDEBUG
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <vector>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+#include <crefl/link.h>
+#include <crefl/handle.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <synchapi.h>
+#else
+#include <time.h>
+#endif
+
+using namespace std::chrono;
+
+typedef signed long long llong;
+typedef unsigned long long ullong;
+
+#define array_size(arr) ((sizeof(arr)/sizeof(arr[0])))
+
+static void _millisleep(llong sleep_ms)
+{
+#ifdef _WIN32
+    HANDLE hTimer;
+    LARGE_INTEGER liDueTime;
+    liDueTime.QuadPart = -10000LL * sleep_ms;
+    assert((hTimer = CreateWaitableTimer(NULL, TRUE, NULL)));
+    assert(SetWaitableTimer(hTimer, &liDueTime, 0, NULL, NULL, 0));
+    assert(WaitForSingleObject(hTimer, INFINITE) == WAIT_OBJECT_0);
+    CloseHandle(hTimer);
+#else
+    struct timespec ts = {
+        (time_t)(sleep_ms / 1000),
+        (long)((sleep_ms * 1000000ll) % 1000000000ll)
+    };
+    nanosleep(&ts, nullptr);
+#endif
+}
+
+struct bench_result { const char *name; llong count; double t; llong size; };
+
+/*
+ * synthetic database
+ *
+ * a source containing structs with a mix of intrinsic, array and nested
+ * struct fields, similar in shape to the output of the clang plugin.
+ */
+
+static const size_t synth_structs = 10000;
+static const size_t synth_fields = 8;
+
+static decl_db *synth_db;
+
+static decl_ref _synth_field(decl_db *db, size_t i, size_t j, decl_ref prev)
+{
+    static const struct { decl_set props; size_t width; } types[] = {
+        { _decl_sint, 32 }, { _decl_uint, 8 }, { _decl_float, 64 },
+        { _decl_sint, 16 }, { _decl_uint, 64 }, { _decl_float, 32 },
+    };
+    char name[32];
+    decl_ref f = crefl_decl_new(db, _decl_field);
+    snprintf(name, sizeof(name), "f%zu", j);
+    crefl_decl_ptr(f)->_name = crefl_name_new(db, name);
+    if (j == synth_fields - 1 && crefl_decl_idx(prev) > synth_fields) {
+        /* link the last field to the previous struct by value */
+        crefl_decl_ptr(f)->_link = crefl_decl_idx(prev);
+    } else {
+        size_t k = (i + j) % array_size(types);
+        crefl_decl_ptr(f)->_link = crefl_decl_idx(
+            crefl_intrinsic(db, types[k].props, types[k].width));
+    }
+    return f;
+}
+
+static decl_db * _synth_new(size_t nstructs)
+{
+    char name[32];
+    decl_db *db = crefl_db_new();
+    crefl_db_defaults(db);
+
+    decl_ref src = crefl_decl_new(db, _decl_source);
+    crefl_decl_ptr(src)->_name = crefl_name_new(db, "synth.h");
+    db->root_element = crefl_decl_idx(src);
+
+    decl_ref last = { db, 0 };
+    for (size_t i = 0; i < nstructs; i++) {
+        decl_ref s = crefl_decl_new(db, _decl_struct);
+        snprintf(name, sizeof(name), "s%zu", i);
+        crefl_decl_ptr(s)->_name = crefl_name_new(db, name);
+        if (crefl_decl_idx(last)) crefl_decl_ptr(last)->_next = crefl_decl_idx(s);
+        else crefl_decl_ptr(src)->_link = crefl_decl_idx(s);
+        decl_ref f = { db, 0 };
+        for (size_t j = 0; j < synth_fields; j++) {
+            decl_ref g = _synth_field(db, i, j, last);
+            if (crefl_decl_idx(f)) crefl_decl_ptr(f)->_next = crefl_decl_idx(g);
+            else crefl_decl_ptr(s)->_link = crefl_decl_idx(g);
+            f = g;
+        }
+        last = s;
+    }
+
+    return db;
+}
+
+static decl_db * _synth()
+{
+    if (!synth_db) synth_db = _synth_new(synth_structs);
+    return synth_db;
+}
+
+/*
+ * intrinsic lookup
+ */
+
+static const struct { decl_set props; size_t width; } intrinsic_queries[] = {
+    { _decl_sint, 32 }, { _decl_uint, 8 }, { _decl_float, 64 },
+    { _decl_void, 64 }, { _decl_sint, 1 }, { _decl_cfloat, 128 },
+};
+
+static decl_ref _intrinsic_scan(decl_db *db, decl_set props, size_t width)
+{
+    for (size_t i = 0; i < db->decl_offset; i++) {
+        decl_ref d = crefl_lookup(db, i);
+        if (crefl_is_intrinsic(d) &&
+            crefl_decl_qty(d) == width &&
+                ((crefl_decl_props(d) & props) == props)) {
+            return decl_ref { db, i };
+        }
+    }
+    return decl_ref { db, 0 };
+}
+
+static bench_result bench_intrinsic_scan(llong count)
+{
+    decl_db *db = _synth();
+    size_t n = array_size(intrinsic_queries), sum = 0;
+
+    auto st = high_resolution_clock::now();
+    for (llong i = 0; i < count; i++) {
+        sum += crefl_decl_idx(_intrinsic_scan(db,
+            intrinsic_queries[i % n].props, intrinsic_queries[i % n].width));
+    }
+    auto et = high_resolution_clock::now();
+
+    assert(sum > 0);
+
+    double t = (double)duration_cast<nanoseconds>(et - st).count();
+    return bench_result { "intrinsic-lookup-scan", count, t, 0 };
+}
+
+static bench_result bench_intrinsic_map(llong count)
+{
+    decl_db *db = _synth();
+    size_t n = array_size(intrinsic_queries), sum = 0;
+
+    auto st = high_resolution_clock::now();
+    for (llong i = 0; i < count; i++) {
+        sum += crefl_decl_idx(crefl_intrinsic(db,
+            intrinsic_queries[i % n].props, intrinsic_queries[i % n].width));
+    }
+    auto et = high_resolution_clock::now();
+
+    assert(sum > 0);
+
+    double t = (double)duration_cast<nanoseconds>(et - st).count();
+    return bench_result { "intrinsic-lookup-map", count, t, 0 };
+}
+
+/*
+ * load checks
+ *
+ * loads an image of a synthetic db with about one million nodes using
+ * each check policy. attach avoids the copy so that the time measures
+ * the check. count is in nodes and is rounded to whole loads.
+ */
+
+static const size_t load_structs = 111111;
+
+static std::vector<u64> load_image[2];
+static size_t load_size[2];
+
+static const uint8_t * _load_image(bool packed)
+{
+    if (load_size[packed] == 0) {
+        decl_db *db = _synth_new(load_structs);
+        crefl_db_set_packed(db, packed);
+        load_size[packed] = crefl_db_size(db);
+        load_image[packed].resize((load_size[packed] + 7) / 8);
+        assert(crefl_db_write_mem(db, (uint8_t*)load_image[packed].data(),
+            load_size[packed]) == 0);
+        crefl_db_destroy(db);
+    }
+    return (const uint8_t*)load_image[packed].data();
+}
+
+static bench_result _bench_load(const char *name, llong count,
+    enum crefl_db_check check, bool attach, bool packed = false)
+{
+    const uint8_t *buf = _load_image(packed);
+    size_t load_sz = load_size[packed];
+    const decl_db_hdr *hdr = (const decl_db_hdr*)buf;
+    llong nodes = hdr->decl_entry_count;
+    llong loads = count / nodes > 0 ? count / nodes : 1;
+
+    crefl_db_set_check(check);
+    auto st = high_resolution_clock::now();
+    for (llong i = 0; i < loads; i++) {
+        decl_db *db;
+        if (attach) {
+            db = crefl_db_attach_mem(buf, load_sz);
+        } else {
+            db = crefl_db_new();
+            assert(crefl_db_read_mem(db, buf, load_sz) == 0);
+        }
+        assert(db && db->decl_offset == (size_t)nodes);
+        crefl_db_destroy(db);
+    }
+    auto et = high_resolution_clock::now();
+    crefl_db_set_check(crefl_db_check_full);
+
+    double t = (double)duration_cast<nanoseconds>(et - st).count();
+    return bench_result { name, loads * nodes, t, loads * (llong)load_sz };
+}
+
+static bench_result bench_load_copy_full(llong count)
+{
+    return _bench_load("load-copy-full", count, crefl_db_check_full, false);
+}
+
+static bench_result bench_load_copy_packed(llong count)
+{
+    return _bench_load("load-copy-packed", count, crefl_db_check_full, false, true);
+}
+
+static bench_result bench_load_attach_full(llong count)
+{
+    return _bench_load("load-attach-full", count, crefl_db_check_full, true);
+}
+
+static bench_result bench_load_attach_vector(llong count)
+{
+    return _bench_load("load-attach-vector", count, crefl_db_check_vector, true);
+}
+
+static bench_result bench_load_attach_defer(llong count)
+{
+    return _bench_load("load-attach-defer", count, crefl_db_check_defer, true);
+}
+
+static bench_result bench_load_attach_trusted(llong count)
+{
+    return _bench_load("load-attach-trusted", count, crefl_db_check_trusted, true);
+}
+
+/*
+ * traversal
+ *
+ * walks the fields and field types of every struct in a synthetic db of
+ * about one million nodes whose nodes are numbered in a scattered order,
+ * as clang visitation numbers nodes, before and after renumbering it with
+ * crefl_link_optimize_layout. the fields of a struct and their array
+ * types are created in separate passes over a permutation of the structs
+ * so that adjacent nodes of a walk are far apart. count is in nodes and
+ * is rounded to whole walks.
+ */
+
+static const size_t walk_structs = 111111;
+static const size_t walk_prime = 7919;
+
+static decl_db *walk_db[2];
+
+static decl_db * _walk_new()
+{
+    char name[32];
+    decl_db *db = crefl_db_new();
+    crefl_db_defaults(db);
+
+    decl_ref src = crefl_decl_new(db, _decl_source);
+    crefl_decl_ptr(src)->_name = crefl_name_new(db, "walk.h");
+    db->root_element = crefl_decl_idx(src);
+
+    std::vector<decl_id> st(walk_structs), last(walk_structs);
+    for (size_t i = 0; i < walk_structs; i++) {
+        decl_ref s = crefl_decl_new(db, _decl_struct);
+        snprintf(name, sizeof(name), "s%zu", i);
+        crefl_decl_ptr(s)->_name = crefl_name_new(db, name);
+        if (i) crefl_decl_ptr(crefl_lookup(db, st[i - 1]))->_next = crefl_decl_idx(s);
+        else crefl_decl_ptr(src)->_link = crefl_decl_idx(s);
+        st[i] = last[i] = crefl_decl_idx(s);
+    }
+    for (size_t j = 0; j < synth_fields; j++) {
+        for (size_t k = 0; k < walk_structs; k++) {
+            size_t i = k * walk_prime % walk_structs;
+            decl_ref f = crefl_decl_new(db, _decl_field);
+            snprintf(name, sizeof(name), "f%zu", j);
+            crefl_decl_ptr(f)->_name = crefl_name_new(db, name);
+            crefl_decl_ptr(f)->_link = crefl_decl_idx(
+                crefl_intrinsic(db, _decl_sint, 8 << (j & 3)));
+            if (j) crefl_decl_ptr(crefl_lookup(db, last[i]))->_next = crefl_decl_idx(f);
+            else crefl_decl_ptr(crefl_lookup(db, st[i]))->_link = crefl_decl_idx(f);
+            last[i] = crefl_decl_idx(f);
+        }
+    }
+    /* the last field of each struct is an array */
+    for (size_t k = 0; k < walk_structs; k++) {
+        size_t i = (walk_structs - 1 - k) * walk_prime % walk_structs;
+        decl_ref a = crefl_decl_new(db, _decl_array);
+        crefl_decl_ptr(a)->_link = crefl_decl_ptr(crefl_lookup(db, last[i]))->_link;
+        crefl_decl_ptr(a)->_count = 4;
+        crefl_decl_ptr(crefl_lookup(db, last[i]))->_link = crefl_decl_idx(a);
+    }
+
+    return db;
+}
+
+static decl_db * _walk(bool layout)
+{
+    if (!walk_db[layout]) {
+        walk_db[layout] = _walk_new();
+        if (layout) assert(crefl_link_optimize_layout(walk_db[layout]) == 0);
+    }
+    return walk_db[layout];
+}
+
+static size_t _walk_fields(decl_db *db, size_t *nodes)
+{
+    size_t sum = 0, n = 0;
+    decl_ref r = crefl_root(db);
+    for (decl_ref s = crefl_decl_link(r); crefl_decl_idx(s); s = crefl_decl_next(s)) {
+        sum += crefl_decl_name(s)[0];
+        n++;
+        for (decl_ref f = crefl_decl_link(s); crefl_decl_idx(f); f = crefl_decl_next(f)) {
+            decl_ref t = crefl_field_type(f);
+            if (crefl_is_array(t)) {
+                sum += crefl_decl_qty(t);
+                t = crefl_array_type(t);
+                n++;
+            }
+            sum += crefl_decl_name(f)[0] + crefl_decl_qty(t);
+            n++;
+        }
+    }
+    *nodes = n;
+    return sum;
+}
+
+static bench_result _bench_walk(const char *name, llong count, bool layout)
+{
+    decl_db *db = _walk(layout);
+    size_t nodes, sum = 0;
+    _walk_fields(db, &nodes);
+    llong walks = count / (llong)nodes > 0 ? count / (llong)nodes : 1;
+
+    auto st = high_resolution_clock::now();
+    for (llong i = 0; i < walks; i++) {
+        sum += _walk_fields(db, &nodes);
+    }
+    auto et = high_resolution_clock::now();
+
+    assert(sum > 0);
+
+    double t = (double)duration_cast<nanoseconds>(et - st).count();
+    return bench_result { name, walks * (llong)nodes, t, 0 };
+}
+
+static bench_result bench_walk_scattered(llong count)
+{
+    return _bench_walk("walk-fields-scattered", count, false);
+}
+
+static bench_result bench_walk_layout(llong count)
+{
+    return _bench_walk("walk-fields-layout", count, true);
+}
+
+/*
+ * tag queries
+ *
+ * finds the structs, then the fields, of a synthetic db with about one
+ * million nodes with crefl_db_tag_decls, reading whole nodes and then
+ * the tag column in column mode. count is in nodes scanned and is
+ * rounded to whole queries.
+ */
+
+static decl_db *tag_db;
+
+static bench_result _bench_tag(const char *name, llong count, int columns)
+{
+    if (!tag_db) tag_db = _synth_new(load_structs);
+    decl_db *db = tag_db;
+    static const decl_tag tags[] = { _decl_struct, _decl_field };
+    llong nodes = (llong)db->decl_offset;
+    llong queries = count / nodes > 0 ? count / nodes : 1;
+    std::vector<decl_ref> r(db->decl_offset);
+    size_t sum = 0;
+
+    crefl_db_set_columns(db, columns);
+    size_t s = r.size();
+    crefl_db_tag_decls(db, _decl_struct, r.data(), &s);
+    assert(s == load_structs);
+
+    auto st = high_resolution_clock::now();
+    for (llong i = 0; i < queries; i++) {
+        s = r.size();
+        crefl_db_tag_decls(db, tags[i & 1], r.data(), &s);
+        sum += s;
+    }
+    auto et = high_resolution_clock::now();
+    crefl_db_set_columns(db, 0);
+
+    assert(sum > 0);
+
+    double t = (double)duration_cast<nanoseconds>(et - st).count();
+    return bench_result { name, queries * nodes, t, 0 };
+}
+
+static bench_result bench_tag_nodes(llong count)
+{
+    return _bench_tag("tag-decls-nodes", count, 0);
+}
+
+static bench_result bench_tag_columns(llong count)
+{
+    return _bench_tag("tag-decls-columns", count, 1);
+}
+
+/*
+ * open
+ *
+ * creates a db with the builtin types, and attaches a small image with
+ * one struct, as done for each plugin or shared library loaded by a
+ * process. count is in opens.
+ */
+
+static std::vector<u64> small_image;
+static size_t small_size;
+
+static const uint8_t * _small_image()
+{
+    if (small_size == 0) {
+        decl_db *db = _synth_new(1);
+        small_size = crefl_db_size(db);
+        small_image.resize((small_size + 7) / 8);
+        assert(crefl_db_write_mem(db, (uint8_t*)small_image.data(),
+            small_size) == 0);
+        crefl_db_destroy(db);
+    }
+    return (const uint8_t*)small_image.data();
+}
+
+static bench_result bench_open_defaults(llong count)
+{
+    size_t sum = 0;
+
+    auto st = high_resolution_clock::now();
+    for (llong i = 0; i < count; i++) {
+        decl_db *db = crefl_db_new();
+        crefl_db_defaults(db);
+        sum += db->decl_offset;
+        crefl_db_destroy(db);
+    }
+    auto et = high_resolution_clock::now();
+
+    assert(sum > 0);
+
+    double t = (double)duration_cast<nanoseconds>(et - st).count();
+    return bench_result { "open-defaults", count, t, 0 };
+}
+
+static bench_result bench_open_attach(llong count)
+{
+    const uint8_t *buf = _small_image();
+    size_t sum = 0;
+
+    crefl_db_set_check(crefl_db_check_defer);
+    auto st = high_resolution_clock::now();
+    for (llong i = 0; i < count; i++) {
+        decl_db *db = crefl_db_attach_mem(buf, small_size);
+        sum += db->decl_offset;
+        crefl_db_destroy(db);
+    }
+    auto et = high_resolution_clock::now();
+    crefl_db_set_check(crefl_db_check_full);
+
+    assert(sum > 0);
+
+    double t = (double)duration_cast<nanoseconds>(et - st).count();
+    return bench_result { "open-attach", count, t, count * (llong)small_size };
+}
+
+/*
+ * cold lookup
+ *
+ * attaches an image of a synthetic db with about one million nodes and
+ * looks up one fqn, as done by a process that loads metadata to find a
+ * few types. without a lookup index the first lookup builds the name
+ * index. count is in opens.
+ */
+
+static std::vector<u64> cold_image[2];
+static size_t cold_size[2];
+
+static const uint8_t * _cold_image(bool indexed)
+{
+    if (cold_size[indexed] == 0) {
+        decl_db *db = _synth_new(load_structs);
+        crefl_db_set_index(db, indexed);
+        cold_size[indexed] = crefl_db_size(db);
+        cold_image[indexed].resize((cold_size[indexed] + 7) / 8);
+        assert(crefl_db_write_mem(db, (uint8_t*)cold_image[indexed].data(),
+            cold_size[indexed]) == 0);
+        crefl_db_destroy(db);
+    }
+    return (const uint8_t*)cold_image[indexed].data();
+}
+
+static bench_result _bench_cold(const char *name, llong count, bool indexed)
+{
+    const uint8_t *buf = _cold_image(indexed);
+    size_t sum = 0;
+    char fqn[32];
+
+    crefl_db_set_check(crefl_db_check_defer);
+    auto st = high_resolution_clock::now();
+    for (llong i = 0; i < count; i++) {
+        decl_db *db = crefl_db_attach_mem(buf, cold_size[indexed]);
+        snprintf(fqn, sizeof(fqn), "s%llu::f1", i % load_structs);
+        sum += crefl_decl_idx(crefl_lookup_by_fqn(db, fqn)) != 0;
+        crefl_db_destroy(db);
+    }
+    auto et = high_resolution_clock::now();
+    crefl_db_set_check(crefl_db_check_full);
+
+    assert(sum == (size_t)count);
+
+    double t = (double)duration_cast<nanoseconds>(et - st).count();
+    return bench_result { name, count, t, 0 };
+}
+
+static bench_result bench_cold_lookup_scan(llong count)
+{
+    return _bench_cold("cold-lookup-name-index", count, false);
+}
+
+static bench_result bench_cold_lookup_index(llong count)
+{
+    return _bench_cold("cold-lookup-image-index", count, true);
+}
+
+/*
+ * handle pin
+ *
+ * pins the current snapshot of a handle holding the small image, looks
+ * up one fqn and unpins it, as done by each query of a service that
+ * reloads metadata. count is in pins.
+ */
+
+static bench_result bench_handle_pin(llong count)
+{
+    const uint8_t *buf = _small_image();
+    decl_db_handle *h = crefl_handle_new(crefl_db_attach_mem(buf, small_size));
+    size_t sum = 0;
+
+    auto st = high_resolution_clock::now();
+    for (llong i = 0; i < count; i++) {
+        decl_db_snapshot *s = crefl_handle_pin(h);
+        sum += crefl_decl_idx(crefl_lookup_by_fqn(crefl_snapshot_db(s), "s0"));
+        crefl_snapshot_unpin(s);
+    }
+    auto et = high_resolution_clock::now();
+    crefl_handle_destroy(h);
+
+    assert(sum > 0);
+
+    double t = (double)duration_cast<nanoseconds>(et - st).count();
+    return bench_result { "handle-pin-lookup", count, t, 0 };
+}
+
+static const char* format_unit(llong count)
+{
+    static char buf[32];
+    if (count % 1000000000 == 0) {
+        snprintf(buf, sizeof(buf), "%lluG", count / 1000000000);
+    } else if (count % 1000000 == 0) {
+        snprintf(buf, sizeof(buf), "%lluM", count / 1000000);
+    } else if (count % 1000 == 0) {
+        snprintf(buf, sizeof(buf), "%lluK", count / 1000);
+    } else {
+        snprintf(buf, sizeof(buf), "%llu", count);
+    }
+    return buf;
+}
+
+static const char* format_comma(llong count)
+{
+    static char buf[32];
+    char buf1[32];
+
+    snprintf(buf1, sizeof(buf1), "%llu", count);
+
+    llong l = strlen(buf1), i = 0, j = 0;
+    for (; i < l; i++, j++) {
+        buf[j] = buf1[i];
+        if ((l-i-1) % 3 == 0 && i != l -1) {
+            buf[++j] = ',';
+        }
+    }
+    buf[j] = '\0';
+
+    return buf;
+}
+
+static bench_result(* const benchmarks[])(llong) = {
+    bench_intrinsic_scan,
+    bench_intrinsic_map,
+    bench_load_copy_full,
+    bench_load_attach_full,
+    bench_load_attach_vector,
+    bench_load_attach_defer,
+    bench_load_attach_trusted,
+    bench_walk_scattered,
+    bench_walk_layout,
+    bench_tag_nodes,
+    bench_tag_columns,
+    bench_load_copy_packed,
+    bench_open_defaults,
+    bench_open_attach,
+    bench_cold_lookup_scan,
+    bench_cold_lookup_index,
+    bench_handle_pin,
+};
+
+static void print_header(const char *prefix)
+{
+    printf("%s%-24s %7s %7s %7s %13s %9s\n",
+        prefix,
+        "benchmark",
+        "count",
+        "time(s)",
+        "op(ns)",
+        "ops/s",
+        "MiB/s"
+    );
+}
+
+static void print_rules(const char *prefix)
+{
+    printf("%s%-24s %7s %7s %7s %13s %9s\n",
+        prefix,
+        "------------------------",
+        "-------",
+        "-------",
+        "-------",
+        "-------------",
+        "---------"
+    );
+}
+
+static void print_result(const char *prefix, const char *name,
+    llong count, double t, llong size)
+{
+    printf("%s%-24s %7s %7.2f %7.2f %13s %9.3f\n",
+        prefix,
+        name,
+        format_unit(count),
+        t / 1e9,
+        t / count,
+        format_comma((llong)(count * (1e9 / t))),
+        size * (1e9 / t) / (1024*1024)
+    );
+}
+
+static void run_benchmark(size_t n, llong repeat, llong count, llong pause_ms)
+{
+    double min_t = 0., max_t = 0., sum_t = 0.;
+    const char* name = "";
+    size_t size;
+    llong n_ops = count;
+    if (repeat > 0) {
+        char num[32];
+        snprintf(num, sizeof(num), "  [%2zu] ", n);
+        print_header(num);
+        print_rules("       ");
+    }
+    for (llong i = 0; i < llabs(repeat); i++) {
+        bench_result r = benchmarks[n](count);
+        name = r.name;
+        size = r.size;
+        n_ops = r.count;
+        if (min_t == 0. || r.t < min_t) min_t = r.t;
+        if (max_t == 0. || r.t > max_t) max_t = r.t;
+        sum_t += r.t;
+        if (repeat > 0) {
+            char run[32];
+            snprintf(run, sizeof(run), "%3llu/%-3llu", i+1, repeat);
+            print_result(run, name, n_ops, r.t, size);
+        }
+    }
+    if (repeat > 0) {
+        print_rules("       ");
+        print_result("worst: ", name, n_ops, max_t, size);
+        print_result("  avg: ", name, n_ops, sum_t / repeat, size);
+        print_result(" best: ", name, n_ops, min_t, size);
+        puts("");
+    } else if (llabs(repeat) >= 1) {
+        char num[32];
+        snprintf(num, sizeof(num), "[%2zu] ", n);
+        print_result(num, name, n_ops, min_t, size);
+    }
+}
+
+#if defined(_WIN32)
+# define strtok_r strtok_s
+#endif
+
+int main(int argc, char **argv)
+{
+    llong bench_num = -1, repeat = 1, count = 10000, pause_ms = 0;
+    if (argc != 5) {
+        fprintf(stderr, "usage: %s [bench_num(,…)] [repeat] [count] [pause_ms]\n", argv[0]);
+        fprintf(stderr, "\ne.g.   %s -1 -10 10000 1000\n", argv[0]);
+        exit(0);
+    }
+    if (argc > 1) {
+        bench_num = atoll(argv[1]);
+    }
+    if (argc > 2) {
+        repeat = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        count = atoll(argv[3]);
+    }
+    if (argc > 4) {
+        pause_ms = atoll(argv[4]);
+    }
+    if (repeat < 0) {
+        print_header("     ");
+        print_rules("     ");
+    }
+    if (bench_num == -1) {
+        for (llong n = 0; n < (llong)array_size(benchmarks); n++) {
+            if (pause_ms > 0 && n > 0) _millisleep(pause_ms);
+            run_benchmark(n, repeat, count, pause_ms);
+        }
+    } else {
+        char *save, *comp = strtok_r(argv[1], ",", &save);
+        while (comp) {
+            bench_num = atoll(comp);
+            if (bench_num >= 0 && bench_num < (llong)array_size(benchmarks)) {
+                run_benchmark(bench_num, repeat, count, pause_ms);
+            }
+            comp = strtok_r(nullptr, ",", &save);
+        }
+    }
+    if (synth_db) crefl_db_destroy(synth_db);
+    if (tag_db) crefl_db_destroy(tag_db);
+    for (size_t i = 0; i < 2; i++) {
+        if (walk_db[i]) crefl_db_destroy(walk_db[i]);
+    }
+}
@@ -0,0 +1,557 @@
+#undef NDEBUG
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+
+#include <crefl/model.h>
+#include <crefl/link.h>
+#include <crefl/hashmap.h>
+#include <crefl/swissmap.h>
+#include <crefl/shardmap.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <synchapi.h>
+#else
+#include <time.h>
+#endif
+
+using namespace std::chrono;
+
+typedef signed long long llong;
+typedef unsigned long long ullong;
+
+#define array_size(arr) ((sizeof(arr)/sizeof(arr[0])))
+
+static void _millisleep(llong sleep_ms)
+{
+#ifdef _WIN32
+    HANDLE hTimer;
+    LARGE_INTEGER liDueTime;
+    liDueTime.QuadPart = -10000LL * sleep_ms;
+    assert((hTimer = CreateWaitableTimer(NULL, TRUE, NULL)));
+    assert(SetWaitableTimer(hTimer, &liDueTime, 0, NULL, NULL, 0));
+    assert(WaitForSingleObject(hTimer, INFINITE) == WAIT_OBJECT_0);
+    CloseHandle(hTimer);
+#else
+    struct timespec ts = {
+        (time_t)(sleep_ms / 1000),
+        (long)((sleep_ms * 1000000ll) % 1000000000ll)
+    };
+    nanosleep(&ts, nullptr);
+#endif
+}
+
+struct bench_result { const char *name; llong count; double t; llong size; };
+
+/*
+ * keys
+ *
+ * decl_hash keys are 28-byte sums as used by crefl_link_merge, hashed
+ * by their first word. u64 keys use std::hash, which is the identity.
+ * count is the number of entries. lookups of missing keys use keys
+ * from a second sequence.
+ */
+
+struct _hash_fn
+{
+    size_t operator()(const decl_hash &h) const { return ((size_t*)h.sum)[0]; }
+};
+
+bool operator==(const decl_hash &a, const decl_hash &b)
+{
+    return memcmp(a.sum, b.sum, sizeof(a.sum)) == 0;
+}
+
+static u64 _splitmix(u64 &s)
+{
+    u64 z = (s += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static std::vector<decl_hash> _hash_keys(llong count, u64 seed)
+{
+    std::vector<decl_hash> keys(count);
+    for (auto &k : keys) {
+        for (size_t i = 0; i < sizeof(k.sum); i += 4) {
+            u32 w = (u32)_splitmix(seed);
+            memcpy(k.sum + i, &w, 4);
+        }
+    }
+    return keys;
+}
+
+static std::vector<u64> _u64_keys(llong count, u64 seed)
+{
+    std::vector<u64> keys(count);
+    for (auto &k : keys) k = _splitmix(seed);
+    return keys;
+}
+
+typedef hashmap<decl_hash,decl_ref,_hash_fn> hash_hashmap;
+typedef swissmap<decl_hash,decl_ref,_hash_fn> hash_swissmap;
+typedef std::unordered_map<decl_hash,decl_ref,_hash_fn> hash_unordered;
+
+typedef hashmap<u64,u64> u64_hashmap;
+typedef swissmap<u64,u64> u64_swissmap;
+typedef std::unordered_map<u64,u64> u64_unordered;
+
+template <typename Map, typename Keys>
+static void _map_insert(Map &map, const Keys &keys)
+{
+    for (size_t i = 0; i < keys.size(); i++) {
+        map.insert({ keys[i], typename Map::mapped_type{} });
+    }
+}
+
+template <typename Map, typename Keys>
+static bench_result _bench_insert(const char *name, const Keys &keys)
+{
+    Map map;
+
+    auto st = high_resolution_clock::now();
+    _map_insert(map, keys);
+    auto et = high_resolution_clock::now();
+
+    assert(map.size() == keys.size());
+
+    double t = (double)duration_cast<nanoseconds>(et - st).count();
+    return bench_result { name, (llong)keys.size(), t, 0 };
+}
+
+template <typename Map, typename Keys>
+static bench_result _bench_find(const char *name, const Keys &keys,
+    const Keys &probes, bool hit)
+{
+    Map map;
+    size_t found = 0;
+
+    _map_insert(map, keys);
+
+    auto st = high_resolution_clock::now();
+    for (size_t i = 0; i < probes.size(); i++) {
+        found += map.find(probes[i]) != map.end();
+    }
+    auto et = high_resolution_clock::now();
+
+    assert(found == (hit ? probes.size() : 0));
+
+    double t = (double)duration_cast<nanoseconds>(et - st).count();
+    return bench_result { name, (llong)probes.size(), t, 0 };
+}
+
+/* lookups probe the keys in a different order to the inserts */
+template <typename Keys>
+static Keys _shuffle(const Keys &keys)
+{
+    Keys out(keys);
+    u64 s = 7;
+    for (size_t i = out.size() - 1; i > 0; i--) {
+        std::swap(out[i], out[_splitmix(s) % (i + 1)]);
+    }
+    return out;
+}
+
+#define BENCH_MAP(id, name, Map, keyfn)                                      \
+static bench_result bench_insert_##id(llong count)                           \
+{                                                                            \
+    return _bench_insert<Map>("insert-" name, keyfn(count, 1));              \
+}                                                                            \
+static bench_result bench_find_##id(llong count)                             \
+{                                                                            \
+    auto keys = keyfn(count, 1);                                             \
+    return _bench_find<Map>("find-" name, keys, _shuffle(keys), true);       \
+}                                                                            \
+static bench_result bench_miss_##id(llong count)                             \
+{                                                                            \
+    return _bench_find<Map>("miss-" name, keyfn(count, 1),                   \
+        keyfn(count, 2), false);                                             \
+}
+
+BENCH_MAP(hash_hashmap, "hash-hashmap", hash_hashmap, _hash_keys)
+BENCH_MAP(hash_swissmap, "hash-swissmap", hash_swissmap, _hash_keys)
+BENCH_MAP(hash_unordered, "hash-unordered", hash_unordered, _hash_keys)
+BENCH_MAP(u64_hashmap, "u64-hashmap", u64_hashmap, _u64_keys)
+BENCH_MAP(u64_swissmap, "u64-swissmap", u64_swissmap, _u64_keys)
+BENCH_MAP(u64_unordered, "u64-unordered", u64_unordered, _u64_keys)
+
+/*
+ * churn
+ *
+ * fills a map with count u64 keys, then erases the oldest key and
+ * inserts a new key count times, as incremental archive updates do.
+ * after the run, the probe lengths of hits and misses of the hashmap
+ * are recorded in a histogram that is printed once at exit.
+ */
+
+static const size_t probe_buckets = 10;
+
+struct probe_histogram
+{
+    const char *name;
+    size_t hit[probe_buckets], miss[probe_buckets];
+    size_t capacity, size;
+};
+
+static probe_histogram churn_histogram;
+
+static size_t _probe_bucket(size_t len)
+{
+    size_t b = 0;
+    while (len > 1 && b < probe_buckets - 1) { len >>= 1; b++; }
+    return b;
+}
+
+/* hits probe up to their slot, misses up to the next available slot */
+static void _probe_lengths(u64_hashmap &map, probe_histogram &hist)
+{
+    memset(hist.hit, 0, sizeof(hist.hit));
+    memset(hist.miss, 0, sizeof(hist.miss));
+    size_t mask = map.index_mask();
+    for (size_t i = 0; i < map.limit; i++) {
+        if (u64_hashmap::bitmap_get(map.bitmap, i) & u64_hashmap::occupied) {
+            size_t home = map.key_index(map.data[i].first);
+            hist.hit[_probe_bucket(((i - home) & mask) + 1)]++;
+        }
+        size_t len = 1;
+        for (size_t j = i; u64_hashmap::bitmap_get(map.bitmap, j) !=
+             u64_hashmap::available; j = (j + 1) & mask) len++;
+        hist.miss[_probe_bucket(len)]++;
+    }
+    hist.capacity = map.capacity();
+    hist.size = map.size();
+}
+
+template <typename Map>
+static bench_result _bench_churn(const char *name, llong count,
+    probe_histogram *hist)
+{
+    Map map;
+    std::vector<u64> keys = _u64_keys(count * 2, 3);
+
+    _map_insert(map, std::vector<u64>(keys.begin(), keys.begin() + count));
+
+    auto st = high_resolution_clock::now();
+    for (llong i = 0; i < count; i++) {
+        map.erase(keys[i]);
+        map.insert(keys[count + i], i);
+    }
+    auto et = high_resolution_clock::now();
+
+    assert(map.size() == (size_t)count);
+
+    if constexpr (std::is_same<Map,u64_hashmap>::value) {
+        if (hist && !hist->name) {
+            _probe_lengths(map, *hist);
+            hist->name = name;
+        }
+    }
+
+    double t = (double)duration_cast<nanoseconds>(et - st).count();
+    return bench_result { name, count, t, 0 };
+}
+
+static bench_result bench_churn_u64_hashmap(llong count)
+{
+    return _bench_churn<u64_hashmap>("churn-u64-hashmap", count,
+        &churn_histogram);
+}
+
+static bench_result bench_churn_u64_swissmap(llong count)
+{
+    return _bench_churn<u64_swissmap>("churn-u64-swissmap", count, nullptr);
+}
+
+static const char* format_unit(llong count)
+{
+    static char buf[32];
+    if (count % 1000000000 == 0) {
+        snprintf(buf, sizeof(buf), "%lluG", count / 1000000000);
+    } else if (count % 1000000 == 0) {
+        snprintf(buf, sizeof(buf), "%lluM", count / 1000000);
+    } else if (count % 1000 == 0) {
+        snprintf(buf, sizeof(buf), "%lluK", count / 1000);
+    } else {
+        snprintf(buf, sizeof(buf), "%llu", count);
+    }
+    return buf;
+}
+
+static const char* format_comma(llong count)
+{
+    static char buf[32];
+    char buf1[32];
+
+    snprintf(buf1, sizeof(buf1), "%llu", count);
+
+    llong l = strlen(buf1), i = 0, j = 0;
+    for (; i < l; i++, j++) {
+        buf[j] = buf1[i];
+        if ((l-i-1) % 3 == 0 && i != l -1) {
+            buf[++j] = ',';
+        }
+    }
+    buf[j] = '\0';
+
+    return buf;
+}
+
+/*
+ * concurrent dedup
+ *
+ * threads call insert_if_absent on slices of count decl_hash keys in
+ * which each key occurs twice, as a parallel merge deduplicates nodes.
+ * the sharded map is compared with a hashmap behind a single mutex.
+ */
+
+typedef shardmap<decl_hash,u64,_hash_fn> hash_shardmap;
+
+struct hash_lockmap
+{
+    std::mutex lock;
+    hashmap<decl_hash,u64,_hash_fn> map;
+
+    u64 insert_if_absent(const decl_hash &key, u64 val)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto i = map.find(key);
+        if (i != map.end()) return i->second;
+        map.insert(key, val);
+        return val;
+    }
+    size_t size() { return map.size(); }
+};
+
+static std::vector<decl_hash> _dedup_keys(llong count)
+{
+    std::vector<decl_hash> keys = _hash_keys(count / 2, 5);
+    keys.insert(keys.end(), keys.begin(), keys.end());
+    return _shuffle(keys);
+}
+
+template <typename Map>
+static bench_result _bench_dedup(const char *name, llong count, size_t jobs)
+{
+    std::vector<decl_hash> keys = _dedup_keys(count);
+    std::unique_ptr<Map> map(new Map());
+    std::vector<std::thread> threads;
+    std::vector<size_t> won(jobs);
+
+    auto st = high_resolution_clock::now();
+    for (size_t t = 0; t < jobs; t++) {
+        threads.emplace_back([&, t] {
+            size_t b = keys.size() * t / jobs, e = keys.size() * (t + 1) / jobs;
+            for (size_t i = b; i < e; i++) {
+                won[t] += map->insert_if_absent(keys[i], i) == i;
+            }
+        });
+    }
+    for (auto &th : threads) th.join();
+    auto et = high_resolution_clock::now();
+
+    size_t sum = 0;
+    for (size_t w : won) sum += w;
+    assert(map->size() == keys.size() / 2 && sum == keys.size() / 2);
+
+    double t = (double)duration_cast<nanoseconds>(et - st).count();
+    return bench_result { name, (llong)keys.size(), t, 0 };
+}
+
+#define BENCH_DEDUP(id, name, Map, jobs)                                     \
+static bench_result bench_dedup_##id(llong count)                            \
+{                                                                            \
+    return _bench_dedup<Map>("dedup-" name, count, jobs);                    \
+}
+
+BENCH_DEDUP(lock_j1, "lock-j1", hash_lockmap, 1)
+BENCH_DEDUP(lock_j8, "lock-j8", hash_lockmap, 8)
+BENCH_DEDUP(lock_j32, "lock-j32", hash_lockmap, 32)
+BENCH_DEDUP(shard_j1, "shard-j1", hash_shardmap, 1)
+BENCH_DEDUP(shard_j2, "shard-j2", hash_shardmap, 2)
+BENCH_DEDUP(shard_j4, "shard-j4", hash_shardmap, 4)
+BENCH_DEDUP(shard_j8, "shard-j8", hash_shardmap, 8)
+BENCH_DEDUP(shard_j16, "shard-j16", hash_shardmap, 16)
+BENCH_DEDUP(shard_j32, "shard-j32", hash_shardmap, 32)
+
+static void print_histogram(probe_histogram &hist)
+{
+    printf("\n%s probe lengths, %zu entries, capacity %zu\n\n",
+        hist.name, hist.size, hist.capacity);
+    printf("%9s %13s %13s\n", "length", "hits", "misses");
+    for (size_t b = 0; b < probe_buckets; b++) {
+        char len[32];
+        if (b == probe_buckets - 1) snprintf(len, sizeof(len), ">=%zu", (size_t)1 << b);
+        else if (b == 0) snprintf(len, sizeof(len), "1");
+        else snprintf(len, sizeof(len), "%zu-%zu", (size_t)1 << b, ((size_t)2 << b) - 1);
+        printf("%9s %13s", len, format_comma(hist.hit[b]));
+        printf(" %13s\n", format_comma(hist.miss[b]));
+    }
+}
+
+static bench_result(* const benchmarks[])(llong) = {
+    bench_insert_hash_hashmap,
+    bench_insert_hash_swissmap,
+    bench_insert_hash_unordered,
+    bench_find_hash_hashmap,
+    bench_find_hash_swissmap,
+    bench_find_hash_unordered,
+    bench_miss_hash_hashmap,
+    bench_miss_hash_swissmap,
+    bench_miss_hash_unordered,
+    bench_insert_u64_hashmap,
+    bench_insert_u64_swissmap,
+    bench_insert_u64_unordered,
+    bench_find_u64_hashmap,
+    bench_find_u64_swissmap,
+    bench_find_u64_unordered,
+    bench_miss_u64_hashmap,
+    bench_miss_u64_swissmap,
+    bench_miss_u64_unordered,
+    bench_churn_u64_hashmap,
+    bench_churn_u64_swissmap,
+    bench_dedup_lock_j1,
+    bench_dedup_lock_j8,
+    bench_dedup_lock_j32,
+    bench_dedup_shard_j1,
+    bench_dedup_shard_j2,
+    bench_dedup_shard_j4,
+    bench_dedup_shard_j8,
+    bench_dedup_shard_j16,
+    bench_dedup_shard_j32,
+};
+
+static void print_header(const char *prefix)
+{
+    printf("%s%-24s %7s %7s %7s %13s %9s\n",
+        prefix,
+        "benchmark",
+        "count",
+        "time(s)",
+        "op(ns)",
+        "ops/s",
+        "MiB/s"
+    );
+}
+
+static void print_rules(const char *prefix)
+{
+    printf("%s%-24s %7s %7s %7s %13s %9s\n",
+        prefix,
+        "------------------------",
+        "-------",
+        "-------",
+        "-------",
+        "-------------",
+        "---------"
+    );
+}
+
+static void print_result(const char *prefix, const char *name,
+    llong count, double t, llong size)
+{
+    printf("%s%-24s %7s %7.2f %7.2f %13s %9.3f\n",
+        prefix,
+        name,
+        format_unit(count),
+        t / 1e9,
+        t / count,
+        format_comma((llong)(count * (1e9 / t))),
+        size * (1e9 / t) / (1024*1024)
+    );
+}
+
+static void run_benchmark(size_t n, llong repeat, llong count, llong pause_ms)
+{
+    double min_t = 0., max_t = 0., sum_t = 0.;
+    const char* name = "";
+    size_t size;
+    llong n_ops = count;
+    if (repeat > 0) {
+        char num[32];
+        snprintf(num, sizeof(num), "  [%2zu] ", n);
+        print_header(num);
+        print_rules("       ");
+    }
+    for (llong i = 0; i < llabs(repeat); i++) {
+        bench_result r = benchmarks[n](count);
+        name = r.name;
+        size = r.size;
+        n_ops = r.count;
+        if (min_t == 0. || r.t < min_t) min_t = r.t;
+        if (max_t == 0. || r.t > max_t) max_t = r.t;
+        sum_t += r.t;
+        if (repeat > 0) {
+            char run[32];
+            snprintf(run, sizeof(run), "%3llu/%-3llu", i+1, repeat);
+            print_result(run, name, n_ops, r.t, size);
+        }
+    }
+    if (repeat > 0) {
+        print_rules("       ");
+        print_result("worst: ", name, n_ops, max_t, size);
+        print_result("  avg: ", name, n_ops, sum_t / repeat, size);
+        print_result(" best: ", name, n_ops, min_t, size);
+        puts("");
+    } else if (llabs(repeat) >= 1) {
+        char num[32];
+        snprintf(num, sizeof(num), "[%2zu] ", n);
+        print_result(num, name, n_ops, min_t, size);
+    }
+}
+
+#if defined(_WIN32)
+# define strtok_r strtok_s
+#endif
+
+int main(int argc, char **argv)
+{
+    llong bench_num = -1, repeat = 1, count = 10000, pause_ms = 0;
+    if (argc != 5) {
+        fprintf(stderr, "usage: %s [bench_num(,…)] [repeat] [count] [pause_ms]\n", argv[0]);
+        fprintf(stderr, "\ne.g.   %s -1 -10 10000 1000\n", argv[0]);
+        exit(0);
+    }
+    if (argc > 1) {
+        bench_num = atoll(argv[1]);
+    }
+    if (argc > 2) {
+        repeat = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        count = atoll(argv[3]);
+    }
+    if (argc > 4) {
+        pause_ms = atoll(argv[4]);
+    }
+    if (repeat < 0) {
+        print_header("     ");
+        print_rules("     ");
+    }
+    if (bench_num == -1) {
+        for (llong n = 0; n < (llong)array_size(benchmarks); n++) {
+            if (pause_ms > 0 && n > 0) _millisleep(pause_ms);
+            run_benchmark(n, repeat, count, pause_ms);
+        }
+    } else {
+        char *save, *comp = strtok_r(argv[1], ",", &save);
+        while (comp) {
+            bench_num = atoll(comp);
+            if (bench_num >= 0 && bench_num < (llong)array_size(benchmarks)) {
+                run_benchmark(bench_num, repeat, count, pause_ms);
+            }
+            comp = strtok_r(nullptr, ",", &save);
+        }
+    }
+    if (churn_histogram.name) print_histogram(churn_histogram);
+}
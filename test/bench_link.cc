@@ -0,0 +1,518 @@
+#undef NDEBUG
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <vector>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+#include <crefl/link.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <synchapi.h>
+#else
+#include <time.h>
+#endif
+
+using namespace std::chrono;
+
+typedef signed long long llong;
+typedef unsigned long long ullong;
+
+#define array_size(arr) ((sizeof(arr)/sizeof(arr[0])))
+
+static void _millisleep(llong sleep_ms)
+{
+#ifdef _WIN32
+    HANDLE hTimer;
+    LARGE_INTEGER liDueTime;
+    liDueTime.QuadPart = -10000LL * sleep_ms;
+    assert((hTimer = CreateWaitableTimer(NULL, TRUE, NULL)));
+    assert(SetWaitableTimer(hTimer, &liDueTime, 0, NULL, NULL, 0));
+    assert(WaitForSingleObject(hTimer, INFINITE) == WAIT_OBJECT_0);
+    CloseHandle(hTimer);
+#else
+    struct timespec ts = {
+        (time_t)(sleep_ms / 1000),
+        (long)((sleep_ms * 1000000ll) % 1000000000ll)
+    };
+    nanosleep(&ts, nullptr);
+#endif
+}
+
+struct bench_result { const char *name; llong count; double t; llong size; };
+
+/*
+ * synthetic sources
+ *
+ * each source contains structs with common field names. half of the
+ * structs are shared between all sources so the merge both copies and
+ * aliases nodes, similar to linking headers included by many units.
+ */
+
+static const size_t merge_sources = 32;
+static const size_t merge_structs = 200;
+static const size_t merge_fields = 8;
+
+static decl_db *sources[merge_sources];
+static decl_db *hashed_sources[merge_sources];
+static size_t source_nodes;
+
+static decl_db * _source_new(size_t k)
+{
+    static const char *field_names[] = {
+        "size", "next", "data", "len", "flags", "count", "type", "name"
+    };
+    static const struct { decl_set props; size_t width; } types[] = {
+        { _decl_sint, 32 }, { _decl_uint, 8 }, { _decl_float, 64 },
+        { _decl_sint, 16 }, { _decl_uint, 64 }, { _decl_float, 32 },
+    };
+    char name[32];
+    decl_db *db = crefl_db_new();
+    crefl_db_defaults(db);
+
+    decl_ref src = crefl_decl_new(db, _decl_source);
+    snprintf(name, sizeof(name), "src%zu.h", k);
+    crefl_decl_ptr(src)->_name = crefl_name_new(db, name);
+    db->root_element = crefl_decl_idx(src);
+
+    decl_ref last = { db, 0 };
+    for (size_t i = 0; i < merge_structs; i++) {
+        decl_ref s = crefl_decl_new(db, _decl_struct);
+        if (i % 2 == 0) snprintf(name, sizeof(name), "shared%zu", i);
+        else snprintf(name, sizeof(name), "s%zu_%zu", k, i);
+        crefl_decl_ptr(s)->_name = crefl_name_new(db, name);
+        if (crefl_decl_idx(last)) crefl_decl_ptr(last)->_next = crefl_decl_idx(s);
+        else crefl_decl_ptr(src)->_link = crefl_decl_idx(s);
+        decl_ref f = { db, 0 };
+        for (size_t j = 0; j < merge_fields; j++) {
+            size_t t = (i + j) % array_size(types);
+            decl_ref g = crefl_decl_new(db, _decl_field);
+            crefl_decl_ptr(g)->_name = crefl_name_new(db, field_names[j]);
+            crefl_decl_ptr(g)->_link = crefl_decl_idx(
+                crefl_intrinsic(db, types[t].props, types[t].width));
+            if (crefl_decl_idx(f)) crefl_decl_ptr(f)->_next = crefl_decl_idx(g);
+            else crefl_decl_ptr(s)->_link = crefl_decl_idx(g);
+            f = g;
+        }
+        last = s;
+    }
+
+    return db;
+}
+
+static decl_db ** _sources()
+{
+    if (!source_nodes) {
+        for (size_t k = 0; k < merge_sources; k++) {
+            sources[k] = _source_new(k);
+            source_nodes += sources[k]->decl_offset - sources[k]->root_element;
+        }
+    }
+    return sources;
+}
+
+/* sources with persisted sha224 hashes, see crefl_db_link_hashes */
+static decl_db ** _hashed_sources()
+{
+    _sources();
+    if (!hashed_sources[0]) {
+        for (size_t k = 0; k < merge_sources; k++) {
+            hashed_sources[k] = _source_new(k);
+            crefl_db_link_hashes(hashed_sources[k]);
+        }
+    }
+    return hashed_sources;
+}
+
+/*
+ * archive of the hashed sources with persisted hashes, and one new
+ * source with half of its structs shared, used to measure relinking.
+ */
+static std::vector<uint8_t> archive_image;
+static decl_db *changed_source;
+
+static void _archive()
+{
+    if (archive_image.size()) return;
+    decl_db *db = crefl_db_new();
+    assert(crefl_link_merge(db, "bench.refl", _hashed_sources(),
+        merge_sources) == 0);
+    crefl_db_link_hashes(db);
+    archive_image.resize(crefl_db_size(db));
+    crefl_db_write_mem(db, archive_image.data(), archive_image.size());
+    crefl_db_destroy(db);
+    changed_source = _source_new(merge_sources);
+    crefl_db_link_hashes(changed_source);
+}
+
+static void _sources_destroy()
+{
+    if (!source_nodes) return;
+    for (size_t k = 0; k < merge_sources; k++) {
+        crefl_db_destroy(sources[k]);
+        if (hashed_sources[k]) crefl_db_destroy(hashed_sources[k]);
+    }
+    if (changed_source) crefl_db_destroy(changed_source);
+}
+
+/*
+ * deep source
+ *
+ * chains of nested structs where each level has a named field of the
+ * next level's type plus an intrinsic field, so fqns grow with depth.
+ */
+
+static const size_t deep_chains = 64;
+static const size_t deep_depth = 64;
+
+static decl_db *deep_db;
+
+static decl_db * _deep()
+{
+    char name[32];
+    if (deep_db) return deep_db;
+
+    decl_db *db = deep_db = crefl_db_new();
+    crefl_db_defaults(db);
+    decl_ref src = crefl_decl_new(db, _decl_source);
+    crefl_decl_ptr(src)->_name = crefl_name_new(db, "deep.h");
+    db->root_element = crefl_decl_idx(src);
+
+    decl_ref last = { db, 0 };
+    for (size_t i = 0; i < deep_chains; i++) {
+        decl_ref outer = { db, 0 }, s = { db, 0 };
+        for (size_t j = 0; j < deep_depth; j++) {
+            decl_ref t = crefl_decl_new(db, _decl_struct);
+            snprintf(name, sizeof(name), "level%zu_%zu", i, j);
+            crefl_decl_ptr(t)->_name = crefl_name_new(db, name);
+            decl_ref x = crefl_decl_new(db, _decl_field);
+            crefl_decl_ptr(x)->_name = crefl_name_new(db, "x");
+            crefl_decl_ptr(x)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+            crefl_decl_ptr(t)->_link = crefl_decl_idx(x);
+            if (crefl_decl_idx(s)) {
+                /* nest t inside s followed by a field of type t */
+                decl_ref f = crefl_decl_new(db, _decl_field);
+                crefl_decl_ptr(f)->_name = crefl_name_new(db, "child");
+                crefl_decl_ptr(f)->_link = crefl_decl_idx(t);
+                decl_ref sx = crefl_decl_link(s);
+                crefl_decl_ptr(sx)->_next = crefl_decl_idx(t);
+                crefl_decl_ptr(t)->_next = crefl_decl_idx(f);
+            } else {
+                outer = t;
+            }
+            s = t;
+        }
+        if (crefl_decl_idx(last)) crefl_decl_ptr(last)->_next = crefl_decl_idx(outer);
+        else crefl_decl_ptr(src)->_link = crefl_decl_idx(outer);
+        last = outer;
+    }
+
+    return db;
+}
+
+/*
+ * scan and merge
+ *
+ * count is in source nodes and is rounded to whole passes over the
+ * sources. scan hashes each source. merge also copies into the output.
+ */
+
+static llong _passes(llong count)
+{
+    return count / (llong)source_nodes > 0 ? count / (llong)source_nodes : 1;
+}
+
+static bench_result _bench_scan(const char *name, llong count, u32 alg)
+{
+    decl_db **srcn = _sources();
+    llong passes = _passes(count);
+
+    auto st = high_resolution_clock::now();
+    for (llong i = 0; i < passes; i++) {
+        for (size_t k = 0; k < merge_sources; k++) {
+            decl_index *ld = crefl_index_new();
+            ld->hash_alg = alg;
+            crefl_index_scan(ld, srcn[k]);
+            crefl_index_destroy(ld);
+        }
+    }
+    auto et = high_resolution_clock::now();
+
+    double t = (double)duration_cast<nanoseconds>(et - st).count();
+    return bench_result { name, passes * (llong)source_nodes, t, 0 };
+}
+
+static bench_result _bench_merge(const char *name, llong count, u32 alg,
+    size_t jobs, decl_db **srcn)
+{
+    llong passes = _passes(count);
+
+    auto st = high_resolution_clock::now();
+    for (llong i = 0; i < passes; i++) {
+        decl_db *db = crefl_db_new();
+        db->hash_alg = alg;
+        assert(crefl_link_merge_jobs(db, "bench.refl", srcn,
+            merge_sources, jobs) == 0);
+        crefl_db_destroy(db);
+    }
+    auto et = high_resolution_clock::now();
+
+    double t = (double)duration_cast<nanoseconds>(et - st).count();
+    return bench_result { name, passes * (llong)source_nodes, t, 0 };
+}
+
+static bench_result bench_scan_sha224(llong count)
+{
+    return _bench_scan("scan-sha224", count, decl_hash_sha224);
+}
+
+static bench_result bench_scan_fast(llong count)
+{
+    return _bench_scan("scan-fast", count, decl_hash_fast);
+}
+
+static bench_result _bench_scan_deep(const char *name, llong count, u32 alg)
+{
+    decl_db *db = _deep();
+    llong nodes = (llong)(db->decl_offset - db->root_element);
+    llong passes = count / nodes > 0 ? count / nodes : 1;
+
+    auto st = high_resolution_clock::now();
+    for (llong i = 0; i < passes; i++) {
+        decl_index *ld = crefl_index_new();
+        ld->hash_alg = alg;
+        crefl_index_scan(ld, db);
+        crefl_index_destroy(ld);
+    }
+    auto et = high_resolution_clock::now();
+
+    double t = (double)duration_cast<nanoseconds>(et - st).count();
+    return bench_result { name, passes * nodes, t, 0 };
+}
+
+static bench_result bench_scan_deep_sha224(llong count)
+{
+    return _bench_scan_deep("scan-deep-sha224", count, decl_hash_sha224);
+}
+
+static bench_result bench_scan_deep_fast(llong count)
+{
+    return _bench_scan_deep("scan-deep-fast", count, decl_hash_fast);
+}
+
+static bench_result bench_merge_sha224(llong count)
+{
+    return _bench_merge("merge-sha224", count, decl_hash_sha224, 1, _sources());
+}
+
+static bench_result bench_merge_fast(llong count)
+{
+    return _bench_merge("merge-fast", count, decl_hash_fast, 1, _sources());
+}
+
+static bench_result bench_merge_fast_j4(llong count)
+{
+    return _bench_merge("merge-fast-j4", count, decl_hash_fast, 4, _sources());
+}
+
+static bench_result bench_merge_sha224_hashes(llong count)
+{
+    return _bench_merge("merge-sha224-hashes", count, decl_hash_sha224, 1,
+        _hashed_sources());
+}
+
+/* load the archive and add one source, reported per archive node */
+static bench_result bench_update_sha224(llong count)
+{
+    _archive();
+    llong passes = _passes(count);
+
+    auto st = high_resolution_clock::now();
+    for (llong i = 0; i < passes; i++) {
+        decl_db *db = crefl_db_new();
+        assert(crefl_db_read_mem(db, archive_image.data(),
+            archive_image.size()) == 0);
+        assert(crefl_link_update(db, &changed_source, 1, 1) == 0);
+        crefl_db_destroy(db);
+    }
+    auto et = high_resolution_clock::now();
+
+    double t = (double)duration_cast<nanoseconds>(et - st).count();
+    return bench_result { "update-sha224", passes * (llong)source_nodes, t, 0 };
+}
+
+static const char* format_unit(llong count)
+{
+    static char buf[32];
+    if (count % 1000000000 == 0) {
+        snprintf(buf, sizeof(buf), "%lluG", count / 1000000000);
+    } else if (count % 1000000 == 0) {
+        snprintf(buf, sizeof(buf), "%lluM", count / 1000000);
+    } else if (count % 1000 == 0) {
+        snprintf(buf, sizeof(buf), "%lluK", count / 1000);
+    } else {
+        snprintf(buf, sizeof(buf), "%llu", count);
+    }
+    return buf;
+}
+
+static const char* format_comma(llong count)
+{
+    static char buf[32];
+    char buf1[32];
+
+    snprintf(buf1, sizeof(buf1), "%llu", count);
+
+    llong l = strlen(buf1), i = 0, j = 0;
+    for (; i < l; i++, j++) {
+        buf[j] = buf1[i];
+        if ((l-i-1) % 3 == 0 && i != l -1) {
+            buf[++j] = ',';
+        }
+    }
+    buf[j] = '\0';
+
+    return buf;
+}
+
+static bench_result(* const benchmarks[])(llong) = {
+    bench_scan_sha224,
+    bench_scan_fast,
+    bench_merge_sha224,
+    bench_merge_fast,
+    bench_merge_fast_j4,
+    bench_scan_deep_sha224,
+    bench_scan_deep_fast,
+    bench_merge_sha224_hashes,
+    bench_update_sha224,
+};
+static void print_header(const char *prefix)
+{
+    printf("%s%-24s %7s %7s %7s %13s %9s\n",
+        prefix,
+        "benchmark",
+        "count",
+        "time(s)",
+        "op(ns)",
+        "ops/s",
+        "MiB/s"
+    );
+}
+
+static void print_rules(const char *prefix)
+{
+    printf("%s%-24s %7s %7s %7s %13s %9s\n",
+        prefix,
+        "------------------------",
+        "-------",
+        "-------",
+        "-------",
+        "-------------",
+        "---------"
+    );
+}
+
+static void print_result(const char *prefix, const char *name,
+    llong count, double t, llong size)
+{
+    printf("%s%-24s %7s %7.2f %7.2f %13s %9.3f\n",
+        prefix,
+        name,
+        format_unit(count),
+        t / 1e9,
+        t / count,
+        format_comma((llong)(count * (1e9 / t))),
+        size * (1e9 / t) / (1024*1024)
+    );
+}
+
+static void run_benchmark(size_t n, llong repeat, llong count, llong pause_ms)
+{
+    double min_t = 0., max_t = 0., sum_t = 0.;
+    const char* name = "";
+    size_t size;
+    llong n_ops = count;
+    if (repeat > 0) {
+        char num[32];
+        snprintf(num, sizeof(num), "  [%2zu] ", n);
+        print_header(num);
+        print_rules("       ");
+    }
+    for (llong i = 0; i < llabs(repeat); i++) {
+        bench_result r = benchmarks[n](count);
+        name = r.name;
+        size = r.size;
+        n_ops = r.count;
+        if (min_t == 0. || r.t < min_t) min_t = r.t;
+        if (max_t == 0. || r.t > max_t) max_t = r.t;
+        sum_t += r.t;
+        if (repeat > 0) {
+            char run[32];
+            snprintf(run, sizeof(run), "%3llu/%-3llu", i+1, repeat);
+            print_result(run, name, n_ops, r.t, size);
+        }
+    }
+    if (repeat > 0) {
+        print_rules("       ");
+        print_result("worst: ", name, n_ops, max_t, size);
+        print_result("  avg: ", name, n_ops, sum_t / repeat, size);
+        print_result(" best: ", name, n_ops, min_t, size);
+        puts("");
+    } else if (llabs(repeat) >= 1) {
+        char num[32];
+        snprintf(num, sizeof(num), "[%2zu] ", n);
+        print_result(num, name, n_ops, min_t, size);
+    }
+}
+
+#if defined(_WIN32)
+# define strtok_r strtok_s
+#endif
+
+int main(int argc, char **argv)
+{
+    llong bench_num = -1, repeat = 1, count = 10000, pause_ms = 0;
+    if (argc != 5) {
+        fprintf(stderr, "usage: %s [bench_num(,…)] [repeat] [count] [pause_ms]\n", argv[0]);
+        fprintf(stderr, "\ne.g.   %s -1 -10 10000 1000\n", argv[0]);
+        exit(0);
+    }
+    if (argc > 1) {
+        bench_num = atoll(argv[1]);
+    }
+    if (argc > 2) {
+        repeat = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        count = atoll(argv[3]);
+    }
+    if (argc > 4) {
+        pause_ms = atoll(argv[4]);
+    }
+    if (repeat < 0) {
+        print_header("     ");
+        print_rules("     ");
+    }
+    if (bench_num == -1) {
+        for (llong n = 0; n < (llong)array_size(benchmarks); n++) {
+            if (pause_ms > 0 && n > 0) _millisleep(pause_ms);
+            run_benchmark(n, repeat, count, pause_ms);
+        }
+    } else {
+        char *save, *comp = strtok_r(argv[1], ",", &save);
+        while (comp) {
+            bench_num = atoll(comp);
+            if (bench_num >= 0 && bench_num < (llong)array_size(benchmarks)) {
+                run_benchmark(bench_num, repeat, count, pause_ms);
+            }
+            comp = strtok_r(nullptr, ",", &save);
+        }
+    }
+    _sources_destroy();
+    if (deep_db) crefl_db_destroy(deep_db);
+}
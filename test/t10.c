@@ -0,0 +1,92 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+
+/* crefl_type_width, crefl_struct_fields_offsets, layout invalidation */
+
+#define array_size(a) (sizeof(a)/sizeof(a[0]))
+
+static decl_ref new_field(decl_db *db, decl_ref prev, decl_ref type)
+{
+	decl_ref r = crefl_decl_new(db, _decl_field);
+	crefl_decl_ptr(r)->_link = crefl_decl_idx(type);
+	crefl_decl_ptr(prev)->_next = crefl_decl_idx(r);
+	return r;
+}
+
+void t10_layout()
+{
+	decl_ref r[16];
+	size_t o[16], s;
+
+	decl_db *db = crefl_db_new();
+	assert(db != NULL);
+	crefl_db_defaults(db);
+
+	decl_ref i8 = crefl_intrinsic(db, _decl_sint, 8);
+	decl_ref i16 = crefl_intrinsic(db, _decl_sint, 16);
+	decl_ref i32 = crefl_intrinsic(db, _decl_sint, 32);
+	decl_ref i64 = crefl_intrinsic(db, _decl_sint, 64);
+
+	/* struct { long d; } */
+	decl_ref inner = crefl_decl_new(db, _decl_struct);
+	decl_ref d = crefl_decl_new(db, _decl_field);
+	crefl_decl_ptr(inner)->_link = crefl_decl_idx(d);
+	crefl_decl_ptr(d)->_link = crefl_decl_idx(i64);
+
+	/* int[3] */
+	decl_ref arr = crefl_decl_new(db, _decl_array);
+	crefl_decl_ptr(arr)->_link = crefl_decl_idx(i32);
+	crefl_decl_ptr(arr)->_count = 3;
+
+	/* struct { byte a; int b; short c; struct { long d; } e; int f[3]; } */
+	decl_ref outer = crefl_decl_new(db, _decl_struct);
+	decl_ref a = crefl_decl_new(db, _decl_field);
+	crefl_decl_ptr(outer)->_link = crefl_decl_idx(a);
+	crefl_decl_ptr(a)->_link = crefl_decl_idx(i8);
+	decl_ref b = new_field(db, a, i32);
+	decl_ref c = new_field(db, b, i16);
+	decl_ref e = new_field(db, c, inner);
+	decl_ref f = new_field(db, e, arr);
+
+	assert(crefl_type_width(inner) == 64);
+	assert(crefl_struct_width(inner) == 64);
+	assert(crefl_type_width(arr) == 96);
+	assert(crefl_type_width(outer) == 320);
+	assert(crefl_type_width(e) == 64);
+	assert(crefl_union_width(outer) == 0);
+
+	s = array_size(r);
+	assert(crefl_struct_fields_offsets(outer, r, o, &s) == 0);
+	assert(s == 6);
+	assert(o[0] == 0);
+	assert(o[1] == 32);
+	assert(o[2] == 64);
+	assert(o[3] == 128);
+	assert(o[4] == 192);
+	assert(o[5] == 320);
+	assert(crefl_decl_idx(r[4]) == crefl_decl_idx(f));
+
+	/* repeated queries return the memoized layout */
+	assert(crefl_type_width(outer) == 320);
+
+	/* appending a field drops the layout table */
+	new_field(db, f, i64);
+	assert(crefl_type_width(outer) == 384);
+	s = array_size(r);
+	assert(crefl_struct_fields_offsets(outer, r, o, &s) == 0);
+	assert(s == 7);
+	assert(o[5] == 320);
+	assert(o[6] == 384);
+
+	crefl_db_destroy(db);
+}
+
+int main()
+{
+	t10_layout();
+}
@@ -0,0 +1,107 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+
+/* crefl_*_span, child index invalidation */
+
+#define array_size(a) (sizeof(a)/sizeof(a[0]))
+
+static decl_ref new_next(decl_db *db, decl_tag tag, decl_ref prev)
+{
+	decl_ref r = crefl_decl_new(db, tag);
+	crefl_decl_ptr(prev)->_next = crefl_decl_idx(r);
+	return r;
+}
+
+static void check_span(const decl_id *span, size_t n, decl_ref *r, size_t s)
+{
+	assert(n == s);
+	for (size_t i = 0; i < n; i++) {
+		assert(span[i] == crefl_decl_idx(r[i]));
+	}
+}
+
+void t11_span()
+{
+	decl_ref r[16];
+	const decl_id *span;
+	size_t s, n;
+
+	decl_db *db = crefl_db_new();
+	assert(db != NULL);
+	crefl_db_defaults(db);
+
+	decl_ref i32 = crefl_intrinsic(db, _decl_sint, 32);
+
+	/* source { struct { int a; struct {} n; int b; }; enum { x, y }; } */
+	decl_ref src = crefl_decl_new(db, _decl_source);
+	db->root_element = crefl_decl_idx(src);
+
+	decl_ref st = crefl_decl_new(db, _decl_struct);
+	crefl_decl_ptr(src)->_link = crefl_decl_idx(st);
+	decl_ref a = crefl_decl_new(db, _decl_field);
+	crefl_decl_ptr(st)->_link = crefl_decl_idx(a);
+	crefl_decl_ptr(a)->_link = crefl_decl_idx(i32);
+	decl_ref nested = new_next(db, _decl_struct, a);
+	decl_ref b = new_next(db, _decl_field, nested);
+	crefl_decl_ptr(b)->_link = crefl_decl_idx(i32);
+
+	decl_ref en = new_next(db, _decl_enum, st);
+	decl_ref x = crefl_decl_new(db, _decl_constant);
+	crefl_decl_ptr(en)->_link = crefl_decl_idx(x);
+	decl_ref y = new_next(db, _decl_constant, x);
+
+	span = crefl_struct_fields_span(st, &n);
+	assert(span != NULL);
+	assert(n == 2);
+	assert(span[0] == crefl_decl_idx(a));
+	assert(span[1] == crefl_decl_idx(b));
+
+	/* list queries match spans once the index is built */
+	s = array_size(r);
+	assert(crefl_struct_fields(st, r, &s) == 0);
+	check_span(span, n, r, s);
+
+	span = crefl_enum_constants_span(en, &n);
+	s = array_size(r);
+	assert(crefl_enum_constants(en, r, &s) == 0);
+	check_span(span, n, r, s);
+	assert(n == 2 && span[1] == crefl_decl_idx(y));
+
+	span = crefl_source_decls_span(src, &n);
+	s = array_size(r);
+	assert(crefl_source_decls(src, r, &s) == 0);
+	check_span(span, n, r, s);
+	s = array_size(r);
+	assert(crefl_source_types(src, r, &s) == 0);
+	assert(s == 2);
+
+	/* empty containers and mismatched tags */
+	span = crefl_struct_fields_span(nested, &n);
+	assert(span != NULL && n == 0);
+	span = crefl_union_fields_span(st, &n);
+	assert(span == NULL && n == 0);
+	span = crefl_function_params_span(i32, &n);
+	assert(span == NULL && n == 0);
+
+	/* appending a field drops the child index */
+	decl_ref c = new_next(db, _decl_field, b);
+	crefl_decl_ptr(c)->_link = crefl_decl_idx(i32);
+	span = crefl_struct_fields_span(st, &n);
+	assert(n == 3);
+	assert(span[2] == crefl_decl_idx(c));
+	s = array_size(r);
+	assert(crefl_struct_fields(st, r, &s) == 0);
+	check_span(span, n, r, s);
+
+	crefl_db_destroy(db);
+}
+
+int main()
+{
+	t11_span();
+}
@@ -0,0 +1,175 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+
+/* crefl_db_write_file, crefl_db_open_mmap, detach on append */
+
+#define DB_FILE "t12.refl"
+
+static decl_ref new_named(decl_db *db, decl_tag tag, const char *name)
+{
+	decl_ref r = crefl_decl_new(db, tag);
+	crefl_decl_ptr(r)->_name = crefl_name_new(db, name);
+	return r;
+}
+
+void t12_mmap()
+{
+	decl_db *db = crefl_db_new();
+	assert(db != NULL);
+	crefl_db_defaults(db);
+
+	/* source { struct foo { int a; long b; }; } */
+	decl_ref src = new_named(db, _decl_source, "t12.h");
+	db->root_element = crefl_decl_idx(src);
+	decl_ref foo = new_named(db, _decl_struct, "foo");
+	crefl_decl_ptr(src)->_link = crefl_decl_idx(foo);
+	decl_ref a = new_named(db, _decl_field, "a");
+	crefl_decl_ptr(foo)->_link = crefl_decl_idx(a);
+	crefl_decl_ptr(a)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+	decl_ref b = new_named(db, _decl_field, "b");
+	crefl_decl_ptr(a)->_next = crefl_decl_idx(b);
+	crefl_decl_ptr(b)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 64));
+
+	assert(crefl_db_write_file(db, DB_FILE) == 0);
+
+	/* copying read */
+	decl_db *db1 = crefl_db_new();
+	assert(crefl_db_read_file(db1, DB_FILE) == 0);
+	assert(db1->decl_offset == db->decl_offset);
+	assert(db1->name_offset == db->name_offset);
+	assert(db1->map_addr == NULL);
+	crefl_db_destroy(db1);
+
+	/* mapped read */
+	decl_db *db2 = crefl_db_open_mmap(DB_FILE);
+	assert(db2 != NULL);
+	assert(db2->decl_offset == db->decl_offset);
+	assert(db2->name_offset == db->name_offset);
+	assert(db2->root_element == db->root_element);
+	assert(memcmp(db2->decl, db->decl, sizeof(decl_node) * db->decl_offset) == 0);
+	assert(memcmp(db2->name, db->name, db->name_offset) == 0);
+#ifndef _WIN32
+	assert(db2->map_addr != NULL);
+	assert((uintptr_t)db2->decl % 8 == 0);
+#endif
+
+	decl_ref foo2 = crefl_lookup_by_fqn(db2, "foo");
+	assert(crefl_decl_idx(foo2) == crefl_decl_idx(foo));
+	assert(crefl_type_width(foo2) == 128);
+	assert(crefl_is_intrinsic(crefl_intrinsic(db2, _decl_uint, 8)));
+
+	/* appending copies the mapped tables to the heap */
+	decl_ref c = new_named(db2, _decl_field, "c");
+	assert(db2->map_addr == NULL);
+	crefl_decl_ptr(crefl_lookup(db2, crefl_decl_idx(b)))->_next = crefl_decl_idx(c);
+	crefl_decl_ptr(c)->_link = crefl_decl_idx(crefl_intrinsic(db2, _decl_sint, 64));
+	assert(crefl_type_width(crefl_lookup_by_fqn(db2, "foo")) == 192);
+	assert(strcmp(crefl_decl_name(crefl_lookup_by_fqn(db2, "foo::a")), "a") == 0);
+	crefl_db_destroy(db2);
+
+	/* missing files and bad images */
+	assert(crefl_db_open_mmap("t12-missing.refl") == NULL);
+	FILE *f = fopen(DB_FILE, "wb");
+	assert(f != NULL);
+	fwrite("crefl999", 1, 8, f);
+	fclose(f);
+	assert(crefl_db_open_mmap(DB_FILE) == NULL);
+	remove(DB_FILE);
+
+	crefl_db_destroy(db);
+}
+
+/* writes db the way crefl000 writers did, without the builtin prefix */
+static size_t write_v0(decl_db *db, uint8_t *buf)
+{
+	uint32_t hdr[3] = {
+		(uint32_t)(db->decl_offset - db->decl_builtin),
+		(uint32_t)(db->name_offset - db->name_builtin),
+		(uint32_t)db->root_element
+	};
+	size_t decl_sz = sizeof(decl_node) * hdr[0];
+	memcpy(buf, "crefl000", 8);
+	memcpy(buf + 8, hdr, sizeof(hdr));
+	memcpy(buf + 20, db->decl + db->decl_builtin, decl_sz);
+	memcpy(buf + 20 + decl_sz, db->name + db->name_builtin, hdr[1]);
+	return 20 + decl_sz + hdr[1];
+}
+
+void t12_v0()
+{
+	decl_db *db = crefl_db_new();
+	assert(db != NULL);
+	crefl_db_defaults(db);
+
+	/* source { struct foo { int a; }; } */
+	decl_ref src = new_named(db, _decl_source, "t12.h");
+	db->root_element = crefl_decl_idx(src);
+	decl_ref foo = new_named(db, _decl_struct, "foo");
+	crefl_decl_ptr(src)->_link = crefl_decl_idx(foo);
+	decl_ref a = new_named(db, _decl_field, "a");
+	crefl_decl_ptr(foo)->_link = crefl_decl_idx(a);
+	crefl_decl_ptr(a)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+
+	/* one byte in so the tables are unaligned, as in emitted images */
+	static uint8_t image[4096 + 1];
+	size_t sz = write_v0(db, image + 1);
+
+	/* crefl000 images are read by copying */
+	decl_db *db1 = crefl_db_new();
+	assert(crefl_db_read_mem(db1, image + 1, sz) == 0);
+	assert(db1->decl_offset == db->decl_offset);
+	assert(db1->name_offset == db->name_offset);
+	assert(memcmp(db1->decl, db->decl, sizeof(decl_node) * db->decl_offset) == 0);
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db1, "foo::a")) == crefl_decl_idx(a));
+	crefl_db_destroy(db1);
+
+	/* attach and mmap fall back to a copy */
+	decl_db *db2 = crefl_db_attach_mem(image + 1, sz);
+	assert(db2 != NULL && db2->map_addr == NULL);
+	assert(crefl_type_width(crefl_lookup_by_fqn(db2, "foo")) == 32);
+	crefl_db_destroy(db2);
+
+	FILE *f = fopen(DB_FILE, "wb");
+	assert(f != NULL);
+	fwrite(image + 1, 1, sz, f);
+	fclose(f);
+	decl_db *db3 = crefl_db_open_mmap(DB_FILE);
+	assert(db3 != NULL && db3->map_addr == NULL);
+	assert(db3->root_element == db->root_element);
+
+	/* and are written back as the current format */
+	assert(crefl_db_write_file(db3, DB_FILE) == 0);
+	crefl_db_destroy(db3);
+	db3 = crefl_db_open_mmap(DB_FILE);
+	assert(db3 != NULL);
+#ifndef _WIN32
+	assert(db3->map_addr != NULL && crefl_db_magic(db3->map_addr) == 0);
+#endif
+	crefl_db_destroy(db3);
+	remove(DB_FILE);
+
+	/* truncated images and links out of bounds are rejected */
+	db1 = crefl_db_new();
+	assert(crefl_db_read_mem(db1, image + 1, sz - 1) != 0);
+	crefl_db_destroy(db1);
+	crefl_decl_ptr(a)->_next = (decl_id)db->decl_offset;
+	sz = write_v0(db, image + 1);
+	db1 = crefl_db_new();
+	assert(crefl_db_read_mem(db1, image + 1, sz) != 0);
+	crefl_db_destroy(db1);
+
+	crefl_db_destroy(db);
+}
+
+int main()
+{
+	t12_mmap();
+	t12_v0();
+}
@@ -0,0 +1,84 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+
+/* crefl_db_attach_mem */
+
+static decl_ref new_named(decl_db *db, decl_tag tag, const char *name)
+{
+	decl_ref r = crefl_decl_new(db, tag);
+	crefl_decl_ptr(r)->_name = crefl_name_new(db, name);
+	return r;
+}
+
+void t13_attach()
+{
+	decl_db *db = crefl_db_new();
+	assert(db != NULL);
+	crefl_db_defaults(db);
+
+	/* source { enum bar { x, y }; } */
+	decl_ref src = new_named(db, _decl_source, "t13.h");
+	db->root_element = crefl_decl_idx(src);
+	decl_ref bar = new_named(db, _decl_enum, "bar");
+	crefl_decl_ptr(src)->_link = crefl_decl_idx(bar);
+	crefl_decl_ptr(bar)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_uint, 32));
+	decl_ref x = new_named(db, _decl_constant, "x");
+	crefl_decl_ptr(bar)->_link = crefl_decl_idx(x);
+	decl_ref y = new_named(db, _decl_constant, "y");
+	crefl_decl_ptr(x)->_next = crefl_decl_idx(y);
+	crefl_decl_ptr(y)->_value = 1;
+
+	size_t sz = crefl_db_size(db);
+	uint64_t *image = (uint64_t*)malloc(sz + 16);
+	uint8_t *buf = (uint8_t*)image;
+	assert(crefl_db_write_mem(db, buf, sz) == 0);
+
+	/* aligned images are used in place */
+	decl_db *db1 = crefl_db_attach_mem(buf, sz);
+	assert(db1 != NULL);
+	assert(db1->map_addr == buf);
+	assert((uint8_t*)db1->decl == buf + sizeof(decl_db_hdr));
+	assert(db1->decl_offset == db->decl_offset);
+	decl_ref y1 = crefl_lookup_by_fqn(db1, "bar::y");
+	assert(crefl_decl_idx(y1) == crefl_decl_idx(y));
+	assert(crefl_constant_value(y1).ux == 1);
+	crefl_db_destroy(db1);
+
+	/* misaligned images are copied */
+	memmove(buf + 1, buf, sz);
+	decl_db *db2 = crefl_db_attach_mem(buf + 1, sz);
+	assert(db2 != NULL);
+	assert(db2->map_addr == NULL);
+	assert(db2->decl_offset == db->decl_offset);
+	crefl_db_destroy(db2);
+	memmove(buf, buf + 1, sz);
+
+	/* links are checked unless the image is flagged */
+	decl_node *n = (decl_node*)(buf + sizeof(decl_db_hdr)) + crefl_decl_idx(y);
+	n->_next = 0x7fffffff;
+	assert(crefl_db_attach_mem(buf, sz) == NULL);
+	((decl_db_hdr*)buf)->flags |= decl_db_flag_checked;
+	decl_db *db3 = crefl_db_attach_mem(buf, sz);
+	assert(db3 != NULL);
+	crefl_db_destroy(db3);
+
+	/* bad images */
+	assert(crefl_db_attach_mem(buf, sizeof(decl_db_hdr) - 1) == NULL);
+	assert(crefl_db_attach_mem(buf, sz - 1) == NULL);
+
+	free(image);
+	crefl_db_destroy(db);
+}
+
+int main()
+{
+	t13_attach();
+}
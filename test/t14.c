@@ -0,0 +1,109 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+
+/* crefl_db_set_check, crefl_db_check_links, crefl_db_checksum */
+
+static const enum crefl_db_check checks[] = {
+	crefl_db_check_full,
+	crefl_db_check_vector,
+	crefl_db_check_defer,
+	crefl_db_check_trusted
+};
+
+static decl_db * read_image(const uint8_t *buf, size_t sz)
+{
+	decl_db *db = crefl_db_new();
+	if (crefl_db_read_mem(db, buf, sz) != 0) {
+		crefl_db_destroy(db);
+		return NULL;
+	}
+	return db;
+}
+
+void t14_check()
+{
+	decl_db *db = crefl_db_new();
+	assert(db != NULL);
+	crefl_db_defaults(db);
+
+	/* a source containing a chain of fields */
+	decl_ref src = crefl_decl_new(db, _decl_source);
+	crefl_decl_ptr(src)->_name = crefl_name_new(db, "t14.h");
+	db->root_element = crefl_decl_idx(src);
+	decl_ref last = src;
+	for (size_t i = 0; i < 7; i++) {
+		decl_ref f = crefl_decl_new(db, _decl_field);
+		crefl_decl_ptr(f)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+		if (i == 0) crefl_decl_ptr(last)->_link = crefl_decl_idx(f);
+		else crefl_decl_ptr(last)->_next = crefl_decl_idx(f);
+		last = f;
+	}
+
+	size_t sz = crefl_db_size(db);
+	uint8_t *buf = (uint8_t*)malloc(sz);
+	assert(crefl_db_write_mem(db, buf, sz) == 0);
+
+	decl_db_hdr *hdr = (decl_db_hdr*)buf;
+	assert(hdr->flags & decl_db_flag_checksum);
+	assert(hdr->checksum == crefl_db_checksum(buf + sizeof(decl_db_hdr),
+		sz - sizeof(decl_db_hdr)));
+
+	/* valid images load with every policy */
+	for (size_t i = 0; i < sizeof(checks)/sizeof(checks[0]); i++) {
+		crefl_db_set_check(checks[i]);
+		decl_db *db1 = read_image(buf, sz);
+		assert(db1 != NULL);
+		assert(db1->decl_offset == db->decl_offset);
+		assert(crefl_db_check_links(db1) == 0);
+		crefl_db_destroy(db1);
+	}
+
+	/* out of bounds link in the last node, checks the vector tail */
+	decl_node *n = (decl_node*)(buf + sizeof(decl_db_hdr)) + crefl_decl_idx(last);
+	n->_attr = (decl_id)db->decl_offset;
+
+	crefl_db_set_check(crefl_db_check_full);
+	assert(read_image(buf, sz) == NULL);
+	crefl_db_set_check(crefl_db_check_vector);
+	assert(read_image(buf, sz) == NULL);
+	crefl_db_set_check(crefl_db_check_trusted);
+	assert(read_image(buf, sz) == NULL);
+	crefl_db_set_check(crefl_db_check_defer);
+	decl_db *db2 = read_image(buf, sz);
+	assert(db2 != NULL);
+	assert(crefl_db_check_links(db2) != 0);
+	crefl_db_destroy(db2);
+
+	/* name out of bounds in the first user node */
+	n->_attr = 0;
+	n = (decl_node*)(buf + sizeof(decl_db_hdr)) + crefl_decl_idx(src);
+	n->_name = (decl_id)db->name_offset;
+	crefl_db_set_check(crefl_db_check_vector);
+	assert(read_image(buf, sz) == NULL);
+
+	/* trusted images without a checksum are checked in full */
+	hdr->flags &= ~decl_db_flag_checksum;
+	crefl_db_set_check(crefl_db_check_trusted);
+	assert(read_image(buf, sz) == NULL);
+	n->_name = 0;
+	decl_db *db3 = read_image(buf, sz);
+	assert(db3 != NULL);
+	crefl_db_destroy(db3);
+
+	crefl_db_set_check(crefl_db_check_full);
+	free(buf);
+	crefl_db_destroy(db);
+}
+
+int main()
+{
+	t14_check();
+}
@@ -0,0 +1,103 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+#include <crefl/link.h>
+
+/* crefl_db_set_intern, interned merge output */
+
+static decl_db * new_source(const char *name, int intern)
+{
+	decl_db *db = crefl_db_new();
+	crefl_db_defaults(db);
+	if (intern) crefl_db_set_intern(db, 1);
+	decl_ref src = crefl_decl_new(db, _decl_source);
+	crefl_decl_ptr(src)->_name = crefl_name_new(db, name);
+	db->root_element = crefl_decl_idx(src);
+
+	/* struct sN { int size; int next; } for N in 0..3 */
+	decl_ref last = src;
+	for (int i = 0; i < 4; i++) {
+		char sname[8];
+		snprintf(sname, sizeof(sname), "s%d", i);
+		decl_ref s = crefl_decl_new(db, _decl_struct);
+		crefl_decl_ptr(s)->_name = crefl_name_new(db, sname);
+		if (last.decl_idx == src.decl_idx) crefl_decl_ptr(src)->_link = crefl_decl_idx(s);
+		else crefl_decl_ptr(last)->_next = crefl_decl_idx(s);
+		decl_ref a = crefl_decl_new(db, _decl_field);
+		crefl_decl_ptr(a)->_name = crefl_name_new(db, "size");
+		crefl_decl_ptr(a)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+		crefl_decl_ptr(s)->_link = crefl_decl_idx(a);
+		decl_ref b = crefl_decl_new(db, _decl_field);
+		crefl_decl_ptr(b)->_name = crefl_name_new(db, "next");
+		crefl_decl_ptr(b)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+		crefl_decl_ptr(a)->_next = crefl_decl_idx(b);
+		last = s;
+	}
+	return db;
+}
+
+void t15_intern()
+{
+	decl_db *db1 = new_source("t15.h", 0);
+	decl_db *db2 = new_source("t15.h", 1);
+
+	/* interned names are stored once and compare by id */
+	assert(db2->name_offset < db1->name_offset);
+	assert(crefl_db_size(db2) < crefl_db_size(db1));
+	assert(crefl_name_new(db2, "size") == crefl_name_new(db2, "size"));
+	assert(crefl_name_new(db2, "int") < db2->name_builtin);
+	assert(crefl_name_new(db1, "size") != crefl_name_new(db1, "size"));
+
+	/* enabling interning indexes existing names */
+	size_t name_offset = db1->name_offset;
+	crefl_db_set_intern(db1, 1);
+	assert(crefl_name_new(db1, "next") != 0);
+	assert(db1->name_offset == name_offset);
+	assert(crefl_name_new(db1, "new") == name_offset);
+	assert(strcmp(db1->name + crefl_name_new(db1, "new"), "new") == 0);
+	crefl_db_set_intern(db1, 0);
+	assert(crefl_name_new(db1, "new") != name_offset);
+
+	/* merge output is interned */
+	decl_db *srcn[2] = { db1, db2 };
+	decl_db *db3 = crefl_db_new();
+	assert(crefl_link_merge(db3, "t15.refl", srcn, 2) == 0);
+	for (size_t i = 1; i < db3->decl_offset; i++) {
+		for (size_t j = i + 1; j < db3->decl_offset; j++) {
+			decl_id ni = db3->decl[i]._name, nj = db3->decl[j]._name;
+			if (ni && nj && strcmp(db3->name + ni, db3->name + nj) == 0) {
+				assert(ni == nj);
+			}
+		}
+	}
+
+	/* loaded names are interned */
+	size_t sz = crefl_db_size(db2);
+	uint64_t *image = (uint64_t*)malloc(sz);
+	assert(crefl_db_write_mem(db2, (uint8_t*)image, sz) == 0);
+	decl_db *db4 = crefl_db_new();
+	crefl_db_set_intern(db4, 1);
+	assert(crefl_db_read_mem(db4, (uint8_t*)image, sz) == 0);
+	name_offset = db4->name_offset;
+	assert(crefl_name_new(db4, "next") == crefl_name_new(db2, "next"));
+	assert(crefl_name_new(db4, "s3") == crefl_name_new(db2, "s3"));
+	assert(db4->name_offset == name_offset);
+	crefl_db_destroy(db4);
+	free(image);
+
+	crefl_db_destroy(db3);
+	crefl_db_destroy(db2);
+	crefl_db_destroy(db1);
+}
+
+int main()
+{
+	t15_intern();
+}
@@ -0,0 +1,86 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+#include <crefl/link.h>
+
+/* crefl_link_merge_jobs output matches serial merge */
+
+#define NSOURCES 12
+
+static decl_db * new_source(int k)
+{
+	char name[16];
+	decl_db *db = crefl_db_new();
+	crefl_db_defaults(db);
+	decl_ref src = crefl_decl_new(db, _decl_source);
+	snprintf(name, sizeof(name), "src%d.h", k);
+	crefl_decl_ptr(src)->_name = crefl_name_new(db, name);
+	db->root_element = crefl_decl_idx(src);
+
+	/* structs s0..s7 shared with other sources plus one private struct */
+	decl_ref last = src;
+	for (int i = 0; i < 9; i++) {
+		decl_ref s = crefl_decl_new(db, _decl_struct);
+		if (i < 8) snprintf(name, sizeof(name), "s%d", (i + k) % 8);
+		else snprintf(name, sizeof(name), "p%d", k);
+		crefl_decl_ptr(s)->_name = crefl_name_new(db, name);
+		if (crefl_decl_idx(last) == crefl_decl_idx(src)) {
+			crefl_decl_ptr(src)->_link = crefl_decl_idx(s);
+		} else {
+			crefl_decl_ptr(last)->_next = crefl_decl_idx(s);
+		}
+		decl_ref f = crefl_decl_new(db, _decl_field);
+		crefl_decl_ptr(f)->_name = crefl_name_new(db, "x");
+		crefl_decl_ptr(f)->_link = crefl_decl_idx(
+			crefl_intrinsic(db, _decl_sint, 8 << ((i + k) % 8 % 4)));
+		crefl_decl_ptr(s)->_link = crefl_decl_idx(f);
+		last = s;
+	}
+	return db;
+}
+
+static uint8_t * merge_image(decl_db **srcn, size_t jobs, size_t *sz)
+{
+	decl_db *db = crefl_db_new();
+	assert(crefl_link_merge_jobs(db, "t16.refl", srcn, NSOURCES, jobs) == 0);
+	*sz = crefl_db_size(db);
+	uint8_t *buf = (uint8_t*)malloc(*sz);
+	assert(crefl_db_write_mem(db, buf, *sz) == 0);
+	crefl_db_destroy(db);
+	return buf;
+}
+
+void t16_merge_jobs()
+{
+	decl_db *srcn[NSOURCES];
+	size_t sz1, sz2, jobs[] = { 2, 4, NSOURCES + 4, 0 };
+
+	for (int i = 0; i < NSOURCES; i++) {
+		srcn[i] = new_source(i);
+	}
+
+	uint8_t *buf1 = merge_image(srcn, 1, &sz1);
+	for (size_t j = 0; j < sizeof(jobs)/sizeof(jobs[0]); j++) {
+		uint8_t *buf2 = merge_image(srcn, jobs[j], &sz2);
+		assert(sz1 == sz2);
+		assert(memcmp(buf1, buf2, sz1) == 0);
+		free(buf2);
+	}
+	free(buf1);
+
+	for (int i = 0; i < NSOURCES; i++) {
+		crefl_db_destroy(srcn[i]);
+	}
+}
+
+int main()
+{
+	t16_merge_jobs();
+}
@@ -0,0 +1,107 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+#include <crefl/link.h>
+
+/* decl_hash_fast node identity and header hash algorithm */
+
+static decl_db * new_source(int k)
+{
+	char name[16];
+	decl_db *db = crefl_db_new();
+	crefl_db_defaults(db);
+	decl_ref src = crefl_decl_new(db, _decl_source);
+	snprintf(name, sizeof(name), "src%d.h", k);
+	crefl_decl_ptr(src)->_name = crefl_name_new(db, name);
+	db->root_element = crefl_decl_idx(src);
+
+	/* struct s { int x; struct s *next; } plus struct pK { int x; } */
+	decl_ref s = crefl_decl_new(db, _decl_struct);
+	crefl_decl_ptr(s)->_name = crefl_name_new(db, "s");
+	crefl_decl_ptr(src)->_link = crefl_decl_idx(s);
+	decl_ref x = crefl_decl_new(db, _decl_field);
+	crefl_decl_ptr(x)->_name = crefl_name_new(db, "x");
+	crefl_decl_ptr(x)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+	crefl_decl_ptr(s)->_link = crefl_decl_idx(x);
+	decl_ref next = crefl_decl_new(db, _decl_field);
+	crefl_decl_ptr(next)->_name = crefl_name_new(db, "next");
+	crefl_decl_ptr(x)->_next = crefl_decl_idx(next);
+	decl_ref ptr = crefl_decl_new(db, _decl_pointer);
+	crefl_decl_ptr(ptr)->_width = 64;
+	crefl_decl_ptr(ptr)->_link = crefl_decl_idx(s);
+	crefl_decl_ptr(next)->_link = crefl_decl_idx(ptr);
+
+	decl_ref p = crefl_decl_new(db, _decl_struct);
+	snprintf(name, sizeof(name), "p%d", k);
+	crefl_decl_ptr(p)->_name = crefl_name_new(db, name);
+	crefl_decl_ptr(s)->_next = crefl_decl_idx(p);
+	decl_ref y = crefl_decl_new(db, _decl_field);
+	crefl_decl_ptr(y)->_name = crefl_name_new(db, "x");
+	crefl_decl_ptr(y)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+	crefl_decl_ptr(p)->_link = crefl_decl_idx(y);
+	return db;
+}
+
+static decl_db * merge(decl_db **srcn, size_t n, u32 alg)
+{
+	decl_db *db = crefl_db_new();
+	db->hash_alg = alg;
+	assert(crefl_link_merge(db, "t17.refl", srcn, n) == 0);
+	return db;
+}
+
+void t17_hash_alg()
+{
+	decl_db *srcn[3] = { new_source(0), new_source(1), new_source(2) };
+
+	/* both algorithms deduplicate the shared struct */
+	decl_db *db1 = merge(srcn, 3, decl_hash_sha224);
+	decl_db *db2 = merge(srcn, 3, decl_hash_fast);
+	assert(db1->decl_offset == db2->decl_offset);
+	assert(memcmp(db1->decl, db2->decl, sizeof(decl_node) * db1->decl_offset) == 0);
+
+	/* fast sums use 16 bytes and differ from sha224 sums */
+	decl_index *ld1 = crefl_index_new();
+	decl_index *ld2 = crefl_index_new();
+	ld2->hash_alg = decl_hash_fast;
+	crefl_index_scan(ld1, srcn[0]);
+	crefl_index_scan(ld2, srcn[0]);
+	for (size_t i = srcn[0]->root_element; i < srcn[0]->decl_offset; i++) {
+		decl_ref r = crefl_lookup(srcn[0], i);
+		decl_hash *h1 = &crefl_entry_ptr(crefl_entry_ref(ld1, r))->hash;
+		decl_hash *h2 = &crefl_entry_ptr(crefl_entry_ref(ld2, r))->hash;
+		static const uint8_t zero[sizeof(decl_hash) - 16];
+		assert(memcmp(h1->sum, h2->sum, sizeof(decl_hash)) != 0);
+		assert(memcmp(h2->sum + 16, zero, sizeof(zero)) == 0);
+	}
+	crefl_index_destroy(ld1);
+	crefl_index_destroy(ld2);
+
+	/* the algorithm is recorded in the header */
+	size_t sz = crefl_db_size(db2);
+	uint8_t *buf = (uint8_t*)malloc(sz);
+	assert(crefl_db_write_mem(db2, buf, sz) == 0);
+	assert((((decl_db_hdr*)buf)->flags & decl_db_flag_hash_mask) ==
+		(decl_hash_fast << decl_db_flag_hash_shift));
+	decl_db *db3 = crefl_db_new();
+	assert(crefl_db_read_mem(db3, buf, sz) == 0);
+	assert(db3->hash_alg == decl_hash_fast);
+	crefl_db_destroy(db3);
+	free(buf);
+
+	crefl_db_destroy(db2);
+	crefl_db_destroy(db1);
+	for (size_t i = 0; i < 3; i++) crefl_db_destroy(srcn[i]);
+}
+
+int main()
+{
+	t17_hash_alg();
+}
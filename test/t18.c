@@ -0,0 +1,94 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+#include <crefl/link.h>
+
+/* crefl_entry_fqn materialized from fqn links */
+
+static decl_ref new_named(decl_db *db, decl_tag tag, const char *name)
+{
+	decl_ref r = crefl_decl_new(db, tag);
+	crefl_decl_ptr(r)->_name = crefl_name_new(db, name);
+	return r;
+}
+
+static const char * fqn(decl_index *ld, decl_ref r)
+{
+	return crefl_entry_fqn(crefl_entry_ref(ld, r));
+}
+
+void t18_entry_fqn()
+{
+	decl_db *db = crefl_db_new();
+	assert(db != NULL);
+	crefl_db_defaults(db);
+
+	/*
+	 * archive { source { struct foo { struct { u8 g; } ; x; arr[3] *foo; };
+	 *                    fn(int q) [[deprecated]]; } }
+	 */
+	decl_ref ar = new_named(db, _decl_archive, "t18.refl");
+	db->root_element = crefl_decl_idx(ar);
+	decl_ref src = new_named(db, _decl_source, "t18.h");
+	crefl_decl_ptr(ar)->_link = crefl_decl_idx(src);
+	decl_ref foo = new_named(db, _decl_struct, "foo");
+	crefl_decl_ptr(src)->_link = crefl_decl_idx(foo);
+	decl_ref anon = new_named(db, _decl_struct, "");
+	crefl_decl_ptr(foo)->_link = crefl_decl_idx(anon);
+	decl_ref g = new_named(db, _decl_field, "g");
+	crefl_decl_ptr(anon)->_link = crefl_decl_idx(g);
+	crefl_decl_ptr(g)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_uint, 8));
+	decl_ref x = new_named(db, _decl_field, "x");
+	crefl_decl_ptr(anon)->_next = crefl_decl_idx(x);
+	crefl_decl_ptr(x)->_link = crefl_decl_idx(anon);
+	decl_ref arr = new_named(db, _decl_field, "arr");
+	crefl_decl_ptr(x)->_next = crefl_decl_idx(arr);
+	decl_ref a = crefl_decl_new(db, _decl_array);
+	crefl_decl_ptr(arr)->_link = crefl_decl_idx(a);
+	crefl_decl_ptr(a)->_count = 3;
+	decl_ref p = crefl_decl_new(db, _decl_pointer);
+	crefl_decl_ptr(a)->_link = crefl_decl_idx(p);
+	crefl_decl_ptr(p)->_link = crefl_decl_idx(foo);
+	decl_ref fn = new_named(db, _decl_function, "fn");
+	crefl_decl_ptr(foo)->_next = crefl_decl_idx(fn);
+	decl_ref q = new_named(db, _decl_param, "q");
+	crefl_decl_ptr(fn)->_link = crefl_decl_idx(q);
+	crefl_decl_ptr(q)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+	decl_ref dep = new_named(db, _decl_attribute, "deprecated");
+	crefl_decl_ptr(fn)->_attr = crefl_decl_idx(dep);
+
+	decl_index *ld = crefl_index_new();
+	crefl_index_scan(ld, db);
+
+	assert(strcmp(fqn(ld, ar), "t18.refl") == 0);
+	assert(strcmp(fqn(ld, src), "t18.h") == 0);
+	assert(strcmp(fqn(ld, foo), "foo") == 0);
+	assert(strcmp(fqn(ld, anon), "foo") == 0);
+	assert(strcmp(fqn(ld, g), "foo::g") == 0);
+	assert(strcmp(fqn(ld, x), "foo::x") == 0);
+	assert(strcmp(fqn(ld, arr), "foo::arr") == 0);
+	assert(strcmp(fqn(ld, a), "foo::arr") == 0);
+	assert(strcmp(fqn(ld, p), "foo::arr") == 0);
+	assert(strcmp(fqn(ld, fn), "fn") == 0);
+	assert(strcmp(fqn(ld, q), "fn::q") == 0);
+	assert(strcmp(fqn(ld, dep), "fn::deprecated") == 0);
+
+	/* intrinsics take the fqn of the first node that reaches them */
+	assert(strcmp(fqn(ld, crefl_intrinsic(db, _decl_uint, 8)), "foo::g::ubyte") == 0 ||
+		   strcmp(fqn(ld, crefl_intrinsic(db, _decl_uint, 8)), "foo::g::uchar") == 0);
+
+	/* materialized names are cached and interned */
+	assert(fqn(ld, a) == fqn(ld, p));
+
+	crefl_index_destroy(ld);
+	crefl_db_destroy(db);
+}
+
+int main()
+{
+	t18_entry_fqn();
+}
@@ -0,0 +1,105 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include <crefl/model.h>
+#include <crefl/link.h>
+
+/* crefl_index_scan of deep graphs on a thread with a small stack */
+
+#define DEPTH 200000
+#define STACK_SIZE (256 << 10)
+
+/* source containing a chain of DEPTH nested typedefs ending in an int */
+static decl_db * new_chain(const char *src_name)
+{
+	char name[16];
+	decl_db *db = crefl_db_new();
+	crefl_db_defaults(db);
+	decl_ref src = crefl_decl_new(db, _decl_source);
+	crefl_decl_ptr(src)->_name = crefl_name_new(db, src_name);
+	db->root_element = crefl_decl_idx(src);
+
+	decl_ref last = src;
+	for (int i = 0; i < DEPTH; i++) {
+		decl_ref t = crefl_decl_new(db, _decl_typedef);
+		snprintf(name, sizeof(name), "t%d", i);
+		crefl_decl_ptr(t)->_name = crefl_name_new(db, name);
+		crefl_decl_ptr(last)->_link = crefl_decl_idx(t);
+		last = t;
+	}
+	crefl_decl_ptr(last)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+
+	return db;
+}
+
+struct scan_arg
+{
+	decl_db *db;
+	decl_index *index;
+};
+
+static void * scan_thread(void *arg)
+{
+	struct scan_arg *a = (struct scan_arg *)arg;
+	crefl_index_scan(a->index, a->db);
+	return NULL;
+}
+
+static decl_index * scan_small_stack(decl_db *db, u32 alg)
+{
+	pthread_attr_t attr;
+	pthread_t thread;
+	struct scan_arg a = { db, crefl_index_new() };
+
+	a.index->hash_alg = alg;
+	assert(pthread_attr_init(&attr) == 0);
+	assert(pthread_attr_setstacksize(&attr, STACK_SIZE) == 0);
+	assert(pthread_create(&thread, &attr, scan_thread, &a) == 0);
+	assert(pthread_join(thread, NULL) == 0);
+	pthread_attr_destroy(&attr);
+
+	return a.index;
+}
+
+static void t19_deep_chain(u32 alg)
+{
+	decl_db *db1 = new_chain("a.h"), *db2 = new_chain("b.h");
+	decl_index *ld1 = scan_small_stack(db1, alg);
+	decl_index *ld2 = scan_small_stack(db2, alg);
+
+	decl_ref r1 = crefl_lookup(db1, db1->root_element);
+	decl_ref r2 = crefl_lookup(db2, db2->root_element);
+	decl_ref t1 = crefl_lookup(db1, crefl_decl_ptr(r1)->_link);
+	decl_ref t2 = crefl_lookup(db2, crefl_decl_ptr(r2)->_link);
+
+	/* every node in the chain has a valid hash */
+	for (size_t i = db1->root_element; i < db1->decl_offset; i++) {
+		assert(crefl_entry_is_valid(crefl_entry_ref(ld1, crefl_lookup(db1, i))));
+	}
+
+	/* identical declarations in different sources have identical hashes */
+	assert(memcmp(&crefl_entry_ptr(crefl_entry_ref(ld1, t1))->hash,
+				  &crefl_entry_ptr(crefl_entry_ref(ld2, t2))->hash,
+				  sizeof(decl_hash)) == 0);
+
+	/* source hashes absorb the source name */
+	assert(memcmp(&crefl_entry_ptr(crefl_entry_ref(ld1, r1))->hash,
+				  &crefl_entry_ptr(crefl_entry_ref(ld2, r2))->hash,
+				  sizeof(decl_hash)) != 0);
+
+	crefl_index_destroy(ld1);
+	crefl_index_destroy(ld2);
+	crefl_db_destroy(db1);
+	crefl_db_destroy(db2);
+}
+
+int main()
+{
+	t19_deep_chain(decl_hash_sha224);
+	t19_deep_chain(decl_hash_fast);
+}
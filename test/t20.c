@@ -0,0 +1,213 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+#include <crefl/link.h>
+
+/* crefl_db_link_hashes, persisted hash section, adoption by scan and merge */
+
+#define NSOURCES 4
+
+static decl_db * new_source(int k)
+{
+	char name[16];
+	decl_db *db = crefl_db_new();
+	crefl_db_defaults(db);
+	decl_ref src = crefl_decl_new(db, _decl_source);
+	snprintf(name, sizeof(name), "src%d.h", k);
+	crefl_decl_ptr(src)->_name = crefl_name_new(db, name);
+	db->root_element = crefl_decl_idx(src);
+
+	decl_ref last = src;
+	for (int i = 0; i < 4; i++) {
+		decl_ref s = crefl_decl_new(db, _decl_struct);
+		snprintf(name, sizeof(name), "s%d", (i + k) % 4);
+		crefl_decl_ptr(s)->_name = crefl_name_new(db, name);
+		if (crefl_decl_idx(last) == crefl_decl_idx(src)) {
+			crefl_decl_ptr(src)->_link = crefl_decl_idx(s);
+		} else {
+			crefl_decl_ptr(last)->_next = crefl_decl_idx(s);
+		}
+		decl_ref f = crefl_decl_new(db, _decl_field);
+		crefl_decl_ptr(f)->_name = crefl_name_new(db, "x");
+		crefl_decl_ptr(f)->_link = crefl_decl_idx(
+			crefl_intrinsic(db, _decl_sint, 8 << ((i + k) % 4)));
+		crefl_decl_ptr(s)->_link = crefl_decl_idx(f);
+		last = s;
+	}
+	return db;
+}
+
+static uint8_t * write_image(decl_db *db, size_t *sz)
+{
+	*sz = crefl_db_size(db);
+	uint8_t *buf = (uint8_t*)malloc(*sz);
+	assert(crefl_db_write_mem(db, buf, *sz) == 0);
+	return buf;
+}
+
+static decl_entry * hashes_section(uint8_t *buf, size_t sz)
+{
+	decl_db_hdr *hdr = (decl_db_hdr*)buf;
+	size_t n = hdr->decl_entry_count;
+	return (decl_entry*)(buf + sz - sizeof(decl_entry) * n);
+}
+
+/* compare an index against a fresh scan of the same db without hashes */
+static void check_index(decl_index *ld, decl_db *db, decl_db *ref)
+{
+	decl_index *rd = crefl_index_new();
+	rd->hash_alg = ld->hash_alg;
+	crefl_index_scan(rd, ref);
+	for (size_t i = 0; i < db->decl_offset; i++) {
+		decl_entry_ref e1 = crefl_entry_ref(ld, crefl_lookup(db, i));
+		decl_entry_ref e2 = crefl_entry_ref(rd, crefl_lookup(ref, i));
+		assert(crefl_entry_is_valid(e1) == crefl_entry_is_valid(e2));
+		if (!crefl_entry_is_valid(e1)) continue;
+		assert(memcmp(&crefl_entry_ptr(e1)->hash, &crefl_entry_ptr(e2)->hash,
+			sizeof(decl_hash)) == 0);
+		assert(strcmp(crefl_entry_fqn(e1), crefl_entry_fqn(e2)) == 0);
+	}
+	crefl_index_destroy(rd);
+}
+
+static uint8_t * merge_image(decl_db **srcn, size_t *sz)
+{
+	decl_db *db = crefl_db_new();
+	assert(crefl_link_merge(db, "t20.refl", srcn, NSOURCES) == 0);
+	uint8_t *buf = write_image(db, sz);
+	crefl_db_destroy(db);
+	return buf;
+}
+
+void t20_persist_hashes()
+{
+	decl_db *db = new_source(0);
+	size_t sz1, sz2;
+
+	/* images without hashes are unchanged */
+	uint8_t *buf1 = write_image(db, &sz1);
+	assert((((decl_db_hdr*)buf1)->flags & decl_db_flag_hashes_mask) == 0);
+
+	/* images with hashes carry a versioned section of entries */
+	assert(crefl_db_link_hashes(db) == 0);
+	assert(db->hash_count == db->decl_offset);
+	uint8_t *buf2 = write_image(db, &sz2);
+	decl_db_hdr *hdr = (decl_db_hdr*)buf2;
+	assert(((hdr->flags & decl_db_flag_hashes_mask) >> decl_db_flag_hashes_shift)
+		== decl_db_hashes_version);
+	assert(sz2 % 8 == 0);
+	assert(sz2 > sz1);
+	assert(memcmp(buf1 + sizeof(decl_db_hdr), buf2 + sizeof(decl_db_hdr),
+		sz1 - sizeof(decl_db_hdr)) == 0);
+
+	/* read copies the section, attach points into the image */
+	decl_db *db2 = crefl_db_new();
+	assert(crefl_db_read_mem(db2, buf2, sz2) == 0);
+	assert(db2->hash_count == db2->decl_offset && !db2->hash_image);
+	decl_db *db3 = crefl_db_attach_mem(buf2, sz2);
+	assert(db3 != NULL);
+	assert(db3->hash_count == db3->decl_offset && db3->hash_image);
+	assert((uint8_t*)db3->hash_entry == (uint8_t*)hashes_section(buf2, sz2));
+
+	/* scans adopt persisted entries */
+	decl_db *ref = crefl_db_new();
+	assert(crefl_db_read_mem(ref, buf1, sz1) == 0);
+	decl_index *ld = crefl_index_new();
+	crefl_index_scan(ld, db2);
+	check_index(ld, db2, ref);
+	crefl_index_destroy(ld);
+
+	/* adopted entries are not recomputed */
+	decl_entry *ents = hashes_section(buf2, sz2);
+	size_t r = ((decl_db_hdr*)buf2)->root_element;
+	ents[r].hash.sum[0] ^= 0xff;
+	ld = crefl_index_new();
+	crefl_index_scan(ld, db3);
+	assert(crefl_entry_ptr(crefl_entry_ref(ld, crefl_lookup(db3, r)))->hash.sum[0] ==
+		   ents[r].hash.sum[0]);
+	crefl_index_destroy(ld);
+
+	/* entries with a different algorithm are recomputed */
+	ld = crefl_index_new();
+	ld->hash_alg = decl_hash_fast;
+	crefl_index_scan(ld, db3);
+	check_index(ld, db3, ref);
+	crefl_index_destroy(ld);
+
+	/* the checksum covers the section */
+	crefl_db_set_check(crefl_db_check_trusted);
+	decl_db *db4 = crefl_db_new();
+	assert(crefl_db_read_mem(db4, buf2, sz2) != 0);
+	crefl_db_destroy(db4);
+	crefl_db_set_check(crefl_db_check_full);
+	ents[r].hash.sum[0] ^= 0xff;
+
+	/* fqn links are checked */
+	ents[r].fqn_parent = (decl_id)hdr->decl_entry_count;
+	db4 = crefl_db_new();
+	assert(crefl_db_read_mem(db4, buf2, sz2) != 0);
+	crefl_db_destroy(db4);
+	ents[r].fqn_parent = 0;
+
+	/* unknown section versions are ignored */
+	hdr->flags |= decl_db_flag_hashes_mask;
+	db4 = crefl_db_new();
+	assert(crefl_db_read_mem(db4, buf2, sz2) == 0);
+	assert(db4->hash_entry == NULL);
+	crefl_db_destroy(db4);
+
+	/* appending drops persisted entries */
+	crefl_decl_new(db2, _decl_struct);
+	assert(db2->hash_entry == NULL && db2->hash_count == 0);
+
+	crefl_db_destroy(ref);
+	crefl_db_destroy(db3);
+	crefl_db_destroy(db2);
+	crefl_db_destroy(db);
+	free(buf1);
+	free(buf2);
+}
+
+void t20_merge_adopt()
+{
+	decl_db *srcn[NSOURCES], *srch[NSOURCES];
+	size_t sz, sz1, sz2;
+
+	for (int i = 0; i < NSOURCES; i++) {
+		srcn[i] = new_source(i);
+		srch[i] = new_source(i);
+		assert(crefl_db_link_hashes(srch[i]) == 0);
+		uint8_t *buf = write_image(srch[i], &sz);
+		crefl_db_destroy(srch[i]);
+		srch[i] = crefl_db_new();
+		assert(crefl_db_read_mem(srch[i], buf, sz) == 0);
+		assert(srch[i]->hash_entry != NULL);
+		free(buf);
+	}
+
+	/* merging sources with persisted hashes gives identical output */
+	uint8_t *buf1 = merge_image(srcn, &sz1);
+	uint8_t *buf2 = merge_image(srch, &sz2);
+	assert(sz1 == sz2);
+	assert(memcmp(buf1, buf2, sz1) == 0);
+	free(buf1);
+	free(buf2);
+
+	for (int i = 0; i < NSOURCES; i++) {
+		crefl_db_destroy(srcn[i]);
+		crefl_db_destroy(srch[i]);
+	}
+}
+
+int main()
+{
+	t20_persist_hashes();
+	t20_merge_adopt();
+}
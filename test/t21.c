@@ -0,0 +1,201 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+#include <crefl/link.h>
+
+/* crefl_link_update replaces and appends sources in a merged archive */
+
+#define NSOURCES 8
+
+/* structs s0..s7 shared with other sources plus one private struct */
+static decl_db * new_source(int k, int width)
+{
+	char name[16];
+	decl_db *db = crefl_db_new();
+	crefl_db_defaults(db);
+	decl_ref src = crefl_decl_new(db, _decl_source);
+	snprintf(name, sizeof(name), "src%d.h", k);
+	crefl_decl_ptr(src)->_name = crefl_name_new(db, name);
+	db->root_element = crefl_decl_idx(src);
+
+	decl_ref last = src;
+	for (int i = 0; i < 9; i++) {
+		decl_ref s = crefl_decl_new(db, _decl_struct);
+		if (i < 8) snprintf(name, sizeof(name), "s%d", (i + k) % 8);
+		else snprintf(name, sizeof(name), "p%d", k);
+		crefl_decl_ptr(s)->_name = crefl_name_new(db, name);
+		if (crefl_decl_idx(last) == crefl_decl_idx(src)) {
+			crefl_decl_ptr(src)->_link = crefl_decl_idx(s);
+		} else {
+			crefl_decl_ptr(last)->_next = crefl_decl_idx(s);
+		}
+		decl_ref f = crefl_decl_new(db, _decl_field);
+		crefl_decl_ptr(f)->_name = crefl_name_new(db, "x");
+		crefl_decl_ptr(f)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint,
+			i < 8 ? 8 << ((i + k) % 8 % 4) : width));
+		crefl_decl_ptr(s)->_link = crefl_decl_idx(f);
+		last = s;
+	}
+	return db;
+}
+
+static decl_db * merge(decl_db **srcn, size_t n)
+{
+	decl_db *db = crefl_db_new();
+	assert(crefl_link_merge(db, "t21.refl", srcn, n) == 0);
+	return db;
+}
+
+static size_t count_sources(decl_db *db)
+{
+	size_t n = 0;
+	decl_ref r = crefl_lookup(db, db->root_element);
+	for (decl_ref s = crefl_decl_link(r); crefl_decl_idx(s); s = crefl_decl_next(s)) n++;
+	return n;
+}
+
+static decl_ref find_source(decl_db *db, size_t i)
+{
+	decl_ref r = crefl_lookup(db, db->root_element);
+	decl_ref s = crefl_decl_link(r);
+	while (i-- > 0) s = crefl_decl_next(s);
+	return s;
+}
+
+/* sources of two archives have the same names and hashes */
+static void check_same(decl_db *a, decl_db *b)
+{
+	decl_index *la = crefl_index_new(), *lb = crefl_index_new();
+	crefl_index_scan(la, a);
+	crefl_index_scan(lb, b);
+	assert(count_sources(a) == count_sources(b));
+	for (size_t i = 0; i < count_sources(a); i++) {
+		decl_ref sa = find_source(a, i), sb = find_source(b, i);
+		assert(strcmp(crefl_decl_name(sa), crefl_decl_name(sb)) == 0);
+		assert(memcmp(&crefl_entry_ptr(crefl_entry_ref(la, sa))->hash,
+					  &crefl_entry_ptr(crefl_entry_ref(lb, sb))->hash,
+					  sizeof(decl_hash)) == 0);
+	}
+	crefl_index_destroy(la);
+	crefl_index_destroy(lb);
+}
+
+/* persisted hashes match a scan for every reachable node */
+static void check_hashes(decl_db *db)
+{
+	assert(db->hash_entry != NULL && db->hash_count == db->decl_offset);
+	decl_entry *ents = db->hash_entry;
+	db->hash_entry = NULL;
+	decl_index *ld = crefl_index_new();
+	crefl_index_scan(ld, db);
+	for (size_t i = 0; i < db->decl_offset; i++) {
+		decl_entry *e = crefl_entry_ptr(crefl_entry_ref(ld, crefl_lookup(db, i)));
+		if (!(e->props & decl_entry_valid)) continue;
+		assert(ents[i].props & decl_entry_valid);
+		assert(memcmp(&e->hash, &ents[i].hash, sizeof(decl_hash)) == 0);
+	}
+	crefl_index_destroy(ld);
+	db->hash_entry = ents;
+}
+
+void t21_update()
+{
+	decl_db *srcn[NSOURCES + 1], *upd[2];
+
+	for (int i = 0; i < NSOURCES; i++) srcn[i] = new_source(i, 64);
+	decl_db *db = merge(srcn, NSOURCES);
+	assert(crefl_db_link_hashes(db) == 0);
+	size_t before = db->decl_offset;
+
+	/* replace one source with a changed private struct */
+	upd[0] = new_source(3, 16);
+	assert(crefl_link_update(db, upd, 1, 1) == 0);
+	assert(count_sources(db) == NSOURCES);
+	assert(db->decl_offset - before < upd[0]->decl_offset - upd[0]->root_element);
+	check_hashes(db);
+
+	crefl_db_destroy(srcn[3]);
+	srcn[3] = new_source(3, 16);
+	decl_db *ref = merge(srcn, NSOURCES);
+	check_same(db, ref);
+	crefl_db_destroy(ref);
+
+	/* unchanged sources only append a source node and aliases */
+	before = db->decl_offset;
+	upd[1] = new_source(5, 64);
+	assert(crefl_link_update(db, upd + 1, 1, 1) == 0);
+	assert(db->decl_offset - before == 1 + 9);
+	check_hashes(db);
+
+	/* new sources are appended */
+	srcn[NSOURCES] = new_source(NSOURCES, 32);
+	assert(crefl_link_update(db, srcn + NSOURCES, 1, 1) == 0);
+	ref = merge(srcn, NSOURCES + 1);
+	check_same(db, ref);
+	crefl_db_destroy(ref);
+
+	/* archive inputs apply each of their sources */
+	decl_db *ar = merge(upd, 2);
+	decl_db *db2 = merge(srcn, NSOURCES);
+	assert(crefl_link_update(db2, &ar, 1, 1) == 0);
+	ref = merge(srcn, NSOURCES);
+	check_same(db2, ref);
+	assert(db2->hash_entry == NULL);
+	crefl_db_destroy(ref);
+	crefl_db_destroy(db2);
+
+	/* the target must be an archive */
+	assert(crefl_link_update(srcn[0], upd, 1, 1) < 0);
+
+	crefl_db_destroy(ar);
+	crefl_db_destroy(db);
+	for (int i = 0; i < NSOURCES + 1; i++) crefl_db_destroy(srcn[i]);
+	for (int i = 0; i < 2; i++) crefl_db_destroy(upd[i]);
+}
+
+/* an alias before its target does not name the target */
+void t21_alias_first()
+{
+	/* source { alias -> s::inner; struct s { struct inner { int x; }; }; } */
+	decl_db *db = crefl_db_new();
+	crefl_db_defaults(db);
+	decl_ref src = crefl_decl_new(db, _decl_source);
+	crefl_decl_ptr(src)->_name = crefl_name_new(db, "t21.h");
+	db->root_element = crefl_decl_idx(src);
+	decl_ref a = crefl_decl_new(db, _decl_alias);
+	crefl_decl_ptr(src)->_link = crefl_decl_idx(a);
+	decl_ref s = crefl_decl_new(db, _decl_struct);
+	crefl_decl_ptr(s)->_name = crefl_name_new(db, "s");
+	crefl_decl_ptr(a)->_next = crefl_decl_idx(s);
+	decl_ref inner = crefl_decl_new(db, _decl_struct);
+	crefl_decl_ptr(inner)->_name = crefl_name_new(db, "inner");
+	crefl_decl_ptr(s)->_link = crefl_decl_idx(inner);
+	crefl_decl_ptr(a)->_link = crefl_decl_idx(inner);
+	decl_ref x = crefl_decl_new(db, _decl_field);
+	crefl_decl_ptr(x)->_name = crefl_name_new(db, "x");
+	crefl_decl_ptr(x)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+	crefl_decl_ptr(inner)->_link = crefl_decl_idx(x);
+
+	decl_index *ld = crefl_index_new();
+	crefl_index_scan(ld, db);
+	assert(memcmp(&crefl_entry_ptr(crefl_entry_ref(ld, a))->hash,
+				  &crefl_entry_ptr(crefl_entry_ref(ld, inner))->hash,
+				  sizeof(decl_hash)) == 0);
+	assert(strcmp(crefl_entry_fqn(crefl_entry_ref(ld, inner)), "s::inner") == 0);
+	assert(strcmp(crefl_entry_fqn(crefl_entry_ref(ld, x)), "s::inner::x") == 0);
+	crefl_index_destroy(ld);
+	crefl_db_destroy(db);
+}
+
+int main()
+{
+	t21_update();
+	t21_alias_first();
+}
@@ -0,0 +1,231 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+#include <crefl/link.h>
+
+/* crefl_link_compact drops unreachable nodes and collapses alias chains */
+
+#define NSOURCES 8
+
+/* structs s0..s7 shared with other sources plus one private struct */
+static decl_db * new_source(int k, int width)
+{
+	char name[16];
+	decl_db *db = crefl_db_new();
+	crefl_db_defaults(db);
+	decl_ref src = crefl_decl_new(db, _decl_source);
+	snprintf(name, sizeof(name), "src%d.h", k);
+	crefl_decl_ptr(src)->_name = crefl_name_new(db, name);
+	db->root_element = crefl_decl_idx(src);
+
+	decl_ref last = src;
+	for (int i = 0; i < 9; i++) {
+		decl_ref s = crefl_decl_new(db, _decl_struct);
+		if (i < 8) snprintf(name, sizeof(name), "s%d", (i + k) % 8);
+		else snprintf(name, sizeof(name), "p%d_%d", k, width);
+		crefl_decl_ptr(s)->_name = crefl_name_new(db, name);
+		if (crefl_decl_idx(last) == crefl_decl_idx(src)) {
+			crefl_decl_ptr(src)->_link = crefl_decl_idx(s);
+		} else {
+			crefl_decl_ptr(last)->_next = crefl_decl_idx(s);
+		}
+		decl_ref f = crefl_decl_new(db, _decl_field);
+		crefl_decl_ptr(f)->_name = crefl_name_new(db, "x");
+		crefl_decl_ptr(f)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint,
+			i < 8 ? 8 << ((i + k) % 8 % 4) : width));
+		crefl_decl_ptr(s)->_link = crefl_decl_idx(f);
+		last = s;
+	}
+	return db;
+}
+
+static decl_db * merge(decl_db **srcn, size_t n)
+{
+	decl_db *db = crefl_db_new();
+	assert(crefl_link_merge(db, "t22.refl", srcn, n) == 0);
+	return db;
+}
+
+static decl_hash root_hash(decl_db *db)
+{
+	decl_entry *ents = db->hash_entry;
+	db->hash_entry = NULL;
+	decl_index *ld = crefl_index_new();
+	crefl_index_scan(ld, db);
+	decl_hash h = crefl_entry_ptr(crefl_entry_ref(ld, crefl_root(db)))->hash;
+	crefl_index_destroy(ld);
+	db->hash_entry = ents;
+	return h;
+}
+
+static int has_name(decl_db *db, const char *name)
+{
+	for (size_t o = 1; o < db->name_offset; o += strlen(db->name + o) + 1) {
+		if (strcmp(db->name + o, name) == 0) return 1;
+	}
+	return 0;
+}
+
+void t22_compact()
+{
+	decl_db *srcn[NSOURCES], *upd[2];
+
+	for (int i = 0; i < NSOURCES; i++) srcn[i] = new_source(i, 64);
+	decl_db *db = merge(srcn, NSOURCES);
+	assert(crefl_db_link_hashes(db) == 0);
+
+	upd[0] = new_source(3, 16);
+	upd[1] = new_source(6, 32);
+	assert(crefl_link_update(db, upd, 2, 1) == 0);
+	assert(has_name(db, "p3_64") && has_name(db, "p6_64"));
+	decl_hash h = root_hash(db);
+	size_t before = db->decl_offset, size = crefl_db_size(db);
+
+	/* replaced sources and their private structs are dropped */
+	assert(crefl_link_compact(db) == 0);
+	assert(db->decl_offset < before && crefl_db_size(db) < size);
+	assert(!has_name(db, "p3_64") && !has_name(db, "p6_64"));
+	assert(has_name(db, "p3_16") && has_name(db, "p6_32"));
+	assert(crefl_db_check_links(db) == 0);
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db, "p3_16::x")) != 0);
+
+	/* identical content, hashes are kept and match a rescan */
+	decl_hash g = root_hash(db);
+	assert(memcmp(&h, &g, sizeof(h)) == 0);
+	assert(db->hash_entry && db->hash_count == db->decl_offset);
+	assert(memcmp(&db->hash_entry[db->root_element].hash, &g, sizeof(g)) == 0);
+
+	/* same size as merging the updated sources from scratch */
+	crefl_db_destroy(srcn[3]);
+	crefl_db_destroy(srcn[6]);
+	srcn[3] = new_source(3, 16);
+	srcn[6] = new_source(6, 32);
+	decl_db *ref = merge(srcn, NSOURCES);
+	g = root_hash(ref);
+	assert(memcmp(&h, &g, sizeof(h)) == 0);
+	assert(db->decl_offset <= ref->decl_offset);
+	crefl_db_destroy(ref);
+
+	/* compacting again changes nothing */
+	before = db->decl_offset;
+	assert(crefl_link_compact(db) == 0);
+	assert(db->decl_offset == before);
+
+	crefl_db_destroy(db);
+	for (int i = 0; i < NSOURCES; i++) crefl_db_destroy(srcn[i]);
+	for (int i = 0; i < 2; i++) crefl_db_destroy(upd[i]);
+}
+
+void t22_alias_chain()
+{
+	decl_db *db = crefl_db_new();
+	crefl_db_defaults(db);
+	decl_ref src = crefl_decl_new(db, _decl_source);
+	crefl_decl_ptr(src)->_name = crefl_name_new(db, "a.h");
+	db->root_element = crefl_decl_idx(src);
+	decl_ref s = crefl_decl_new(db, _decl_struct);
+	crefl_decl_ptr(s)->_name = crefl_name_new(db, "s");
+	decl_ref a1 = crefl_decl_new(db, _decl_alias);
+	crefl_decl_ptr(a1)->_link = crefl_decl_idx(s);
+	decl_ref a2 = crefl_decl_new(db, _decl_alias);
+	crefl_decl_ptr(a2)->_link = crefl_decl_idx(a1);
+	decl_ref a3 = crefl_decl_new(db, _decl_alias);
+	crefl_decl_ptr(a3)->_link = crefl_decl_idx(a2);
+	decl_ref orphan = crefl_decl_new(db, _decl_struct);
+	crefl_decl_ptr(orphan)->_name = crefl_name_new(db, "orphan");
+	crefl_decl_ptr(src)->_link = crefl_decl_idx(s);
+	crefl_decl_ptr(s)->_next = crefl_decl_idx(a3);
+
+	assert(crefl_link_compact(db) == 0);
+	assert(db->decl_offset == db->decl_builtin + 3);
+	assert(!has_name(db, "orphan"));
+	decl_ref r = crefl_root(db);
+	decl_ref t = crefl_decl_link(r);
+	decl_ref a = crefl_decl_next(t);
+	assert(crefl_is_struct(t) && strcmp(crefl_decl_name(t), "s") == 0);
+	assert(crefl_is_alias(a));
+	assert(crefl_decl_idx(crefl_decl_link(a)) == crefl_decl_idx(t));
+
+	/* round trip through an image */
+	size_t sz = crefl_db_size(db);
+	uint8_t *buf = malloc(sz);
+	assert(crefl_db_write_mem(db, buf, sz) == 0);
+	decl_db *db2 = crefl_db_new();
+	assert(crefl_db_read_mem(db2, buf, sz) == 0);
+	assert(db2->decl_offset == db->decl_offset);
+	crefl_db_destroy(db2);
+	free(buf);
+
+	crefl_db_destroy(db);
+}
+
+/* a node of a replaced source reached through an alias keeps no siblings */
+void t22_shared_node()
+{
+	/* archive { new.h { alias -> keep; fresh } }, old.h { keep; gone1; gone2 } */
+	decl_db *db = crefl_db_new();
+	crefl_db_defaults(db);
+	decl_ref ar = crefl_decl_new(db, _decl_archive);
+	crefl_decl_ptr(ar)->_name = crefl_name_new(db, "t22.refl");
+	db->root_element = crefl_decl_idx(ar);
+	decl_ref old = crefl_decl_new(db, _decl_source);
+	crefl_decl_ptr(old)->_name = crefl_name_new(db, "old.h");
+	decl_ref last = old;
+	const char *names[] = { "keep", "gone1", "gone2" };
+	decl_ref keep;
+	for (int i = 0; i < 3; i++) {
+		decl_ref s = crefl_decl_new(db, _decl_struct);
+		crefl_decl_ptr(s)->_name = crefl_name_new(db, names[i]);
+		if (i == 0) crefl_decl_ptr(last)->_link = crefl_decl_idx(s);
+		else crefl_decl_ptr(last)->_next = crefl_decl_idx(s);
+		if (i == 0) keep = s;
+		last = s;
+	}
+	decl_ref src = crefl_decl_new(db, _decl_source);
+	crefl_decl_ptr(src)->_name = crefl_name_new(db, "new.h");
+	crefl_decl_ptr(ar)->_link = crefl_decl_idx(src);
+	decl_ref a = crefl_decl_new(db, _decl_alias);
+	crefl_decl_ptr(a)->_link = crefl_decl_idx(keep);
+	crefl_decl_ptr(src)->_link = crefl_decl_idx(a);
+	decl_ref fresh = crefl_decl_new(db, _decl_struct);
+	crefl_decl_ptr(fresh)->_name = crefl_name_new(db, "fresh");
+	crefl_decl_ptr(a)->_next = crefl_decl_idx(fresh);
+
+	/* frozen dbs are not compacted */
+	assert(crefl_db_freeze(db) == 0);
+	assert(crefl_link_compact(db) != 0);
+
+	/* compacting a mapped image does not write to the mapping */
+	assert(crefl_db_write_file(db, "t22.refl") == 0);
+	crefl_db_destroy(db);
+	db = crefl_db_open_mmap("t22.refl");
+	assert(db != NULL);
+	assert(crefl_link_compact(db) == 0);
+	remove("t22.refl");
+
+	assert(db->decl_offset == db->decl_builtin + 5);
+	assert(!has_name(db, "old.h"));
+	assert(!has_name(db, "gone1") && !has_name(db, "gone2"));
+	assert(crefl_db_check_links(db) == 0);
+	a = crefl_decl_link(crefl_decl_link(crefl_root(db)));
+	keep = crefl_decl_link(a);
+	assert(crefl_is_alias(a) && strcmp(crefl_decl_name(keep), "keep") == 0);
+	assert(crefl_decl_ptr(keep)->_next == 0);
+	assert(strcmp(crefl_decl_name(crefl_decl_next(a)), "fresh") == 0);
+
+	crefl_db_destroy(db);
+}
+
+int main()
+{
+	t22_compact();
+	t22_alias_chain();
+	t22_shared_node();
+}
@@ -0,0 +1,146 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+#include <crefl/link.h>
+
+/* crefl_link_optimize_layout places children after their parent */
+
+#define NSTRUCTS 16
+#define NFIELDS 4
+
+/* struct nodes first, then fields interleaved across structs */
+static decl_db * new_scattered(const char *src_name)
+{
+	char name[16];
+	decl_ref st[NSTRUCTS], last[NSTRUCTS];
+	decl_db *db = crefl_db_new();
+	crefl_db_defaults(db);
+	decl_ref src = crefl_decl_new(db, _decl_source);
+	crefl_decl_ptr(src)->_name = crefl_name_new(db, src_name);
+	db->root_element = crefl_decl_idx(src);
+
+	for (int i = 0; i < NSTRUCTS; i++) {
+		st[i] = last[i] = crefl_decl_new(db, _decl_struct);
+		snprintf(name, sizeof(name), "s%d", i);
+		crefl_decl_ptr(st[i])->_name = crefl_name_new(db, name);
+		if (i) crefl_decl_ptr(st[i - 1])->_next = crefl_decl_idx(st[i]);
+		else crefl_decl_ptr(src)->_link = crefl_decl_idx(st[i]);
+	}
+	for (int j = 0; j < NFIELDS; j++) {
+		for (int k = 0; k < NSTRUCTS; k++) {
+			int i = k * 5 % NSTRUCTS;
+			decl_ref f = crefl_decl_new(db, _decl_field);
+			snprintf(name, sizeof(name), "f%d", j);
+			crefl_decl_ptr(f)->_name = crefl_name_new(db, name);
+			crefl_decl_ptr(f)->_link = crefl_decl_idx(
+				crefl_intrinsic(db, _decl_sint, 8 << j));
+			if (j) crefl_decl_ptr(last[i])->_next = crefl_decl_idx(f);
+			else crefl_decl_ptr(st[i])->_link = crefl_decl_idx(f);
+			last[i] = f;
+		}
+	}
+	/* a field of s0 links to s1 by value and s2 has an attribute */
+	crefl_decl_ptr(last[0])->_link = crefl_decl_idx(st[1]);
+	decl_ref a = crefl_decl_new(db, _decl_attribute);
+	crefl_decl_ptr(a)->_name = crefl_name_new(db, "packed");
+	crefl_decl_ptr(st[2])->_attr = crefl_decl_idx(a);
+	return db;
+}
+
+static decl_hash root_hash(decl_db *db)
+{
+	decl_entry *ents = db->hash_entry;
+	db->hash_entry = NULL;
+	decl_index *ld = crefl_index_new();
+	crefl_index_scan(ld, db);
+	decl_hash h = crefl_entry_ptr(crefl_entry_ref(ld, crefl_root(db)))->hash;
+	crefl_index_destroy(ld);
+	db->hash_entry = ents;
+	return h;
+}
+
+void t23_layout()
+{
+	decl_db *db = new_scattered("a.h");
+	assert(crefl_db_link_hashes(db) == 0);
+	decl_hash h = root_hash(db);
+	size_t nodes = db->decl_offset, size = crefl_db_size(db);
+
+	assert(crefl_link_optimize_layout(db) == 0);
+	assert(db->decl_offset == nodes && crefl_db_size(db) <= size);
+	assert(crefl_db_check_links(db) == 0);
+
+	/* the root is followed by its structs, then by the fields of s0 */
+	decl_id next = db->root_element + 1;
+	decl_ref r = crefl_root(db);
+	for (decl_ref s = crefl_decl_link(r); crefl_decl_idx(s); s = crefl_decl_next(s)) {
+		assert(crefl_decl_idx(s) == next++);
+	}
+	decl_ref s0 = crefl_decl_link(r);
+	for (decl_ref f = crefl_decl_link(s0); crefl_decl_idx(f); f = crefl_decl_next(f)) {
+		assert(crefl_decl_idx(f) == next++);
+	}
+	/* then by the fields of s1, then the attribute and fields of s2 */
+	decl_ref s1 = crefl_decl_next(s0), s2 = crefl_decl_next(s1);
+	assert(crefl_decl_idx(crefl_decl_link(s1)) == next);
+	next += NFIELDS;
+	assert(crefl_decl_idx(crefl_decl_attr(s2)) == next++);
+	assert(strcmp(crefl_decl_name(crefl_decl_attr(s2)), "packed") == 0);
+	assert(crefl_decl_idx(crefl_decl_link(s2)) == next);
+
+	/* hashes are kept and match a rescan */
+	decl_hash g = root_hash(db);
+	assert(memcmp(&h, &g, sizeof(h)) == 0);
+	assert(db->hash_entry && db->hash_count == db->decl_offset);
+	assert(memcmp(&db->hash_entry[db->root_element].hash, &g, sizeof(g)) == 0);
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db, "s3::f2")) != 0);
+
+	/* a second pass changes nothing */
+	size_t sz = crefl_db_size(db);
+	uint8_t *b1 = malloc(sz), *b2 = malloc(sz);
+	assert(crefl_db_write_mem(db, b1, sz) == 0);
+	assert(crefl_link_optimize_layout(db) == 0);
+	assert(crefl_db_write_mem(db, b2, sz) == 0);
+	assert(memcmp(b1, b2, sz) == 0);
+	free(b1);
+	free(b2);
+
+	/* frozen dbs are not reordered */
+	assert(crefl_db_freeze(db) == 0);
+	assert(crefl_link_optimize_layout(db) != 0);
+
+	crefl_db_destroy(db);
+}
+
+void t23_archive()
+{
+	decl_db *srcn[2] = { new_scattered("a.h"), new_scattered("b.h") };
+	decl_db *db = crefl_db_new();
+	assert(crefl_link_merge(db, "t23.refl", srcn, 2) == 0);
+	decl_hash h = root_hash(db);
+	size_t nodes = db->decl_offset;
+
+	assert(crefl_link_optimize_layout(db) == 0);
+	assert(db->decl_offset == nodes);
+	assert(crefl_db_check_links(db) == 0);
+	decl_hash g = root_hash(db);
+	assert(memcmp(&h, &g, sizeof(h)) == 0);
+	assert(db->hash_entry == NULL);
+
+	crefl_db_destroy(db);
+	crefl_db_destroy(srcn[0]);
+	crefl_db_destroy(srcn[1]);
+}
+
+int main()
+{
+	t23_layout();
+	t23_archive();
+}
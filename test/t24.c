@@ -0,0 +1,79 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+
+/* column mode queries return the same nodes as node scans */
+
+static void check_tag(decl_db *db, decl_tag tag)
+{
+	decl_ref r1[64], r2[64];
+	size_t s1 = 64, s2 = 64;
+
+	crefl_db_set_columns(db, 0);
+	assert(crefl_db_tag_decls(db, tag, r1, &s1) == 0);
+	crefl_db_set_columns(db, 1);
+	assert(crefl_db_tag_decls(db, tag, r2, &s2) == 0);
+	assert(s1 == s2);
+	for (size_t i = 0; i < s1 && i < 64; i++) {
+		assert(crefl_decl_idx(r1[i]) == crefl_decl_idx(r2[i]));
+		assert(crefl_decl_tag(r2[i]) == tag);
+	}
+}
+
+void t24_columns()
+{
+	decl_db *db = crefl_db_new();
+	crefl_db_defaults(db);
+	size_t builtin_intrinsics = 0;
+	crefl_db_tag_decls(db, _decl_intrinsic, NULL, &builtin_intrinsics);
+	assert(builtin_intrinsics > 0);
+
+	for (int i = 0; i < 37; i++) {
+		decl_ref d = crefl_decl_new(db, i % 3 ? _decl_field : _decl_struct);
+		crefl_decl_ptr(d)->_quantity = i;
+	}
+	check_tag(db, _decl_struct);
+	check_tag(db, _decl_field);
+	check_tag(db, _decl_intrinsic);
+	check_tag(db, _decl_union);
+
+	/* counts without output and truncated output */
+	size_t s = 0;
+	crefl_db_tag_decls(db, _decl_struct, NULL, &s);
+	assert(s == 13);
+	decl_ref r[4];
+	s = 4;
+	crefl_db_tag_decls(db, _decl_struct, r, &s);
+	assert(s == 13 && crefl_is_struct(r[3]));
+
+	/* appended nodes are visible to column scans */
+	crefl_decl_new(db, _decl_struct);
+	s = 0;
+	crefl_db_tag_decls(db, _decl_struct, NULL, &s);
+	assert(s == 14);
+
+	/* intrinsic queries outside the builtin classes use the columns */
+	decl_ref d = crefl_decl_new(db, _decl_intrinsic);
+	crefl_decl_ptr(d)->_props = _decl_sint | _decl_pad_byte;
+	crefl_decl_ptr(d)->_width = 24;
+	decl_ref q = crefl_intrinsic(db, _decl_sint, 24);
+	assert(crefl_decl_idx(q) == crefl_decl_idx(d));
+	crefl_db_set_columns(db, 0);
+	assert(crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 24)) == crefl_decl_idx(d));
+	crefl_db_set_columns(db, 1);
+	assert(crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 48)) == 0);
+
+	crefl_db_destroy(db);
+}
+
+int main()
+{
+	t24_columns();
+}
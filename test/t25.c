@@ -0,0 +1,125 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+#include <crefl/link.h>
+
+/* crefl_db_set_packed round trips the decl table */
+
+static decl_ref new_named(decl_db *db, decl_tag tag, const char *name)
+{
+	decl_ref r = crefl_decl_new(db, tag);
+	crefl_decl_ptr(r)->_name = crefl_name_new(db, name);
+	return r;
+}
+
+static uint8_t * write_image(decl_db *db, int packed, size_t *sz)
+{
+	crefl_db_set_packed(db, packed);
+	*sz = crefl_db_size(db);
+	uint64_t *image = (uint64_t*)malloc(*sz);
+	assert(crefl_db_write_mem(db, (uint8_t*)image, *sz) == 0);
+	return (uint8_t*)image;
+}
+
+static void check_same(decl_db *a, decl_db *b)
+{
+	assert(a->decl_offset == b->decl_offset);
+	assert(a->name_offset == b->name_offset);
+	assert(a->root_element == b->root_element);
+	assert(memcmp(a->decl, b->decl, sizeof(decl_node) * a->decl_offset) == 0);
+	assert(memcmp(a->name, b->name, a->name_offset) == 0);
+}
+
+void t25_packed()
+{
+	decl_db *db = crefl_db_new();
+	crefl_db_defaults(db);
+
+	/* source { struct s { int a, b; }; enum e { x = -1, y = 2 }; } */
+	decl_ref src = new_named(db, _decl_source, "t25.h");
+	db->root_element = crefl_decl_idx(src);
+	decl_ref s = new_named(db, _decl_struct, "s");
+	crefl_decl_ptr(src)->_link = crefl_decl_idx(s);
+	decl_ref a = new_named(db, _decl_field, "a");
+	decl_ref b = new_named(db, _decl_field, "b");
+	crefl_decl_ptr(s)->_link = crefl_decl_idx(a);
+	crefl_decl_ptr(a)->_next = crefl_decl_idx(b);
+	crefl_decl_ptr(a)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+	crefl_decl_ptr(b)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+	decl_ref e = new_named(db, _decl_enum, "e");
+	crefl_decl_ptr(s)->_next = crefl_decl_idx(e);
+	decl_ref x = new_named(db, _decl_constant, "x");
+	decl_ref y = new_named(db, _decl_constant, "y");
+	crefl_decl_ptr(e)->_link = crefl_decl_idx(x);
+	crefl_decl_ptr(x)->_next = crefl_decl_idx(y);
+	crefl_decl_ptr(x)->_value = (u64)-1;
+	crefl_decl_ptr(y)->_value = 2;
+	assert(crefl_db_link_hashes(db) == 0);
+
+	size_t raw_sz, packed_sz;
+	uint8_t *raw = write_image(db, 0, &raw_sz);
+	uint8_t *packed = write_image(db, 1, &packed_sz);
+	assert(packed_sz < raw_sz);
+	assert(((decl_db_hdr*)packed)->flags & decl_db_flag_packed);
+	assert(!(((decl_db_hdr*)raw)->flags & decl_db_flag_packed));
+
+	/* packed images read back with hashes and large quantities */
+	decl_db *db1 = crefl_db_new();
+	assert(crefl_db_read_mem(db1, packed, packed_sz) == 0);
+	check_same(db, db1);
+	assert(db1->packed);
+	assert(db1->hash_entry != NULL && db1->hash_count == db->decl_offset);
+	assert(memcmp(db1->hash_entry, db->hash_entry,
+		sizeof(decl_entry) * db->decl_offset) == 0);
+	decl_ref x1 = crefl_lookup_by_fqn(db1, "e::x");
+	assert(crefl_decl_idx(x1) == crefl_decl_idx(x));
+	assert(crefl_constant_value(x1).ux == (u64)-1);
+
+	/* rewriting a packed db gives the same image */
+	size_t sz;
+	uint8_t *again = write_image(db1, 1, &sz);
+	assert(sz == packed_sz && memcmp(again, packed, sz) == 0);
+	free(again);
+	crefl_db_destroy(db1);
+
+	/* raw images still read */
+	decl_db *db2 = crefl_db_new();
+	assert(crefl_db_read_mem(db2, raw, raw_sz) == 0);
+	check_same(db, db2);
+	assert(!db2->packed);
+	crefl_db_destroy(db2);
+
+	/* packed images are copied by attach */
+	decl_db *db3 = crefl_db_attach_mem(packed, packed_sz);
+	assert(db3 != NULL);
+	assert(db3->map_addr == NULL);
+	check_same(db, db3);
+	crefl_db_destroy(db3);
+
+	/* truncated and corrupt packed tables are rejected */
+	decl_db *db4 = crefl_db_new();
+	assert(crefl_db_read_mem(db4, packed, packed_sz - 1) < 0);
+	crefl_db_destroy(db4);
+
+	uint32_t *dict_cnt = (uint32_t*)(packed + sizeof(decl_db_hdr) + 4);
+	*dict_cnt = 0;
+	decl_db *db5 = crefl_db_new();
+	assert(crefl_db_read_mem(db5, packed, packed_sz) < 0);
+	crefl_db_destroy(db5);
+
+	free(raw);
+	free(packed);
+	crefl_db_destroy(db);
+}
+
+int main()
+{
+	t25_packed();
+}
@@ -0,0 +1,89 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+
+/* crefl_db_defaults copies the shared builtin segment */
+
+static void check_builtins(decl_db *db, const decl_db *b)
+{
+	assert(db->decl_builtin == b->decl_builtin);
+	assert(db->name_builtin == b->name_builtin);
+	assert(memcmp(db->decl, b->decl, sizeof(decl_node) * b->decl_builtin) == 0);
+	assert(memcmp(db->name, b->name, b->name_builtin) == 0);
+	decl_ref i32 = crefl_intrinsic(db, _decl_sint, 32);
+	assert(crefl_decl_idx(i32) != 0 && crefl_decl_idx(i32) < db->decl_builtin);
+	assert(crefl_decl_qty(i32) == 32);
+}
+
+void t26_builtin()
+{
+	const decl_db *b = crefl_db_builtin();
+	assert(b == crefl_db_builtin());
+	assert(b->decl_offset == b->decl_builtin && b->decl_builtin > 1);
+	assert(b->intrinsic_map != NULL);
+
+	/* empty dbs share the intrinsic map but own their tables */
+	decl_db *db1 = crefl_db_new(), *db2 = crefl_db_new();
+	crefl_db_defaults(db1);
+	crefl_db_defaults(db2);
+	check_builtins(db1, b);
+	check_builtins(db2, b);
+	assert(db1->intrinsic_map == b->intrinsic_map);
+	assert(db2->intrinsic_map == b->intrinsic_map);
+	assert(db1->decl != b->decl && db1->name != b->name);
+
+	/* appending to a db leaves the segment unchanged */
+	decl_ref s = crefl_decl_new(db1, _decl_struct);
+	crefl_decl_ptr(s)->_name = crefl_name_new(db1, "s");
+	db1->root_element = crefl_decl_idx(s);
+	assert(b->decl_offset == b->decl_builtin && b->name_offset == b->name_builtin);
+	check_builtins(db2, b);
+
+	/* interning dbs build their own builtins with the same layout */
+	decl_db *db3 = crefl_db_new();
+	crefl_db_set_intern(db3, 1);
+	crefl_db_defaults(db3);
+	check_builtins(db3, b);
+	assert(db3->intrinsic_map != b->intrinsic_map);
+
+	/* read and attach use the segment and check builtin compatibility */
+	size_t sz = crefl_db_size(db1);
+	uint64_t *image = (uint64_t*)malloc(sz);
+	uint8_t *buf = (uint8_t*)image;
+	assert(crefl_db_write_mem(db1, buf, sz) == 0);
+	decl_db *db4 = crefl_db_new();
+	assert(crefl_db_read_mem(db4, buf, sz) == 0);
+	check_builtins(db4, b);
+	assert(db4->intrinsic_map == b->intrinsic_map);
+	decl_db *db5 = crefl_db_attach_mem(buf, sz);
+	assert(db5 != NULL);
+	check_builtins(db5, b);
+	assert(db5->intrinsic_map == b->intrinsic_map);
+	assert(crefl_decl_idx(crefl_lookup_by_name(db5, "s")) == crefl_decl_idx(s));
+	crefl_db_destroy(db5);
+
+	decl_node *n = (decl_node*)(buf + sizeof(decl_db_hdr)) + b->decl_builtin - 1;
+	n->_width ^= 1;
+	decl_db *db6 = crefl_db_new();
+	assert(crefl_db_read_mem(db6, buf, sz) < 0);
+	assert(crefl_db_attach_mem(buf, sz) == NULL);
+
+	free(image);
+	crefl_db_destroy(db1);
+	crefl_db_destroy(db2);
+	crefl_db_destroy(db3);
+	crefl_db_destroy(db4);
+	crefl_db_destroy(db6);
+}
+
+int main()
+{
+	t26_builtin();
+}
@@ -0,0 +1,81 @@
+#undef NDEBUG
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+
+#include <thread>
+#include <vector>
+#include <memory>
+
+#include <crefl/shardmap.h>
+
+/* shardmap insert_if_absent agrees on one winner per key across threads */
+
+static const size_t nthreads = 8;
+static const size_t nkeys = 100000;
+
+typedef shardmap<uint64_t,uint64_t> map_t;
+
+static uint64_t key_of(size_t i) { return i * 0x9e3779b97f4a7c15ull + 1; }
+
+void t27_shardmap()
+{
+	std::unique_ptr<map_t> map(new map_t());
+	std::vector<std::vector<uint64_t>> won(nthreads);
+	std::vector<std::thread> threads;
+
+	/* each thread inserts all keys in a different order with its own value */
+	for (size_t t = 0; t < nthreads; t++) {
+		won[t].resize(nkeys);
+		threads.emplace_back([&, t] {
+			for (size_t n = 0; n < nkeys; n++) {
+				size_t i = (n * 7919 + t * 104729) % nkeys;
+				won[t][i] = map->insert_if_absent(key_of(i), (t << 32) | i);
+			}
+		});
+	}
+	for (auto &th : threads) th.join();
+	threads.clear();
+
+	assert(map->size() == nkeys);
+	for (size_t i = 0; i < nkeys; i++) {
+		uint64_t v;
+		assert(map->find(key_of(i), &v));
+		assert((v & 0xffffffff) == i && (v >> 32) < nthreads);
+		for (size_t t = 0; t < nthreads; t++) assert(won[t][i] == v);
+	}
+
+	/* concurrent erase, insert and find on disjoint key ranges */
+	for (size_t t = 0; t < nthreads; t++) {
+		threads.emplace_back([&, t] {
+			for (size_t i = t; i < nkeys; i += nthreads) {
+				uint64_t v;
+				if (i & 1) {
+					map->erase(key_of(i));
+					assert(!map->find(key_of(i), &v));
+				} else {
+					map->insert(key_of(i), i);
+					assert(map->find(key_of(i), &v) && v == i);
+				}
+			}
+		});
+	}
+	for (auto &th : threads) th.join();
+
+	size_t count = 0;
+	map->for_each([&](uint64_t k, uint64_t v) {
+		assert(k == key_of(v) && (v & 1) == 0);
+		count++;
+	});
+	assert(count == nkeys / 2 && map->size() == nkeys / 2);
+
+	map->clear();
+	assert(map->size() == 0);
+}
+
+int main()
+{
+	t27_shardmap();
+}
@@ -0,0 +1,221 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+#include <crefl/link.h>
+
+/* crefl_db_set_index lookups probe the image section in place */
+
+#define DB_FILE "t28.refl"
+
+static decl_ref new_named(decl_db *db, decl_tag tag, const char *name)
+{
+	decl_ref r = crefl_decl_new(db, tag);
+	crefl_decl_ptr(r)->_name = crefl_name_new(db, name);
+	return r;
+}
+
+static uint8_t * write_image(decl_db *db, int index, size_t *sz)
+{
+	crefl_db_set_index(db, index);
+	*sz = crefl_db_size(db);
+	uint64_t *image = (uint64_t*)malloc(*sz);
+	assert(crefl_db_write_mem(db, (uint8_t*)image, *sz) == 0);
+	return (uint8_t*)image;
+}
+
+static const char *fqns[] = {
+	"t28.h", "s", "s::a", "s::b", "e", "e::x", "struct s", "enum e",
+	"int", "missing", "s::missing", "field s::a"
+};
+
+/* lookups on db2 agree with the name index of db */
+static void check_lookups(decl_db *db, decl_db *db2)
+{
+	for (size_t i = 0; i < sizeof(fqns)/sizeof(fqns[0]); i++) {
+		assert(crefl_decl_idx(crefl_lookup_by_fqn(db2, fqns[i])) ==
+			   crefl_decl_idx(crefl_lookup_by_fqn(db, fqns[i])));
+	}
+	for (size_t i = 1; i < db->decl_offset; i++) {
+		const decl_entry *e = db->hash_entry + i;
+		if (!(e->props & decl_entry_valid)) continue;
+		decl_ref d = crefl_lookup_by_hash(db2, &e->hash);
+		assert(crefl_decl_idx(d) != 0);
+		assert(memcmp(&db->hash_entry[crefl_decl_idx(d)].hash, &e->hash,
+			sizeof(decl_hash)) == 0);
+		assert(crefl_decl_idx(d) == crefl_decl_idx(crefl_lookup_by_hash(db, &e->hash)));
+	}
+	decl_hash missing;
+	memset(&missing, 0x5a, sizeof(missing));
+	assert(crefl_decl_idx(crefl_lookup_by_hash(db2, &missing)) == 0);
+}
+
+void t28_index()
+{
+	decl_db *db = crefl_db_new();
+	crefl_db_defaults(db);
+
+	/* source { struct s { int a, b; }; enum e { x, y }; } */
+	decl_ref src = new_named(db, _decl_source, "t28.h");
+	db->root_element = crefl_decl_idx(src);
+	decl_ref s = new_named(db, _decl_struct, "s");
+	crefl_decl_ptr(src)->_link = crefl_decl_idx(s);
+	decl_ref a = new_named(db, _decl_field, "a");
+	decl_ref b = new_named(db, _decl_field, "b");
+	crefl_decl_ptr(s)->_link = crefl_decl_idx(a);
+	crefl_decl_ptr(a)->_next = crefl_decl_idx(b);
+	crefl_decl_ptr(a)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+	crefl_decl_ptr(b)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+	decl_ref e = new_named(db, _decl_enum, "e");
+	crefl_decl_ptr(s)->_next = crefl_decl_idx(e);
+	decl_ref x = new_named(db, _decl_constant, "x");
+	decl_ref y = new_named(db, _decl_constant, "y");
+	crefl_decl_ptr(e)->_link = crefl_decl_idx(x);
+	crefl_decl_ptr(x)->_next = crefl_decl_idx(y);
+	crefl_decl_ptr(y)->_value = 1;
+	assert(crefl_db_link_hashes(db) == 0);
+
+	size_t plain_sz, index_sz;
+	uint8_t *plain = write_image(db, 0, &plain_sz);
+	uint8_t *image = write_image(db, 1, &index_sz);
+	assert(index_sz > plain_sz);
+	assert(!(((decl_db_hdr*)plain)->flags & decl_db_flag_index_mask));
+	assert((((decl_db_hdr*)image)->flags & decl_db_flag_index_mask) ==
+		decl_db_index_version << decl_db_flag_index_shift);
+
+	/* copying read adopts a heap copy of the section */
+	decl_db *db1 = crefl_db_new();
+	assert(crefl_db_read_mem(db1, image, index_sz) == 0);
+	assert(db1->indexed && db1->lookup != NULL && !db1->lookup_image);
+	check_lookups(db, db1);
+	assert(db1->name_index == NULL);
+	assert(crefl_db_size(db1) == index_sz);
+	crefl_db_destroy(db1);
+
+	/* attach probes the section in the image */
+	decl_db *db2 = crefl_db_attach_mem(image, index_sz);
+	assert(db2 != NULL && db2->lookup_image);
+	assert((const uint8_t*)db2->lookup > image &&
+		   (const uint8_t*)db2->lookup < image + index_sz);
+	check_lookups(db, db2);
+	assert(db2->name_index == NULL);
+
+	/* appending drops the section and falls back to the name index */
+	decl_ref c = new_named(db2, _decl_field, "c");
+	assert(db2->lookup == NULL);
+	crefl_decl_ptr(crefl_lookup(db2, crefl_decl_idx(b)))->_next = crefl_decl_idx(c);
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db2, "s::c")) == crefl_decl_idx(c));
+	crefl_db_destroy(db2);
+
+	/* images without the section still use the name index */
+	decl_db *db3 = crefl_db_attach_mem(plain, plain_sz);
+	assert(db3 != NULL && db3->lookup == NULL);
+	check_lookups(db, db3);
+	crefl_db_destroy(db3);
+
+	/* mapped images */
+	crefl_db_set_index(db, 1);
+	assert(crefl_db_write_file(db, DB_FILE) == 0);
+	decl_db *db4 = crefl_db_open_mmap(DB_FILE);
+	assert(db4 != NULL && db4->lookup != NULL);
+	check_lookups(db, db4);
+	crefl_db_destroy(db4);
+	remove(DB_FILE);
+
+	/* a slot out of bounds is rejected by the full check */
+	const decl_db_index_hdr *ih = (const decl_db_index_hdr*)
+		(image + index_sz - crefl_db_index_size(db));
+	assert(ih->decl_count == db->decl_offset);
+	assert(crefl_db_index_section_size(ih) == crefl_db_index_size(db));
+	uint8_t *bad = (uint8_t*)malloc(index_sz);
+	memcpy(bad, image, index_sz);
+	decl_db_index_hdr *bh = (decl_db_index_hdr*)(bad + ((const uint8_t*)ih - image));
+	uint32_t *slot = (uint32_t*)((uint8_t*)(bh + 1) + ((bh->hash_limit + 31) >> 5 << 3));
+	for (size_t i = 0; i < bh->hash_limit; i++) slot[i] = 0xffff;
+	decl_db *db5 = crefl_db_new();
+	assert(crefl_db_read_mem(db5, bad, index_sz) != 0);
+	crefl_db_destroy(db5);
+
+	/* invalid limits are rejected before the section is read */
+	memcpy(bad, image, index_sz);
+	bh->fqn_limit = 3;
+	db5 = crefl_db_new();
+	assert(crefl_db_read_mem(db5, bad, index_sz) != 0);
+	crefl_db_destroy(db5);
+
+	/* full tables are rejected, and probes of unchecked ones end */
+	memcpy(bad, image, index_sz);
+	size_t fqn_bitmap = ((uint8_t*)(slot + bh->hash_limit) - (uint8_t*)bh + 7) & ~7;
+	memset((uint8_t*)(bh + 1), 0x55, (bh->hash_limit + 31) >> 5 << 3);
+	memset((uint8_t*)bh + fqn_bitmap, 0x55, (bh->fqn_limit + 31) >> 5 << 3);
+	decl_hash missing;
+	memset(&missing, 0x5a, sizeof(missing));
+	db5 = crefl_db_new();
+	assert(crefl_db_read_mem(db5, bad, index_sz) != 0);
+	crefl_db_destroy(db5);
+	crefl_db_set_check(crefl_db_check_defer);
+	db5 = crefl_db_new();
+	assert(crefl_db_read_mem(db5, bad, index_sz) == 0 && db5->lookup != NULL);
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db5, "missing")) == 0);
+	assert(crefl_decl_idx(crefl_lookup_by_hash(db5, &missing)) == 0);
+	crefl_db_destroy(db5);
+	crefl_db_set_check(crefl_db_check_full);
+
+	/* truncated sections are rejected */
+	db5 = crefl_db_new();
+	assert(crefl_db_read_mem(db5, image, index_sz - 8) != 0);
+	crefl_db_destroy(db5);
+
+	free(bad);
+	free(plain);
+	free(image);
+	crefl_db_destroy(db);
+}
+
+void t28_deep()
+{
+	decl_db *db = crefl_db_new();
+	crefl_db_defaults(db);
+
+	/* source { typedef t<n-1> -> ... -> typedef t0 -> int } */
+	const int n = 100000;
+	decl_ref src = new_named(db, _decl_source, "t28.h");
+	db->root_element = crefl_decl_idx(src);
+	decl_ref link = crefl_intrinsic(db, _decl_sint, 32);
+	char name[16];
+	for (int i = 0; i < n; i++) {
+		snprintf(name, sizeof(name), "t%d", i);
+		decl_ref t = new_named(db, _decl_typedef, name);
+		crefl_decl_ptr(t)->_link = crefl_decl_idx(link);
+		link = t;
+	}
+	crefl_decl_ptr(src)->_link = crefl_decl_idx(link);
+	assert(crefl_db_link_hashes(db) == 0);
+
+	/* fqns too long for the section are left out and use the name index */
+	size_t sz;
+	uint8_t *image = write_image(db, 1, &sz);
+	decl_db *db1 = crefl_db_attach_mem(image, sz);
+	assert(db1 != NULL && db1->lookup != NULL);
+	assert(((const decl_db_index_hdr*)db1->lookup)->fqn_limit == 0);
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db1, "t99999::t99998")) ==
+		crefl_decl_idx(link) - 1);
+	assert(crefl_decl_idx(crefl_lookup_by_hash(db1,
+		&db->hash_entry[crefl_decl_idx(link)].hash)) == crefl_decl_idx(link));
+	crefl_db_destroy(db1);
+
+	free(image);
+	crefl_db_destroy(db);
+}
+
+int main()
+{
+	t28_index();
+	t28_deep();
+}
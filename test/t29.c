@@ -0,0 +1,166 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+#include <crefl/link.h>
+#include <crefl/oid.h>
+
+/* crefl_db_freeze allows concurrent queries without locks */
+
+#define NTHREADS 8
+#define NSTRUCTS 500
+#define NFIELDS 4
+#define NROUNDS 20
+
+static decl_ref new_named(decl_db *db, decl_tag tag, const char *name)
+{
+	decl_ref r = crefl_decl_new(db, tag);
+	crefl_decl_ptr(r)->_name = crefl_name_new(db, name);
+	return r;
+}
+
+/* source { struct s<i> { int f0; char f1; double f2; struct s<i-1> f3; } } */
+static decl_db * synth_db()
+{
+	char name[32];
+	decl_db *db = crefl_db_new();
+	crefl_db_defaults(db);
+	decl_ref src = new_named(db, _decl_source, "t29.h");
+	db->root_element = crefl_decl_idx(src);
+	decl_ref last = { db, 0 };
+	for (size_t i = 0; i < NSTRUCTS; i++) {
+		snprintf(name, sizeof(name), "s%zu", i);
+		decl_ref s = new_named(db, _decl_struct, name);
+		if (crefl_decl_idx(last)) crefl_decl_ptr(last)->_next = crefl_decl_idx(s);
+		else crefl_decl_ptr(src)->_link = crefl_decl_idx(s);
+		decl_ref prev = { db, 0 };
+		for (size_t j = 0; j < NFIELDS; j++) {
+			snprintf(name, sizeof(name), "f%zu", j);
+			decl_ref f = new_named(db, _decl_field, name);
+			decl_ref t;
+			switch (j) {
+			case 0: t = crefl_intrinsic(db, _decl_sint, 32); break;
+			case 1: t = crefl_intrinsic(db, _decl_sint, 8); break;
+			case 2: t = crefl_intrinsic(db, _decl_float, 64); break;
+			default: t = i ? last : crefl_intrinsic(db, _decl_uint, 16); break;
+			}
+			crefl_decl_ptr(f)->_link = crefl_decl_idx(t);
+			if (crefl_decl_idx(prev)) crefl_decl_ptr(prev)->_next = crefl_decl_idx(f);
+			else crefl_decl_ptr(s)->_link = crefl_decl_idx(f);
+			prev = f;
+		}
+		last = s;
+	}
+	assert(crefl_db_link_hashes(db) == 0);
+	return db;
+}
+
+struct expect
+{
+	decl_id id[NSTRUCTS];
+	decl_id field[NSTRUCTS];
+	size_t width[NSTRUCTS];
+	size_t offset[NSTRUCTS];
+	size_t nstructs;
+};
+
+static decl_db *shared_db;
+static struct expect expected;
+
+static void query(decl_db *db, size_t i, struct expect *e)
+{
+	char fqn[32];
+	snprintf(fqn, sizeof(fqn), "s%zu", i);
+	decl_ref s = crefl_lookup_by_fqn(db, fqn);
+	snprintf(fqn, sizeof(fqn), "s%zu::f3", i);
+	decl_ref f = crefl_lookup_by_fqn(db, fqn);
+	decl_ref r[NFIELDS + 1];
+	size_t o[NFIELDS + 1], n = NFIELDS + 1;
+	assert(crefl_struct_fields_offsets(s, r, o, &n) == 0 && n == NFIELDS + 1);
+	assert(crefl_decl_idx(r[NFIELDS - 1]) == crefl_decl_idx(f));
+	assert(crefl_decl_idx(crefl_lookup_by_hash(db, &db->hash_entry[crefl_decl_idx(s)].hash)) ==
+		crefl_decl_idx(s));
+	e->id[i] = crefl_decl_idx(s);
+	e->field[i] = crefl_decl_idx(f);
+	e->width[i] = crefl_type_width(s);
+	e->offset[i] = o[NFIELDS - 1];
+}
+
+static void * reader(void *arg)
+{
+	struct expect *e = (struct expect *)calloc(1, sizeof(struct expect));
+	size_t t = (size_t)(uintptr_t)arg;
+	decl_ref r[NSTRUCTS];
+
+	for (size_t round = 0; round < NROUNDS; round++) {
+		for (size_t k = 0; k < NSTRUCTS; k++) {
+			query(shared_db, (k * 31 + t * 97 + round) % NSTRUCTS, e);
+		}
+		size_t n = NSTRUCTS;
+		assert(crefl_db_tag_decls(shared_db, _decl_struct, r, &n) == 0);
+		e->nstructs = n;
+		n = NSTRUCTS;
+		assert(crefl_source_decls(crefl_root(shared_db), r, &n) == 0);
+		assert(n == NSTRUCTS);
+		assert(crefl_decl_idx(crefl_lookup_by_name(shared_db, "s7")) == expected.id[7]);
+		assert(crefl_decl_idx(crefl_intrinsic(shared_db, _decl_float, 64)) != 0);
+		assert(strcmp(crefl_asn1_oid_desc("\x55\x04\x06", 3), "countryName") == 0);
+	}
+	assert(memcmp(e, &expected, sizeof(expected)) == 0);
+	free(e);
+	return NULL;
+}
+
+void t29_freeze()
+{
+	/* expected results from an unfrozen db with the same image */
+	decl_db *db = synth_db();
+	crefl_db_set_index(db, 1);
+	size_t sz = crefl_db_size(db);
+	uint64_t *image = (uint64_t*)malloc(sz);
+	assert(crefl_db_write_mem(db, (uint8_t*)image, sz) == 0);
+	for (size_t i = 0; i < NSTRUCTS; i++) query(db, i, &expected);
+	expected.nstructs = NSTRUCTS;
+	assert(expected.width[NSTRUCTS - 1] > expected.width[0]);
+
+	/* a frozen copy with columns and a frozen attached image */
+	decl_db *copy = crefl_db_new();
+	assert(crefl_db_read_mem(copy, (uint8_t*)image, sz) == 0);
+	crefl_db_set_columns(copy, 1);
+	decl_db *attached = crefl_db_attach_mem((uint8_t*)image, sz);
+	assert(attached != NULL && attached->lookup != NULL);
+
+	decl_db *dbs[] = { copy, attached };
+	for (size_t d = 0; d < 2; d++) {
+		shared_db = dbs[d];
+		assert(crefl_db_freeze(shared_db) == 0);
+		assert(shared_db->frozen && shared_db->name_index && shared_db->layout);
+		assert(crefl_db_freeze(shared_db) == 0);
+		assert(crefl_db_link_hashes(shared_db) != 0);
+
+		pthread_t threads[NTHREADS];
+		for (size_t t = 0; t < NTHREADS; t++) {
+			assert(pthread_create(&threads[t], NULL, reader, (void*)(uintptr_t)t) == 0);
+		}
+		for (size_t t = 0; t < NTHREADS; t++) {
+			assert(pthread_join(threads[t], NULL) == 0);
+		}
+	}
+
+	crefl_db_destroy(attached);
+	crefl_db_destroy(copy);
+	crefl_db_destroy(db);
+	free(image);
+}
+
+int main()
+{
+	t29_freeze();
+}
@@ -0,0 +1,137 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include <crefl/model.h>
+#include <crefl/db.h>
+#include <crefl/handle.h>
+
+/* crefl_handle_reload swaps images while readers query pinned snapshots */
+
+#define DB_FILE_A "t30-a.refl"
+#define DB_FILE_B "t30-b.refl"
+#define NREADERS 4
+#define NRELOADS 50
+#define NPINS 2000
+
+static decl_ref new_named(decl_db *db, decl_tag tag, const char *name)
+{
+	decl_ref r = crefl_decl_new(db, tag);
+	crefl_decl_ptr(r)->_name = crefl_name_new(db, name);
+	return r;
+}
+
+/* source { struct s { int f0; ... int f<nfields-1>; }; } */
+static decl_db * synth_db(size_t nfields)
+{
+	char name[32];
+	decl_db *db = crefl_db_new();
+	crefl_db_defaults(db);
+	decl_ref src = new_named(db, _decl_source, "t30.h");
+	db->root_element = crefl_decl_idx(src);
+	decl_ref s = new_named(db, _decl_struct, "s");
+	crefl_decl_ptr(src)->_link = crefl_decl_idx(s);
+	decl_ref prev = { db, 0 };
+	for (size_t j = 0; j < nfields; j++) {
+		snprintf(name, sizeof(name), "f%zu", j);
+		decl_ref f = new_named(db, _decl_field, name);
+		crefl_decl_ptr(f)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+		if (crefl_decl_idx(prev)) crefl_decl_ptr(prev)->_next = crefl_decl_idx(f);
+		else crefl_decl_ptr(s)->_link = crefl_decl_idx(f);
+		prev = f;
+	}
+	return db;
+}
+
+static void write_db(const char *filename, size_t nfields)
+{
+	decl_db *db = synth_db(nfields);
+	assert(crefl_db_write_file(db, filename) == 0);
+	crefl_db_destroy(db);
+}
+
+/* the fields of s agree with its width within one snapshot */
+static size_t check_snapshot(decl_db_snapshot *snap)
+{
+	decl_db *db = crefl_snapshot_db(snap);
+	decl_ref s = crefl_lookup_by_fqn(db, "s");
+	size_t width = crefl_type_width(s), n = 0;
+	assert(crefl_struct_fields(s, NULL, &n) == 0);
+	assert(n == width / 32);
+	return n;
+}
+
+static decl_db_handle *handle;
+
+static void * reader(void *arg)
+{
+	uint64_t last = 0;
+	for (size_t i = 0; i < NPINS; i++) {
+		decl_db_snapshot *snap = crefl_handle_pin(handle);
+		uint64_t version = crefl_snapshot_version(snap);
+		assert(version >= last);
+		/* odd versions map the image with one field, even with two */
+		assert(check_snapshot(snap) == (version & 1 ? 1 : 2));
+		last = version;
+		crefl_snapshot_unpin(snap);
+	}
+	return NULL;
+}
+
+static void * writer(void *arg)
+{
+	for (size_t i = 0; i < NRELOADS; i++) {
+		const char *filename = i & 1 ? DB_FILE_B : DB_FILE_A;
+		assert(crefl_handle_reload(handle, filename) == (int64_t)i + 3);
+	}
+	return NULL;
+}
+
+void t30_reload()
+{
+	write_db(DB_FILE_A, 1);
+	write_db(DB_FILE_B, 2);
+
+	/* an empty handle keeps its version when a reload fails */
+	handle = crefl_handle_new(NULL);
+	assert(crefl_handle_pin(handle) == NULL);
+	assert(crefl_handle_reload(handle, "t30-missing.refl") == -1);
+	assert(crefl_handle_version(handle) == 0);
+	assert(crefl_handle_reload(handle, DB_FILE_A) == 1);
+
+	/* a pinned snapshot survives a swap */
+	decl_db_snapshot *pinned = crefl_handle_pin(handle);
+	assert(crefl_snapshot_db(pinned)->frozen);
+	assert(crefl_handle_swap(handle, synth_db(2)) == 2);
+	assert(crefl_handle_version(handle) == 2);
+	assert(crefl_snapshot_version(pinned) == 1 && check_snapshot(pinned) == 1);
+	decl_db_snapshot *current = crefl_handle_pin(handle);
+	assert(crefl_snapshot_version(current) == 2 && check_snapshot(current) == 2);
+	crefl_snapshot_unpin(pinned);
+	crefl_snapshot_unpin(current);
+
+	/* concurrent readers while images are reloaded */
+	pthread_t threads[NREADERS + 1];
+	for (size_t t = 0; t < NREADERS; t++) {
+		assert(pthread_create(&threads[t], NULL, reader, NULL) == 0);
+	}
+	assert(pthread_create(&threads[NREADERS], NULL, writer, NULL) == 0);
+	for (size_t t = 0; t <= NREADERS; t++) {
+		assert(pthread_join(threads[t], NULL) == 0);
+	}
+	assert(crefl_handle_version(handle) == NRELOADS + 2);
+
+	crefl_handle_destroy(handle);
+	remove(DB_FILE_A);
+	remove(DB_FILE_B);
+}
+
+int main()
+{
+	t30_reload();
+}
@@ -0,0 +1,144 @@
+#undef NDEBUG
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+
+#include <random>
+#include <vector>
+#include <unordered_map>
+
+#include <crefl/hashmap.h>
+
+/* hashmap backward shift erase, reserve and shrink_to_fit */
+
+/* keys are their own hash so tests choose the home slot of each key */
+struct ident_hash
+{
+	size_t operator()(uint64_t k) const { return (size_t)k; }
+};
+
+typedef hashmap<uint64_t,uint64_t,ident_hash> map_t;
+
+static void check_map(map_t &map, std::unordered_map<uint64_t,uint64_t> &ref)
+{
+	assert(map.size() == ref.size());
+	for (auto &e : ref) {
+		auto i = map.find(e.first);
+		assert(i != map.end() && i->second == e.second);
+	}
+	size_t count = 0;
+	for (auto &e : map) {
+		auto i = ref.find(e.first);
+		assert(i != ref.end() && i->second == e.second);
+		count++;
+	}
+	assert(count == ref.size());
+}
+
+void t31_wrap()
+{
+	/* erase each slot of a run that wraps from slot 13 past the end */
+	const uint64_t keys[] = { 13, 14, 29, 30, 45, 15, 16, 32 };
+	const size_t nkeys = sizeof(keys) / sizeof(keys[0]);
+
+	for (size_t e = 0; e < nkeys; e++) {
+		map_t map;
+		std::unordered_map<uint64_t,uint64_t> ref;
+		for (size_t i = 0; i < nkeys; i++) {
+			map.insert(keys[i], i);
+			ref[keys[i]] = i;
+		}
+		assert(map.capacity() == 16);
+		map.erase(keys[e]);
+		ref.erase(keys[e]);
+		assert(map.find(keys[e]) == map.end());
+		check_map(map, ref);
+
+		/* the run stays contiguous so every probe reaches its key */
+		size_t run = 0;
+		for (size_t i = 13; map_t::bitmap_get(map.bitmap, i & 15) &
+			 map_t::occupied; i++) run++;
+		assert(run == nkeys - 1);
+	}
+}
+
+void t31_churn()
+{
+	std::mt19937_64 rng(31);
+	map_t map;
+	std::unordered_map<uint64_t,uint64_t> ref;
+
+	/* a small key range keeps runs long and erases frequent */
+	for (size_t n = 0; n < 200000; n++) {
+		uint64_t k = rng() % 1024, v = rng();
+		switch (rng() % 3) {
+		case 0:
+			map.insert(k, v);
+			ref[k] = v;
+			break;
+		case 1:
+			map.erase(k);
+			ref.erase(k);
+			break;
+		case 2: {
+			auto i = map.find(k);
+			auto j = ref.find(k);
+			assert((i == map.end()) == (j == ref.end()));
+			if (j != ref.end()) assert(i->second == j->second);
+			break;
+		}
+		}
+		if (n % 10000 == 0) check_map(map, ref);
+	}
+	check_map(map, ref);
+	assert(map.tombs == 0);
+}
+
+void t31_reserve()
+{
+	map_t map;
+	std::unordered_map<uint64_t,uint64_t> ref;
+
+	/* reserve grows once so inserts up to n do not resize */
+	map.reserve(1000);
+	size_t limit = map.capacity();
+	assert(limit >= 2000);
+	for (uint64_t k = 0; k < 1000; k++) {
+		map.insert(k * 7, k);
+		ref[k * 7] = k;
+	}
+	assert(map.capacity() == limit);
+	check_map(map, ref);
+
+	/* smaller reserves keep the size */
+	map.reserve(10);
+	assert(map.capacity() == limit);
+	check_map(map, ref);
+
+	/* shrinking keeps the entries within the load factor */
+	for (uint64_t k = 0; k < 1000; k++) {
+		if (k % 10 == 0) continue;
+		map.erase(k * 7);
+		ref.erase(k * 7);
+	}
+	map.shrink_to_fit();
+	assert(map.capacity() < limit && map.capacity() >= 2 * map.size());
+	assert(map.capacity() / 2 < 2 * map.size());
+	check_map(map, ref);
+
+	/* shrinking at the minimum size or an empty map */
+	map.shrink_to_fit();
+	check_map(map, ref);
+	map.clear();
+	map.shrink_to_fit();
+	assert(map.capacity() == map_t::default_size && map.size() == 0);
+}
+
+int main()
+{
+	t31_wrap();
+	t31_churn();
+	t31_reserve();
+}
@@ -0,0 +1,169 @@
+#undef NDEBUG
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+
+#include <random>
+#include <vector>
+#include <unordered_map>
+
+#include <crefl/swissmap.h>
+
+/* swissmap group probes, tombstones and rehash */
+
+typedef swissmap<uint64_t,uint64_t> map_t;
+
+/* the group of key in a table of limit slots */
+static size_t group_of(uint64_t k, size_t limit)
+{
+	return (map_t::mix(map_t::_hasher(k)) >> 7) & (limit / map_t::group_size - 1);
+}
+
+/* the first n keys whose home is group g in a table of limit slots */
+static std::vector<uint64_t> group_keys(size_t g, size_t limit, size_t n,
+	uint64_t &next)
+{
+	std::vector<uint64_t> keys;
+	for (; keys.size() < n; next++) {
+		if (group_of(next, limit) == g) keys.push_back(next);
+	}
+	return keys;
+}
+
+static void check_map(map_t &map, std::unordered_map<uint64_t,uint64_t> &ref)
+{
+	assert(map.size() == ref.size());
+	for (auto &e : ref) {
+		auto i = map.find(e.first);
+		assert(i != map.end() && i->second == e.second);
+	}
+	size_t count = 0;
+	for (auto &e : map) {
+		auto i = ref.find(e.first);
+		assert(i != ref.end() && i->second == e.second);
+		count++;
+	}
+	assert(count == ref.size());
+}
+
+void t32_groups()
+{
+	const size_t limit = 64;
+	uint64_t next = 1;
+	map_t map(limit);
+	std::unordered_map<uint64_t,uint64_t> ref;
+
+	/* keys of group 0 fill it and overflow to the next group */
+	std::vector<uint64_t> keys = group_keys(0, limit, 20, next);
+	for (size_t i = 0; i < keys.size(); i++) {
+		map.insert(keys[i], i);
+		ref[keys[i]] = i;
+	}
+	assert(map.capacity() == limit);
+	check_map(map, ref);
+	for (size_t i = 16; i < keys.size(); i++) {
+		assert(map.find(keys[i]).i >= map_t::group_size);
+	}
+
+	/* erasing from the full group leaves a tombstone */
+	map.erase(keys[3]);
+	ref.erase(keys[3]);
+	assert(map.tombs == 1 && map.find(keys[3]) == map.end());
+	check_map(map, ref);
+
+	/* an insert of the same group reuses the tombstone */
+	uint64_t k = group_keys(0, limit, 1, next)[0];
+	map.insert(k, 100);
+	ref[k] = 100;
+	assert(map.tombs == 0 && map.find(k).i < map_t::group_size);
+	check_map(map, ref);
+
+	/* erasing from a group with an empty slot leaves no tombstone */
+	size_t i = map.find(keys[17]).i;
+	map.erase(keys[17]);
+	ref.erase(keys[17]);
+	assert(map.tombs == 0 && map.ctrl[i] == map_t::empty);
+	check_map(map, ref);
+}
+
+void t32_rehash()
+{
+	const size_t limit = 64;
+	uint64_t next = 1;
+	map_t map(limit);
+	std::unordered_map<uint64_t,uint64_t> ref;
+
+	/* fill groups 0 to 2 then erase groups 0 and 1 */
+	std::vector<uint64_t> keys[4];
+	for (size_t g = 0; g < 4; g++) keys[g] = group_keys(g, limit, 16, next);
+	for (size_t g = 0; g < 3; g++) {
+		for (uint64_t k : keys[g]) {
+			map.insert(k, k);
+			ref[k] = k;
+		}
+	}
+	for (size_t g = 0; g < 2; g++) {
+		for (uint64_t k : keys[g]) {
+			map.erase(k);
+			ref.erase(k);
+		}
+	}
+	assert(map.size() == 16 && map.tombs == 32);
+	check_map(map, ref);
+
+	/* inserts past the load limit rehash in place to clear tombstones */
+	for (size_t i = 0; i < 9; i++) {
+		map.insert(keys[3][i], i);
+		ref[keys[3][i]] = i;
+	}
+	assert(map.capacity() == limit && map.tombs == 0);
+	check_map(map, ref);
+	for (size_t g = 0; g < 2; g++) {
+		for (uint64_t k : keys[g]) assert(map.find(k) == map.end());
+	}
+}
+
+void t32_churn()
+{
+	std::mt19937_64 rng(32);
+	map_t map;
+	std::unordered_map<uint64_t,uint64_t> ref;
+
+	/* a small key range keeps groups full and erases frequent */
+	for (size_t n = 0; n < 200000; n++) {
+		uint64_t k = rng() % 1024, v = rng();
+		switch (rng() % 4) {
+		case 0:
+			map.insert(k, v);
+			ref[k] = v;
+			break;
+		case 1:
+			map[k] = v;
+			ref[k] = v;
+			break;
+		case 2:
+			map.erase(k);
+			ref.erase(k);
+			break;
+		case 3: {
+			auto i = map.find(k);
+			auto j = ref.find(k);
+			assert((i == map.end()) == (j == ref.end()));
+			if (j != ref.end()) assert(i->second == j->second);
+			break;
+		}
+		}
+		if (n % 10000 == 0) check_map(map, ref);
+	}
+	check_map(map, ref);
+	assert((map.size() + map.tombs) * 8 <= map.capacity() * 7);
+}
+
+int main()
+{
+	t32_groups();
+	t32_rehash();
+	t32_churn();
+}
@@ -0,0 +1,163 @@
+#undef NDEBUG
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include <crefl/model.h>
+
+/* crefl_lookup_by_name, crefl_lookup_by_fqn */
+
+static decl_ref new_named(decl_db *db, decl_tag tag, const char *name)
+{
+	decl_ref r = crefl_decl_new(db, tag);
+	crefl_decl_ptr(r)->_name = crefl_name_new(db, name);
+	return r;
+}
+
+void t9_lookup()
+{
+	decl_db *db = crefl_db_new();
+	assert(db != NULL);
+	crefl_db_defaults(db);
+
+	/* source { struct foo { int a; struct bar { int b; } c; }; typedef foo_t; } */
+	decl_ref src = new_named(db, _decl_source, "t9.h");
+	db->root_element = crefl_decl_idx(src);
+
+	decl_ref foo = new_named(db, _decl_struct, "foo");
+	crefl_decl_ptr(src)->_link = crefl_decl_idx(foo);
+	decl_ref a = new_named(db, _decl_field, "a");
+	crefl_decl_ptr(foo)->_link = crefl_decl_idx(a);
+	crefl_decl_ptr(a)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+	decl_ref bar = new_named(db, _decl_struct, "bar");
+	crefl_decl_ptr(a)->_next = crefl_decl_idx(bar);
+	decl_ref b = new_named(db, _decl_field, "b");
+	crefl_decl_ptr(bar)->_link = crefl_decl_idx(b);
+	crefl_decl_ptr(b)->_link = crefl_decl_idx(crefl_intrinsic(db, _decl_sint, 32));
+	decl_ref c = new_named(db, _decl_field, "c");
+	crefl_decl_ptr(bar)->_next = crefl_decl_idx(c);
+	crefl_decl_ptr(c)->_link = crefl_decl_idx(bar);
+	decl_ref foo_t = new_named(db, _decl_typedef, "foo_t");
+	crefl_decl_ptr(foo)->_next = crefl_decl_idx(foo_t);
+	crefl_decl_ptr(foo_t)->_link = crefl_decl_idx(foo);
+
+	assert(crefl_decl_idx(crefl_lookup_by_name(db, "foo")) == crefl_decl_idx(foo));
+	assert(crefl_decl_idx(crefl_lookup_by_name(db, "struct foo")) == crefl_decl_idx(foo));
+	assert(crefl_decl_idx(crefl_lookup_by_name(db, "union foo")) == 0);
+	assert(crefl_decl_idx(crefl_lookup_by_name(db, "struct bar")) == crefl_decl_idx(bar));
+	assert(crefl_decl_idx(crefl_lookup_by_name(db, "typedef foo_t")) == crefl_decl_idx(foo_t));
+	assert(crefl_decl_idx(crefl_lookup_by_name(db, "a")) == 0);
+	assert(crefl_decl_idx(crefl_lookup_by_name(db, "missing")) == 0);
+	assert(crefl_is_intrinsic(crefl_lookup_by_name(db, "int")));
+
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db, "foo")) == crefl_decl_idx(foo));
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db, "foo::a")) == crefl_decl_idx(a));
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db, "foo::bar")) == crefl_decl_idx(bar));
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db, "foo::bar::b")) == crefl_decl_idx(b));
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db, "field foo::c")) == crefl_decl_idx(c));
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db, "struct foo::c")) == 0);
+
+	/* appending nodes drops the index so new names are found */
+	decl_ref baz = new_named(db, _decl_union, "baz");
+	crefl_decl_ptr(foo_t)->_next = crefl_decl_idx(baz);
+	assert(crefl_decl_idx(crefl_lookup_by_name(db, "union baz")) == crefl_decl_idx(baz));
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db, "baz")) == crefl_decl_idx(baz));
+
+	/* appending a name drops the index but keeps tables of the nodes */
+	assert(crefl_type_width(foo) == 64 && db->layout != NULL);
+	assert(db->name_index != NULL);
+	crefl_name_new(db, "qux");
+	assert(db->name_index == NULL && db->layout != NULL);
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db, "foo::bar::b")) == crefl_decl_idx(b));
+
+	crefl_db_destroy(db);
+}
+
+void t9_chain()
+{
+	decl_db *db = crefl_db_new();
+	assert(db != NULL);
+	crefl_db_defaults(db);
+
+	/* source { struct s<i> { struct x { } x; }; ... } shares the name x */
+	const int k = 20000;
+	decl_ref src = new_named(db, _decl_source, "t9.h");
+	db->root_element = crefl_decl_idx(src);
+
+	decl_ref last = crefl_decl_void(src), first_x = last;
+	char name[16];
+	for (int i = 0; i < k; i++) {
+		snprintf(name, sizeof(name), "s%d", i);
+		decl_ref s = new_named(db, _decl_struct, name);
+		if (i == 0) crefl_decl_ptr(src)->_link = crefl_decl_idx(s);
+		else crefl_decl_ptr(last)->_next = crefl_decl_idx(s);
+		decl_ref x = new_named(db, _decl_struct, "x");
+		crefl_decl_ptr(s)->_link = crefl_decl_idx(x);
+		if (i == 0) first_x = x;
+		last = s;
+	}
+
+	/* the first node in traversal order wins within a chain */
+	assert(crefl_decl_idx(crefl_lookup_by_name(db, "x")) == crefl_decl_idx(first_x));
+	decl_ref x = crefl_lookup_by_fqn(db, "s12345::x");
+	assert(crefl_is_struct(x) && strcmp(crefl_decl_name(x), "x") == 0);
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db, "s12345")) == crefl_decl_idx(x) - 1);
+
+	crefl_db_destroy(db);
+}
+
+/* source { typedef t<n-1> -> ... -> typedef t0 -> int } */
+static decl_db * new_typedef_chain(int n)
+{
+	decl_db *db = crefl_db_new();
+	assert(db != NULL);
+	crefl_db_defaults(db);
+
+	decl_ref src = new_named(db, _decl_source, "t9.h");
+	db->root_element = crefl_decl_idx(src);
+
+	decl_ref link = crefl_intrinsic(db, _decl_sint, 32);
+	char name[16];
+	for (int i = 0; i < n; i++) {
+		snprintf(name, sizeof(name), "t%d", i);
+		decl_ref t = new_named(db, _decl_typedef, name);
+		crefl_decl_ptr(t)->_link = crefl_decl_idx(link);
+		link = t;
+	}
+	crefl_decl_ptr(src)->_link = crefl_decl_idx(link);
+
+	return db;
+}
+
+void t9_deep()
+{
+	/* nodes reached through link hops extend the fqn of their parent */
+	decl_db *db = new_typedef_chain(3);
+	decl_ref t0 = crefl_lookup_by_name(db, "t0");
+	assert(crefl_is_typedef(t0) && strcmp(crefl_decl_name(t0), "t0") == 0);
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db, "t2::t1::t0")) == crefl_decl_idx(t0));
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db, "t2::t1")) == crefl_decl_idx(t0) + 1);
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db, "t1::t0")) == 0);
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db, "t2::t1:t0")) == 0);
+	crefl_db_destroy(db);
+
+	/* a deep chain is indexed without copying prefixes or recursing */
+	db = new_typedef_chain(200000);
+	t0 = crefl_lookup_by_name(db, "t0");
+	assert(crefl_is_typedef(t0));
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db, "t199999")) ==
+		crefl_decl_idx(t0) + 199999);
+	assert(crefl_decl_idx(crefl_lookup_by_fqn(db, "t199999::t199998")) ==
+		crefl_decl_idx(t0) + 199998);
+	assert(crefl_db_freeze(db) == 0);
+	assert(crefl_decl_idx(crefl_lookup_by_name(db, "t123")) == crefl_decl_idx(t0) + 123);
+	crefl_db_destroy(db);
+}
+
+int main()
+{
+	t9_lookup();
+	t9_chain();
+	t9_deep();
+}
@@ -27,18 +27,21 @@
 
 #define array_size(arr) ((sizeof(arr)/sizeof(arr[0])))
 
-void do_merge(const char *output, const char **input, size_t n)
+void do_merge(const char *output, const char **input, size_t n, size_t jobs,
+    u32 hash_alg, bool hashes)
 {
     decl_db *db_out = crefl_db_new();
+    db_out->hash_alg = hash_alg;
     decl_db **db_in = (decl_db**)malloc(sizeof(decl_db*) * n);
     for (size_t i = 0; i < n; i++) {
         db_in[i] = crefl_db_new();
         crefl_db_read_file(db_in[i], input[i]);
     }
-    if (crefl_link_merge(db_out, output, db_in, n) < 0) {
+    if (crefl_link_merge_jobs(db_out, output, db_in, n, jobs) < 0) {
         fprintf(stderr, "error: merging input files\n");
         exit(1);
     }
+    if (hashes) crefl_db_link_hashes(db_out);
     crefl_db_write_file(db_out, output);
     for (size_t i = 0; i < n; i++) {
         crefl_db_destroy(db_in[i]);
@@ -46,6 +49,63 @@ void do_merge(const char *output, const char **input, size_t n)
     crefl_db_destroy(db_out);
 }
 
+void do_merge_update(const char *archive, const char **input, size_t n,
+    size_t jobs, bool hashes)
+{
+    decl_db *db_out = crefl_db_new();
+    if (crefl_db_read_file(db_out, archive) != 0) {
+        fprintf(stderr, "error: reading archive %s\n", archive);
+        exit(1);
+    }
+    decl_db **db_in = (decl_db**)malloc(sizeof(decl_db*) * n);
+    for (size_t i = 0; i < n; i++) {
+        db_in[i] = crefl_db_new();
+        if (crefl_db_read_file(db_in[i], input[i]) != 0) {
+            fprintf(stderr, "error: reading input %s\n", input[i]);
+            exit(1);
+        }
+    }
+    if (crefl_link_update(db_out, db_in, n, jobs) < 0) {
+        fprintf(stderr, "error: updating archive\n");
+        exit(1);
+    }
+    if (hashes && !db_out->hash_entry) crefl_db_link_hashes(db_out);
+    crefl_db_write_file(db_out, archive);
+    for (size_t i = 0; i < n; i++) {
+        crefl_db_destroy(db_in[i]);
+    }
+    free(db_in);
+    crefl_db_destroy(db_out);
+}
+
+void do_rewrite(const char *output, const char *input, const char *what,
+    int (*pass)(decl_db *db))
+{
+    decl_db *db = crefl_db_new();
+    if (crefl_db_read_file(db, input) != 0) {
+        fprintf(stderr, "error: reading db\n");
+        exit(1);
+    }
+    size_t decl_in = db->decl_offset, size_in = crefl_db_size(db);
+    if (pass(db) != 0) {
+        fprintf(stderr, "error: %s failed\n", what);
+        exit(1);
+    }
+    size_t decl_out = db->decl_offset, size_out = crefl_db_size(db);
+    if (crefl_db_write_file(db, output) != 0) {
+        fprintf(stderr, "error: writing db\n");
+        exit(1);
+    }
+    printf("%s: %zu -> %zu nodes, %zu -> %zu bytes, saved %lld bytes\n",
+        what, decl_in, decl_out, size_in, size_out,
+        (long long)size_in - (long long)size_out);
+    crefl_db_destroy(db);
+}
+
+static int pack_pass(decl_db *db) { crefl_db_set_packed(db, 1); return 0; }
+static int unpack_pass(decl_db *db) { crefl_db_set_packed(db, 0); return 0; }
+static int index_pass(decl_db *db) { crefl_db_set_index(db, 1); return 0; }
+
 void do_emit(const char *output, const char *input, const char *name)
 {
     FILE *f;
@@ -54,8 +114,12 @@ void do_emit(const char *output, const char *input, const char *name)
     size_t sz;
     const size_t w = 16;
 
+    /* links are checked by read so the image is flagged as checked */
     db = crefl_db_new();
-    crefl_db_read_file(db, input);
+    if (crefl_db_read_file(db, input) != 0) {
+        fprintf(stderr, "error: reading db\n");
+        exit(1);
+    }
     sz = crefl_db_size(db);
     buf = (uint8_t*)malloc(sz);
     if (crefl_db_write_mem(db, buf, sz) < 0 || !(f = fopen(output, "wb"))) {
@@ -63,8 +127,16 @@ void do_emit(const char *output, const char *input, const char *name)
         fprintf(stderr, "error: writing db\n");
         exit(1);
     }
+    ((decl_db_hdr*)buf)->flags |= decl_db_flag_checked;
     fprintf(f, "#include <stdlib.h>\n");
-    fprintf(f, "const unsigned char __crefl_%s_data[] = {\n", name);
+    fprintf(f, "#ifndef CREFL_ALIGN\n");
+    fprintf(f, "#if defined(_MSC_VER)\n");
+    fprintf(f, "#define CREFL_ALIGN(n) __declspec(align(n))\n");
+    fprintf(f, "#else\n");
+    fprintf(f, "#define CREFL_ALIGN(n) __attribute__((aligned(n)))\n");
+    fprintf(f, "#endif\n");
+    fprintf(f, "#endif\n");
+    fprintf(f, "CREFL_ALIGN(8) const unsigned char __crefl_%s_data[] = {\n", name);
     for (size_t i = 0; i < sz; i++) {
         fprintf(f, "0x%02hhx", buf[i]);
         if (i != sz -1) fprintf(f, ",");
@@ -106,6 +178,12 @@ typedef enum {
     _dump_ext_sum,
     _dump_ext_all,
     _merge,
+    _merge_update,
+    _compact,
+    _optimize_layout,
+    _pack,
+    _unpack,
+    _index,
     _emit,
     _stats
 } mode_enum;
@@ -114,22 +192,30 @@ struct {
     mode_enum val;
     const char *arg;
 } mode_args[] = {
-    { _dump_std,      "--dump"         },
-    { _dump_fqn,      "--dump-fqn"     },
-    { _dump_sum,      "--dump-sum"     },
-    { _dump_all,      "--dump-all"     },
-    { _dump_ext,      "--dump-ext"     },
-    { _dump_ext_fqn,  "--dump-ext-fqn" },
-    { _dump_ext_sum,  "--dump-ext-sum" },
-    { _dump_ext_all,  "--dump-ext-all" },
-    { _merge,         "--merge"        },
-    { _emit,          "--emit"         },
-    { _stats,         "--stats"        },
+    { _dump_std,         "--dump"            },
+    { _dump_fqn,         "--dump-fqn"        },
+    { _dump_sum,         "--dump-sum"        },
+    { _dump_all,         "--dump-all"        },
+    { _dump_ext,         "--dump-ext"        },
+    { _dump_ext_fqn,     "--dump-ext-fqn"    },
+    { _dump_ext_sum,     "--dump-ext-sum"    },
+    { _dump_ext_all,     "--dump-ext-all"    },
+    { _merge,            "--merge"           },
+    { _merge_update,     "--merge-update"    },
+    { _compact,          "--compact"         },
+    { _optimize_layout,  "--optimize-layout" },
+    { _pack,             "--pack"            },
+    { _unpack,           "--unpack"          },
+    { _index,            "--index"           },
+    { _emit,             "--emit"            },
+    { _stats,            "--stats"           },
 };
 
 int main(int argc, const char **argv)
 {
-    size_t i;
+    size_t i, jobs = 1;
+    u32 hash_alg = decl_hash_sha224;
+    bool hashes = false;
     mode_enum mode;
 
     if (argc < 3) goto help_exit;
@@ -140,9 +226,44 @@ int main(int argc, const char **argv)
     }
     if (i == array_size(mode_args)) goto help_exit;
 
+    /*
+     * --merge -j <jobs> scans input files in parallel, 0 uses all cpus
+     * --merge -H <hash> selects the node identity hash, sha224 or fast
+     * --merge -S stores node hashes in the output for later merges
+     *
+     * --merge-update accepts -j and -S. the hash is that of the archive.
+     */
+    while ((mode == _merge || mode == _merge_update) &&
+           argc > 3 && argv[2][0] == '-') {
+        if (strcmp(argv[2], "-S") == 0) {
+            hashes = true;
+            argv += 1;
+            argc -= 1;
+            continue;
+        } else if (strcmp(argv[2], "-j") == 0) {
+            jobs = strtoull(argv[3], nullptr, 10);
+        } else if (mode == _merge_update) {
+            fprintf(stderr, "error: *** unknown merge-update option\n\n");
+            goto help_exit;
+        } else if (strcmp(argv[2], "-H") == 0 && strcmp(argv[3], "sha224") == 0) {
+            hash_alg = decl_hash_sha224;
+        } else if (strcmp(argv[2], "-H") == 0 && strcmp(argv[3], "fast") == 0) {
+            hash_alg = decl_hash_fast;
+        } else {
+            fprintf(stderr, "error: *** unknown merge option\n\n");
+            goto help_exit;
+        }
+        argv += 2;
+        argc -= 2;
+    }
+
     if ( (mode == _merge && argc < 4) ||
-         (mode == _emit && argc != 4) ||
-         (mode != _merge && mode != _emit && argc != 3) )
+         (mode == _merge_update && argc < 4) ||
+         ((mode == _emit || mode == _compact || mode == _optimize_layout ||
+           mode == _pack || mode == _unpack || mode == _index) && argc != 4) ||
+         (mode != _merge && mode != _merge_update && mode != _emit &&
+          mode != _compact && mode != _optimize_layout &&
+          mode != _pack && mode != _unpack && mode != _index && argc != 3) )
     {
         fprintf(stderr, "error: *** unknown command line option\n\n");
         goto help_exit;
@@ -158,7 +279,18 @@ int main(int argc, const char **argv)
         case _dump_ext_sum: do_dump(crefl_db_dump_ext_sum, argv[2]); break;
         case _dump_ext_all: do_dump(crefl_db_dump_ext_all, argv[2]); break;
         case _stats: do_stats(argv[2]); break;
-        case _merge: do_merge(argv[2], argv + 3, argc - 3); break;
+        case _merge: do_merge(argv[2], argv + 3, argc - 3, jobs, hash_alg, hashes); break;
+        case _merge_update: do_merge_update(argv[2], argv + 3, argc - 3, jobs, hashes); break;
+        case _compact:
+            do_rewrite(argv[2], argv[3], "compact", crefl_link_compact);
+            break;
+        case _optimize_layout:
+            do_rewrite(argv[2], argv[3], "optimize-layout",
+                crefl_link_optimize_layout);
+            break;
+        case _pack: do_rewrite(argv[2], argv[3], "pack", pack_pass); break;
+        case _unpack: do_rewrite(argv[2], argv[3], "unpack", unpack_pass); break;
+        case _index: do_rewrite(argv[2], argv[3], "index", index_pass); break;
         case _emit: do_emit(argv[2], argv[3], "main"); break;
     }
     exit(0);
@@ -166,7 +298,16 @@ int main(int argc, const char **argv)
 help_exit:
     fprintf(stderr, "usage: %s <command>\n\n"
     "Commands:\n\n"
-    "--merge <output> [<input>]+  merge reflection metadata\n"
+    "--merge [-j <jobs>] [-H sha224|fast] [-S] <output> [<input>]+\n"
+    "                             merge reflection metadata\n"
+    "--merge-update [-j <jobs>] [-S] <archive> [<input>]+\n"
+    "                             replace or add sources in a merged archive\n"
+    "--compact <output> <input>   drop unreachable nodes and collapse aliases\n"
+    "--optimize-layout <output> <input>\n"
+    "                             renumber nodes so children follow parents\n"
+    "--pack <output> <input>      write a packed decl table\n"
+    "--unpack <output> <input>    write a raw decl table\n"
+    "--index <output> <input>     write a lookup index for mapped lookups\n"
     "--emit <output> [<input>]    emit reflection metadata\n"
     "--dump <input>               dump main fields in standard 80-col format\n"
     "--dump-fqn <input>           dump main fields plus fqn in standard 103-col format\n"